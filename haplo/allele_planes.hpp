@@ -0,0 +1,530 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   allele_planes.hpp
+/// @brief  Header file for the two plane representation of the reads, an allele bit and a call bit for
+///         each element, so that reads can be compared with bitwise operations and popcounts
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_ALLELE_PLANES_HPP
+#define PARAHAPLO_ALLELE_PLANES_HPP
+
+#include "read_info.h"
+
+#include <tbb/tbb.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      AllelePlanes
+/// @brief      Holds each read as two bit vectors -- the allele plane has the value of each call (0 or 1
+///             element) and the call plane has a 1 for each call, so gaps and the columns outside the read
+///             are 0 in both. The words of every read are aligned to the snp axis (word w holds snps 64w to
+///             64w + 63, big endian), so the same word of two reads, or of a read and a haplotype, holds the
+///             same snps. Agreement, mismatch and coverage counts are then ANDs, XORs and popcounts
+// ----------------------------------------------------------------------------------------------------------
+class AllelePlanes {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_type         = uint64_t;
+    using word_container    = std::vector<word_type>;
+    using index_container   = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t bits_per_word = sizeof(word_type) * 8;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Overlap
+    /// @brief      The comparison of the calls of two reads
+    // ------------------------------------------------------------------------------------------------------
+    struct Overlap {
+        size_t      shared;         //!< Snps where both reads have a call
+        size_t      mismatches;     //!< Snps where both reads have a call, and the calls are different
+        size_t      exclusive;      //!< Snps where only one of the reads has a call
+
+        inline size_t agreements() const { return shared - mismatches; }
+    };
+private:
+    word_container      _alleles;           //!< The allele plane of each read
+    word_container      _calls;             //!< The call plane of each read
+    index_container     _first_words;       //!< The snp axis word of the first word of each read
+    index_container     _offsets;           //!< The start of each read's words in the planes
+    size_t              _snps;              //!< The number of snps on the axis
+    size_t              _max_words;         //!< The most words of any read
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- converts the packed 2 bit elements of each read to the planes
+    /// @param[in]  data        The packed 2 bit data of the reads
+    /// @param[in]  read_info   The information for each read (start, end and offset in the data)
+    /// @param[in]  reads       The number of reads
+    /// @param[in]  snps        The number of snps
+    /// @tparam     DataType        The type of the packed data
+    /// @tparam     ReadInfoType    The type of the container of the read information
+    // ------------------------------------------------------------------------------------------------------
+    template <typename DataType, typename ReadInfoType>
+    AllelePlanes(const DataType& data, const ReadInfoType& read_info, const size_t reads, const size_t snps);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the planes from the calls of each read rather than from packed data
+    /// @param[in]  calls       The calls of the reads, with a for_each_call(read_idx, function) member
+    /// @param[in]  read_info   The information for each read (start and end)
+    /// @param[in]  reads       The number of reads
+    /// @param[in]  snps        The number of snps
+    /// @tparam     CallsType       The type of the calls
+    /// @tparam     ReadInfoType    The type of the container of the read information
+    // ------------------------------------------------------------------------------------------------------
+    template <typename CallsType, typename ReadInfoType>
+    static AllelePlanes from_calls(const CallsType& calls, const ReadInfoType& read_info, 
+                                   const size_t     reads, const size_t        snps     );
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t reads() const { return _first_words.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of snps
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t snps() const { return _snps; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of words which hold a plane of the snp axis
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t axis_words() const { return _snps / bits_per_word + 1; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most words of any read, which selects the kernels of the comparisons
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_words() const { return _max_words; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the word of the allele plane of a read which holds a snp axis word -- 0 if the read
+    ///             does not cover the word
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  word_idx    The index of the word on the snp axis
+    // ------------------------------------------------------------------------------------------------------
+    inline word_type allele_word(const size_t read_idx, const size_t word_idx) const
+    {
+        return covers(read_idx, word_idx) ? _alleles[_offsets[read_idx] + word_idx - _first_words[read_idx]] 
+                                          : 0;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the word of the call plane of a read which holds a snp axis word -- 0 if the read
+    ///             does not cover the word
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  word_idx    The index of the word on the snp axis
+    // ------------------------------------------------------------------------------------------------------
+    inline word_type call_word(const size_t read_idx, const size_t word_idx) const
+    {
+        return covers(read_idx, word_idx) ? _calls[_offsets[read_idx] + word_idx - _first_words[read_idx]] 
+                                          : 0;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of calls (0 or 1 elements) of a read
+    /// @param[in]  read_idx    The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    size_t calls(const size_t read_idx) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Compares the calls of two reads
+    /// @param[in]  read_one    The index of the first read
+    /// @param[in]  read_two    The index of the second read
+    // ------------------------------------------------------------------------------------------------------
+    Overlap compare(const size_t read_one, const size_t read_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of calls of a read which are different to a haplotype
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  haplotype   The haplotype as a plane of the snp axis (from haplotype_plane)
+    // ------------------------------------------------------------------------------------------------------
+    size_t mismatches(const size_t read_idx, const word_container& haplotype) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of a pair of haplotypes -- each read adds its mismatches with the
+    ///             haplotype it is closest to
+    /// @param[in]  haplo_one   The first haplotype as a plane of the snp axis
+    /// @param[in]  haplo_two   The second haplotype as a plane of the snp axis
+    // ------------------------------------------------------------------------------------------------------
+    size_t mec_score(const word_container& haplo_one, const word_container& haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Hashes the calls of a read, so that reads with the same calls have the same hash
+    /// @param[in]  read_idx    The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    size_t hash(const size_t read_idx) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Compares the calls of two reads which each have at most Words words, with the words held
+    ///             in registers and loops of a fixed length -- the same as compare
+    /// @param[in]  read_one    The index of the first read
+    /// @param[in]  read_two    The index of the second read
+    /// @tparam     Words       The most words of the reads, which must be at least max_words()
+    // ------------------------------------------------------------------------------------------------------
+    template <size_t Words>
+    Overlap compare_fixed(const size_t read_one, const size_t read_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of calls of a read with at most Words words which are different to a 
+    ///             haplotype -- the same as mismatches
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  haplotype   The haplotype as a plane of the snp axis (from haplotype_plane)
+    /// @tparam     Words       The most words of the read, which must be at least max_words()
+    // ------------------------------------------------------------------------------------------------------
+    template <size_t Words>
+    size_t mismatches_fixed(const size_t read_idx, const word_container& haplotype) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Hashes the calls of a read with at most Words words -- the same as hash
+    /// @param[in]  read_idx    The index of the read
+    /// @tparam     Words       The most words of the read, which must be at least max_words()
+    // ------------------------------------------------------------------------------------------------------
+    template <size_t Words>
+    size_t hash_fixed(const size_t read_idx) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Converts a haplotype to a plane of the snp axis
+    /// @param[in]  values      The value (0 or 1) of the haplotype at each snp
+    /// @tparam     ValueContainer  The type of the container of the values
+    // ------------------------------------------------------------------------------------------------------
+    template <typename ValueContainer>
+    static word_container haplotype_plane(const ValueContainer& values)
+    {
+        word_container plane(values.size() / bits_per_word + 1, 0);
+        for (size_t snp_idx = 0; snp_idx < values.size(); ++snp_idx) {
+            if (values[snp_idx] == 1) plane[snp_idx / bits_per_word] |= bit(snp_idx);
+        }
+        return plane;
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- finds the words of each read, which have no calls
+    /// @param[in]  read_info   The information for each read (start and end)
+    /// @param[in]  reads       The number of reads
+    /// @param[in]  snps        The number of snps
+    /// @tparam     ReadInfoType    The type of the container of the read information
+    // ------------------------------------------------------------------------------------------------------
+    template <typename ReadInfoType>
+    AllelePlanes(const ReadInfoType& read_info, const size_t reads, const size_t snps);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines if a read has words for a snp axis word
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  word_idx    The index of the word on the snp axis
+    // ------------------------------------------------------------------------------------------------------
+    inline bool covers(const size_t read_idx, const size_t word_idx) const
+    {
+        return word_idx >= _first_words[read_idx] &&
+               word_idx -  _first_words[read_idx] < _offsets[read_idx + 1] - _offsets[read_idx];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Loads the words of a plane of a read with at most Words words, with 0 for the rest
+    /// @param[in]  plane       The plane to load the words from
+    /// @param[in]  read_idx    The index of the read
+    /// @param[out] words       The words of the read
+    /// @tparam     Words       The most words of the read
+    // ------------------------------------------------------------------------------------------------------
+    template <size_t Words>
+    inline void load(const word_container& plane, const size_t read_idx, word_type (&words)[Words]) const
+    {
+        const size_t offset = _offsets[read_idx], num_words = _offsets[read_idx + 1] - offset;
+        for (size_t i = 0; i < Words; ++i) words[i] = i == 0 || i < num_words ? plane[offset + i] : 0;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Mixes a word of the calls of a read into a hash -- 0 if the word has no calls, so the 
+    ///             hash doesn't depend on how many empty words are included
+    /// @param[in]  word_idx    The index of the word on the snp axis
+    /// @param[in]  calls       The word of the call plane
+    /// @param[in]  alleles     The word of the allele plane
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t mix(const size_t word_idx, const word_type calls, const word_type alleles)
+    {
+        // The finalizer of MurmurHash3
+        word_type hash = calls * 0x9E3779B97F4A7C15ULL + alleles * 0xC2B2AE3D27D4EB4FULL + word_idx;
+        hash = (hash ^ (hash >> 33)) * 0xFF51AFD7ED558CCDULL;
+        hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+        return (hash ^ (hash >> 33)) * (calls != 0);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of a pair of haplotypes, with the mismatches of each read found by the
+    ///             kernel for Words words, or the general one if Words is 0
+    /// @param[in]  haplo_one   The first haplotype as a plane of the snp axis
+    /// @param[in]  haplo_two   The second haplotype as a plane of the snp axis
+    /// @tparam     Words       The most words of the reads, or 0
+    // ------------------------------------------------------------------------------------------------------
+    template <size_t Words>
+    size_t mec_score_kernel(const word_container& haplo_one, const word_container& haplo_two) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the mismatches of a read with a haplotype with the kernel for Words words, or the 
+    ///             general one if Words is 0
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  haplotype   The haplotype as a plane of the snp axis
+    /// @tparam     Words       The most words of the reads, or 0
+    // ------------------------------------------------------------------------------------------------------
+    template <size_t Words>
+    inline size_t mismatches_kernel(const size_t read_idx, const word_container& haplotype) const
+    {
+        return mismatches_fixed<Words>(read_idx, haplotype);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the bit of a snp within its word
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type bit(const size_t snp_idx)
+    {
+        return word_type(1) << (bits_per_word - 1 - snp_idx % bits_per_word);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gathers the even bits of a word into its lower half, keeping their order
+    /// @param[in]  bits    The bits to gather
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type gather_even(word_type bits)
+    {
+        bits &= 0x5555555555555555ULL;
+        bits  = (bits | (bits >> 1 )) & 0x3333333333333333ULL;
+        bits  = (bits | (bits >> 2 )) & 0x0F0F0F0F0F0F0F0FULL;
+        bits  = (bits | (bits >> 4 )) & 0x00FF00FF00FF00FFULL;
+        bits  = (bits | (bits >> 8 )) & 0x0000FFFF0000FFFFULL;
+        bits  = (bits | (bits >> 16)) & 0x00000000FFFFFFFFULL;
+        return bits;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a mask of the lowest num_bits bits
+    /// @param[in]  num_bits    The number of bits in the mask, at most a word
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type low_mask(const size_t num_bits)
+    {
+        return num_bits >= bits_per_word ? ~word_type(0) : (word_type(1) << num_bits) - 1;
+    }
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <>
+inline size_t AllelePlanes::mismatches_kernel<0>(const size_t read_idx, const word_container& haplotype) const
+{
+    return mismatches(read_idx, haplotype);
+}
+
+template <typename ReadInfoType>
+AllelePlanes::AllelePlanes(const ReadInfoType& read_info, const size_t reads, const size_t snps)
+: _first_words(reads, 0), _offsets(reads + 1, 0), _snps(snps), _max_words(0)
+{
+    for (size_t read_idx = 0; read_idx < reads; ++read_idx) {
+        const auto&  info       = read_info[read_idx];
+        const size_t first_word = info.start_index() / bits_per_word;
+        const size_t last_word  = info.end_index()   / bits_per_word;
+        _first_words[read_idx]  = first_word;
+        _offsets[read_idx + 1]  = _offsets[read_idx] + last_word - first_word + 1;
+        _max_words              = std::max(_max_words, last_word - first_word + 1);
+    }
+    _alleles.assign(_offsets[reads], 0); _calls.assign(_offsets[reads], 0);
+}
+
+template <typename DataType, typename ReadInfoType>
+AllelePlanes::AllelePlanes(const DataType&       data     , const ReadInfoType& read_info,
+                           const size_t          reads    , const size_t        snps     )
+: AllelePlanes(read_info, reads, snps)
+{
+    constexpr size_t elements_per_word = DataType::elements_per_word;
+
+    for (size_t read_idx = 0; read_idx < reads; ++read_idx) {
+        const auto&  info       = read_info[read_idx];
+        const size_t first_word = _first_words[read_idx];
+
+        // Each chunk is at most a word of the packed data and does not cross a snp axis word
+        for (size_t snp_idx = info.start_index(); snp_idx <= info.end_index(); ) {
+            const size_t word_end = (snp_idx / bits_per_word + 1) * bits_per_word;
+            const size_t chunk    = std::min(std::min(word_end, info.end_index() + 1) - snp_idx, 
+                                             elements_per_word                                        );
+
+            // The low bit of an element is the allele and the high bit is set for gaps (2) and no value (3)
+            const word_type elements = data.get_range(info.offset() + snp_idx - info.start_index(), chunk);
+            const word_type called   = ~gather_even(elements >> 1) & low_mask(chunk);
+            const word_type alleles  = gather_even(elements) & called;
+
+            const size_t word_idx = _offsets[read_idx] + snp_idx / bits_per_word - first_word;
+            const size_t shift    = bits_per_word - snp_idx % bits_per_word - chunk;
+            _alleles[word_idx] |= alleles << shift;
+            _calls[word_idx]   |= called  << shift;
+            snp_idx += chunk;
+        }
+    }
+}
+
+template <typename CallsType, typename ReadInfoType>
+AllelePlanes AllelePlanes::from_calls(const CallsType& calls, const ReadInfoType& read_info, 
+                                      const size_t     reads, const size_t        snps     )
+{
+    AllelePlanes planes(read_info, reads, snps);
+    for (size_t read_idx = 0; read_idx < reads; ++read_idx) {
+        const size_t offset = planes._offsets[read_idx] - planes._first_words[read_idx];
+        calls.for_each_call(read_idx, [&](const size_t snp_idx, const uint8_t value)
+        {
+            const word_type bit = word_type(1) << (bits_per_word - 1 - snp_idx % bits_per_word);
+            planes._calls[offset + snp_idx / bits_per_word]   |= bit;
+            planes._alleles[offset + snp_idx / bits_per_word] |= value ? bit : 0;
+        });
+    }
+    return planes;
+}
+
+inline size_t AllelePlanes::calls(const size_t read_idx) const
+{
+    size_t num_calls = 0;
+    for (size_t i = _offsets[read_idx]; i < _offsets[read_idx + 1]; ++i) 
+        num_calls += __builtin_popcountll(_calls[i]);
+    return num_calls;
+}
+
+inline AllelePlanes::Overlap AllelePlanes::compare(const size_t read_one, const size_t read_two) const
+{
+    // Short reads fit in a few words, so use the kernel for the most words of any read
+    switch (_max_words) {
+        case 1 : return compare_fixed<1>(read_one, read_two);
+        case 2 : return compare_fixed<2>(read_one, read_two);
+        case 3 : 
+        case 4 : return compare_fixed<4>(read_one, read_two);
+        default: break;
+    }
+
+    Overlap overlap{0, 0, 0};
+    const size_t first_word = std::min(_first_words[read_one], _first_words[read_two]);
+    const size_t last_word  = std::max(_first_words[read_one] + _offsets[read_one + 1] - _offsets[read_one],
+                                       _first_words[read_two] + _offsets[read_two + 1] - _offsets[read_two]);
+
+    for (size_t word_idx = first_word; word_idx < last_word; ++word_idx) {
+        const word_type calls_one = call_word(read_one, word_idx), calls_two = call_word(read_two, word_idx);
+        const word_type shared    = calls_one & calls_two;
+        overlap.shared     += __builtin_popcountll(shared);
+        overlap.exclusive  += __builtin_popcountll(calls_one ^ calls_two);
+        overlap.mismatches += __builtin_popcountll(
+                                (allele_word(read_one, word_idx) ^ allele_word(read_two, word_idx)) & shared);
+    }
+    return overlap;
+}
+
+inline size_t AllelePlanes::mismatches(const size_t read_idx, const word_container& haplotype) const
+{
+    switch (_max_words) {
+        case 1 : return mismatches_fixed<1>(read_idx, haplotype);
+        case 2 : return mismatches_fixed<2>(read_idx, haplotype);
+        case 3 : 
+        case 4 : return mismatches_fixed<4>(read_idx, haplotype);
+        default: break;
+    }
+
+    size_t num_mismatches = 0;
+    for (size_t i = _offsets[read_idx], word_idx = _first_words[read_idx]; i < _offsets[read_idx + 1];
+         ++i, ++word_idx) {
+        num_mismatches += __builtin_popcountll((_alleles[i] ^ haplotype[word_idx]) & _calls[i]);
+    }
+    return num_mismatches;
+}
+
+inline size_t AllelePlanes::mec_score(const word_container& haplo_one, const word_container& haplo_two) const
+{
+    // Select the kernel once for all the reads
+    switch (_max_words) {
+        case 1 : return mec_score_kernel<1>(haplo_one, haplo_two);
+        case 2 : return mec_score_kernel<2>(haplo_one, haplo_two);
+        case 3 : 
+        case 4 : return mec_score_kernel<4>(haplo_one, haplo_two);
+        default: return mec_score_kernel<0>(haplo_one, haplo_two);
+    }
+}
+
+inline size_t AllelePlanes::hash(const size_t read_idx) const
+{
+    switch (_max_words) {
+        case 1 : return hash_fixed<1>(read_idx);
+        case 2 : return hash_fixed<2>(read_idx);
+        case 3 : 
+        case 4 : return hash_fixed<4>(read_idx);
+        default: break;
+    }
+
+    size_t hash = 0;
+    for (size_t i = _offsets[read_idx], word_idx = _first_words[read_idx]; i < _offsets[read_idx + 1];
+         ++i, ++word_idx) {
+        hash ^= mix(word_idx, _calls[i], _alleles[i]);
+    }
+    return hash;
+}
+
+template <size_t Words>
+AllelePlanes::Overlap AllelePlanes::compare_fixed(const size_t read_one, const size_t read_two) const
+{
+    word_type calls_one[Words], calls_two[Words], alleles_one[Words], alleles_two[Words];
+    load(_calls, read_one, calls_one); load(_alleles, read_one, alleles_one);
+    load(_calls, read_two, calls_two); load(_alleles, read_two, alleles_two);
+
+    // Word i of the first read holds the same snps as word i - shift of the second
+    const int64_t shift = int64_t(_first_words[read_two]) - int64_t(_first_words[read_one]);
+    size_t total = 0, shared = 0, mismatches = 0;
+    for (size_t i = 0; i < Words; ++i) {
+        total += __builtin_popcountll(calls_one[i]) + __builtin_popcountll(calls_two[i]);
+
+        const int64_t j = int64_t(i) - shift;
+        if (j < 0 || j >= int64_t(Words)) continue;
+        const word_type both = calls_one[i] & calls_two[j];
+        shared     += __builtin_popcountll(both);
+        mismatches += __builtin_popcountll((alleles_one[i] ^ alleles_two[j]) & both);
+    }
+    return Overlap{shared, mismatches, total - 2 * shared};
+}
+
+template <size_t Words>
+size_t AllelePlanes::mismatches_fixed(const size_t read_idx, const word_container& haplotype) const
+{
+    word_type calls[Words], alleles[Words];
+    load(_calls, read_idx, calls); load(_alleles, read_idx, alleles);
+
+    const size_t first_word = _first_words[read_idx];
+    size_t num_mismatches = 0;
+    for (size_t i = 0; i < Words; ++i) {
+        const word_type haplo = first_word + i < haplotype.size() ? haplotype[first_word + i] : 0;
+        num_mismatches += __builtin_popcountll((alleles[i] ^ haplo) & calls[i]);
+    }
+    return num_mismatches;
+}
+
+template <size_t Words>
+size_t AllelePlanes::hash_fixed(const size_t read_idx) const
+{
+    word_type calls[Words], alleles[Words];
+    load(_calls, read_idx, calls); load(_alleles, read_idx, alleles);
+
+    size_t hash = 0;
+    for (size_t i = 0; i < Words; ++i) hash ^= mix(_first_words[read_idx] + i, calls[i], alleles[i]);
+    return hash;
+}
+
+template <size_t Words>
+size_t AllelePlanes::mec_score_kernel(const word_container& haplo_one, const word_container& haplo_two) const
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, reads()), size_t(0),
+        [&](const tbb::blocked_range<size_t>& read_ids, size_t mec_score) -> size_t
+        {
+            for (size_t read_idx = read_ids.begin(); read_idx != read_ids.end(); ++read_idx) {
+                mec_score += std::min(mismatches_kernel<Words>(read_idx, haplo_one), 
+                                      mismatches_kernel<Words>(read_idx, haplo_two));
+            }
+            return mec_score;
+        },
+        std::plus<size_t>()
+    );
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_ALLELE_PLANES_HPP
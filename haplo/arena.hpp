@@ -0,0 +1,378 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   arena.hpp
+/// @brief  Header file for the arena allocator which the transient structures for solving a sub-block are
+///         allocated from, so that they are freed all at once when the sub-block has been merged
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_ARENA_HPP
+#define PARAHAPLO_ARENA_HPP
+
+#include <tbb/spin_mutex.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+    #include <sys/mman.h>
+#endif
+
+// The largest chunk of memory an arena gets from the system (2MB is the size of a huge page)
+#ifndef ARENA_CHUNK_BYTES
+    #define ARENA_CHUNK_BYTES       (size_t(1) << 21)
+#endif
+
+// The first chunk of an arena, each chunk after it is twice the size of the one before, up to the largest
+#ifndef ARENA_FIRST_CHUNK_BYTES
+    #define ARENA_FIRST_CHUNK_BYTES (size_t(1) << 14)
+#endif
+
+// The most arenas a pool keeps for reuse (0 for the number of hardware threads)
+#ifndef ARENA_POOL_ARENAS
+    #define ARENA_POOL_ARENAS       0
+#endif
+
+// If the chunks of an arena are backed by huge pages (where the system supports it)
+#ifndef ARENA_HUGE_PAGES
+    #define ARENA_HUGE_PAGES    0
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Arena
+/// @brief      Bump allocator which hands out memory from chunks which double in size, from a small first
+///             chunk up to a largest size, so that an arena for a small sub-block stays small. Nothing is
+///             freed until the arena is reset, which makes all the memory available again but keeps the
+///             chunks, so that solving the next sub-block with the arena does not go to the system allocator.
+///             Allocation is thread safe since the parallel loops of a sub-block can add to its containers
+///             from any thread
+// ----------------------------------------------------------------------------------------------------------
+class Arena {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using mutex_type    = tbb::spin_mutex;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Chunk
+    /// @brief      A chunk of memory from the system
+    // ------------------------------------------------------------------------------------------------------
+    struct Chunk {
+        char*   memory;     //!< The start of the chunk
+        size_t  bytes;      //!< The size of the chunk
+        bool    mapped;     //!< If the chunk was mapped, rather than allocated with new
+    };
+
+    std::vector<Chunk>  _chunks;        //!< The chunks of memory
+    size_t              _current;       //!< The chunk which is being allocated from
+    size_t              _top;           //!< The offset of the free memory in the current chunk
+    size_t              _used;          //!< The number of bytes handed out since the last reset
+    size_t              _chunk_bytes;   //!< The largest chunk to get from the system
+    size_t              _first_bytes;   //!< The size of the first chunk to get from the system
+    bool                _huge_pages;    //!< If the chunks should be backed by huge pages
+    mutex_type          _mutex;         //!< Mutex for allocating from multiple threads
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the chunk sizes, no memory is allocated until it is needed
+    /// @param[in]  chunk_bytes     The largest chunk to get from the system
+    /// @param[in]  huge_pages      If the chunks should be backed by huge pages
+    /// @param[in]  first_bytes     The size of the first chunk to get from the system
+    // ------------------------------------------------------------------------------------------------------
+    explicit Arena(const size_t chunk_bytes = ARENA_CHUNK_BYTES      , 
+                   const bool   huge_pages  = ARENA_HUGE_PAGES       ,
+                   const size_t first_bytes = ARENA_FIRST_CHUNK_BYTES)
+    : _current(0), _top(0), _used(0), _chunk_bytes(chunk_bytes), 
+      _first_bytes(std::min(first_bytes, chunk_bytes)), _huge_pages(huge_pages) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Destructor -- gives all the chunks back to the system
+    // ------------------------------------------------------------------------------------------------------
+    ~Arena() { release(); }
+
+    Arena(const Arena&)             = delete;
+    Arena& operator=(const Arena&)  = delete;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Allocates memory from the arena
+    /// @param[in]  bytes       The number of bytes to allocate
+    /// @param[in]  alignment   The alignment of the memory, must be a power of 2
+    /// @return     A pointer to the memory
+    // ------------------------------------------------------------------------------------------------------
+    void* allocate(const size_t bytes, const size_t alignment = alignof(std::max_align_t));
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Makes all the memory of the arena available again, without giving the chunks back to the
+    ///             system. Nothing allocated from the arena can be used after the reset
+    // ------------------------------------------------------------------------------------------------------
+    inline void reset()
+    {
+        mutex_type::scoped_lock lock(_mutex);
+        _current = 0; _top = 0; _used = 0;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gives all the chunks back to the system
+    // ------------------------------------------------------------------------------------------------------
+    void release();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of bytes which have been allocated since the last reset
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t bytes_used() const { return _used; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of bytes which the arena has from the system
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t bytes_reserved() const
+    {
+        size_t bytes = 0;
+        for (const auto& chunk : _chunks) bytes += chunk.bytes;
+        return bytes;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the arena which allocators created on this thread use, nullptr if there is none
+    // ------------------------------------------------------------------------------------------------------
+    static Arena*& current()
+    {
+        static thread_local Arena* arena = nullptr;
+        return arena;
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a chunk from the system, twice the size of the last one up to the largest chunk size,
+    ///             and makes it the current chunk
+    /// @param[in]  bytes   The least number of bytes in the chunk
+    // ------------------------------------------------------------------------------------------------------
+    void add_chunk(const size_t bytes);
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+inline void* Arena::allocate(const size_t bytes, const size_t alignment)
+{
+    mutex_type::scoped_lock lock(_mutex);
+
+    // Look for room in the current chunk and then in the chunks kept from before the last reset
+    while (_current < _chunks.size()) {
+        const auto& chunk = _chunks[_current];
+        const auto  start = reinterpret_cast<uintptr_t>(chunk.memory);
+        const auto  begin = ((start + _top + alignment - 1) & ~(alignment - 1)) - start;
+        if (begin + bytes <= chunk.bytes) {
+            _top   = begin + bytes;
+            _used += bytes;
+            return chunk.memory + begin;
+        }
+        ++_current; _top = 0;
+    }
+
+    add_chunk(bytes + alignment);
+    _top   = bytes;
+    _used += bytes;
+    return _chunks.back().memory;
+}
+
+inline void Arena::release()
+{
+    mutex_type::scoped_lock lock(_mutex);
+    for (const auto& chunk : _chunks) {
+#ifdef __linux__
+        if (chunk.mapped) { munmap(chunk.memory, chunk.bytes); continue; }
+#endif
+        operator delete(chunk.memory);
+    }
+    _chunks.clear();
+    _current = 0; _top = 0; _used = 0;
+}
+
+inline void Arena::add_chunk(const size_t bytes)
+{
+    const size_t doubled = _chunks.empty() ? _first_bytes : std::min(2 * _chunks.back().bytes, _chunk_bytes);
+    Chunk        chunk{nullptr, std::max(bytes, doubled), false};
+
+#ifdef __linux__
+    // Map the chunk so that it is page aligned, and ask for huge pages, which the system may ignore
+    if (_huge_pages) {
+        void* memory = mmap(nullptr, chunk.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED) {
+    #ifdef MADV_HUGEPAGE
+            madvise(memory, chunk.bytes, MADV_HUGEPAGE);
+    #endif
+            chunk.memory = static_cast<char*>(memory);
+            chunk.mapped = true;
+        }
+    }
+#endif
+    if (chunk.memory == nullptr) chunk.memory = static_cast<char*>(operator new(chunk.bytes));
+
+    _chunks.push_back(chunk);
+    _current = _chunks.size() - 1;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ArenaScope
+/// @brief      Makes an arena the current arena of the thread for the lifetime of the scope, so that the
+///             containers created in the scope allocate from it
+// ----------------------------------------------------------------------------------------------------------
+class ArenaScope {
+private:
+    Arena*  _previous;      //!< The arena which was current before the scope
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- makes the arena the current arena of the thread
+    /// @param[in]  arena   The arena to allocate from in the scope
+    // ------------------------------------------------------------------------------------------------------
+    explicit ArenaScope(Arena& arena) : _previous(Arena::current()) { Arena::current() = &arena; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Destructor -- makes the previous arena the current arena of the thread again
+    // ------------------------------------------------------------------------------------------------------
+    ~ArenaScope() { Arena::current() = _previous; }
+
+    ArenaScope(const ArenaScope&)               = delete;
+    ArenaScope& operator=(const ArenaScope&)    = delete;
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ArenaPool
+/// @brief      Arenas which are reused between sub-blocks, so that the chunks they have are only allocated
+///             once for a job rather than once for each sub-block. The pool keeps at most a fixed number of
+///             arenas, the others give their chunks back to the system when they are released
+// ----------------------------------------------------------------------------------------------------------
+class ArenaPool {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using arena_pointer     = std::unique_ptr<Arena>;
+    using arena_container   = std::vector<arena_pointer>;
+    using mutex_type        = tbb::spin_mutex;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    arena_container     _arenas;        //!< The arenas which are not being used
+    size_t              _max_arenas;    //!< The most arenas to keep
+    bool                _huge_pages;    //!< If the arenas should be backed by huge pages
+    mutex_type          _mutex;         //!< Mutex for getting arenas from multiple threads
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets how many arenas to keep, and if the arenas which are created should be
+    ///             backed by huge pages
+    /// @param[in]  huge_pages  If the arenas should be backed by huge pages
+    /// @param[in]  max_arenas  The most arenas to keep (0 for the number of hardware threads)
+    // ------------------------------------------------------------------------------------------------------
+    explicit ArenaPool(const bool huge_pages = ARENA_HUGE_PAGES, const size_t max_arenas = ARENA_POOL_ARENAS)
+    : _max_arenas(max_arenas != 0 ? max_arenas : std::max(std::thread::hardware_concurrency(), 1u)), 
+      _huge_pages(huge_pages) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets an arena from the pool, or a new one if the pool is empty
+    // ------------------------------------------------------------------------------------------------------
+    inline arena_pointer acquire()
+    {
+        mutex_type::scoped_lock lock(_mutex);
+        if (_arenas.empty()) return arena_pointer(new Arena(ARENA_CHUNK_BYTES, _huge_pages));
+        auto arena = std::move(_arenas.back());
+        _arenas.pop_back();
+        return arena;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Resets an arena and gives it back to the pool, or frees it if the pool is full
+    /// @param[in]  arena   The arena to give back, nothing allocated from it can be used after this
+    // ------------------------------------------------------------------------------------------------------
+    inline void release(arena_pointer arena)
+    {
+        if (!arena) return;
+        arena->reset();
+        {
+            mutex_type::scoped_lock lock(_mutex);
+            if (_arenas.size() < _max_arenas) { _arenas.push_back(std::move(arena)); return; }
+        }
+        arena.reset();
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of arenas in the pool
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _arenas.size(); }
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ArenaAllocator
+/// @brief      Allocator for the standard and tbb containers which allocates from the arena which was current
+///             on the thread that created it, or from the heap if there was none. Deallocating memory from
+///             an arena does nothing, it is reclaimed when the arena is reset. Assigning to a container does
+///             not change where it allocates from, so a container never takes memory from another's arena
+/// @tparam     Type    The type of the elements to allocate
+// ----------------------------------------------------------------------------------------------------------
+template <typename Type>
+class ArenaAllocator {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using value_type                                = Type;
+    using pointer                                   = Type*;
+    using const_pointer                             = const Type*;
+    using size_type                                 = size_t;
+    using difference_type                           = std::ptrdiff_t;
+    using propagate_on_container_copy_assignment    = std::false_type;
+    using propagate_on_container_move_assignment    = std::false_type;
+    using propagate_on_container_swap               = std::true_type;
+
+    template <typename Other>
+    struct rebind { using other = ArenaAllocator<Other>; };
+    // ------------------------------------------------------------------------------------------------------
+private:
+    template <typename Other> friend class ArenaAllocator;
+
+    Arena*  _arena;     //!< The arena to allocate from, nullptr for the heap
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- uses the current arena of the thread
+    // ------------------------------------------------------------------------------------------------------
+    ArenaAllocator() noexcept : _arena(Arena::current()) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- uses a given arena
+    /// @param[in]  arena   The arena to allocate from, nullptr for the heap
+    // ------------------------------------------------------------------------------------------------------
+    explicit ArenaAllocator(Arena* arena) noexcept : _arena(arena) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- uses the arena of an allocator for another type
+    /// @param[in]  other   The allocator to use the arena of
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Other>
+    ArenaAllocator(const ArenaAllocator<Other>& other) noexcept : _arena(other._arena) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Allocates memory for a number of elements
+    /// @param[in]  n   The number of elements to allocate memory for
+    // ------------------------------------------------------------------------------------------------------
+    inline Type* allocate(const size_t n)
+    {
+        return static_cast<Type*>(_arena != nullptr ? _arena->allocate(n * sizeof(Type), alignof(Type))
+                                                    : operator new(n * sizeof(Type)));
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Deallocates memory, which only frees it if it is from the heap
+    /// @param[in]  ptr     The memory to deallocate
+    // ------------------------------------------------------------------------------------------------------
+    inline void deallocate(Type* ptr, const size_t) noexcept { if (_arena == nullptr) operator delete(ptr); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the arena which the allocator uses, nullptr for the heap
+    // ------------------------------------------------------------------------------------------------------
+    inline Arena* arena() const { return _arena; }
+
+    template <typename Other>
+    inline bool operator==(const ArenaAllocator<Other>& other) const { return _arena == other._arena; }
+
+    template <typename Other>
+    inline bool operator!=(const ArenaAllocator<Other>& other) const { return _arena != other._arena; }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_ARENA_HPP
@@ -0,0 +1,214 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   batch_evaluator.hpp
+/// @brief  Header file for the bit-sliced evaluator which finds the MEC scores of many candidate haplotype
+///         pairs at once
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_BATCH_EVALUATOR_HPP
+#define PARAHAPLO_BATCH_EVALUATOR_HPP
+
+#include <tbb/tbb.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      BatchEvaluator
+/// @brief      Evaluates the MEC score of 64 candidate haplotype pairs at once. The candidates are bit-sliced
+///             -- bit c of the word for a snp is the value of candidate c at the snp -- so each read's
+///             mismatches with the candidates are counted with bitwise (vertical) adders, where counter
+///             plane p holds bit p of the count for every candidate. The reads of a cluster are scored as
+///             one read with the calls of all of them
+/// @tparam     SubBlockType    The type of the sub-block to evaluate the candidates for
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class BatchEvaluator {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_type             = uint64_t;
+    using word_container        = std::vector<word_type>;
+    using index_container       = std::vector<size_t>;
+    using call_container        = std::vector<uint32_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t     LANES       = 64;           //!< Number of candidates evaluated at once
+    static constexpr size_t     MEC_PLANES  = 32;           //!< Planes of the MEC score totals
+private:
+    using total_planes          = std::array<word_type, MEC_PLANES>;
+
+    call_container      _calls;             //!< The snp index of each call (0 or 1 value), by cluster
+    word_container      _call_values;       //!< All ones for calls with a 1 value, otherwise 0
+    index_container     _call_offsets;      //!< The start of each cluster's calls
+    size_t              _count_planes;      //!< Planes for the mismatch counts of a cluster
+    size_t              _snps;
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- gets the calls of each cluster of reads in the sub-block
+    /// @param[in]  sub_block   The sub-block to evaluate candidates for
+    // ------------------------------------------------------------------------------------------------------
+    explicit BatchEvaluator(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the values of a candidate in bit-sliced haplotypes
+    /// @param[in]  haplo       The bit-sliced haplotype (a word for each snp)
+    /// @param[in]  candidate   The candidate (lane) to set
+    /// @param[in]  values      The value of the candidate at each snp
+    // ------------------------------------------------------------------------------------------------------
+    template <typename ValueContainer>
+    static void set_candidate(word_container& haplo, const size_t candidate, const ValueContainer& values)
+    {
+        const word_type mask = word_type(1) << candidate;
+        for (size_t i = 0; i < haplo.size(); ++i) haplo[i] = values[i] ? haplo[i] | mask : haplo[i] & ~mask;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the MEC score of all 64 candidate haplotype pairs
+    /// @param[in]  haplo_one   The bit-sliced first haplotypes of the candidates
+    /// @param[in]  haplo_two   The bit-sliced second haplotypes of the candidates
+    /// @param[out] mec_scores  The MEC score of each candidate
+    // ------------------------------------------------------------------------------------------------------
+    void evaluate(const word_container& haplo_one, const word_container& haplo_two,
+                  index_container&      mec_scores                                ) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of snps
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t snps() const { return _snps; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of calls (0 or 1 values) of the reads, which each evaluation goes through
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t calls() const { return _calls.size(); }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds a bit to each lane of a bit-sliced counter
+    /// @param[in]  planes      The planes of the counter
+    /// @param[in]  num_planes  The number of planes
+    /// @param[in]  bits        The bit to add to each lane
+    // ------------------------------------------------------------------------------------------------------
+    static inline void increment(word_type* planes, const size_t num_planes, word_type bits)
+    {
+        for (size_t p = 0; p < num_planes && bits; ++p) {
+            const word_type carry = planes[p] & bits;
+            planes[p] ^= bits;
+            bits       = carry;
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds one bit-sliced number to another
+    /// @param[in]  totals      The planes of the number to add to
+    /// @param[in]  values      The planes of the number to add
+    /// @param[in]  num_planes  The number of planes in values
+    // ------------------------------------------------------------------------------------------------------
+    static inline void add(total_planes& totals, const word_type* values, const size_t num_planes)
+    {
+        word_type carry = 0;
+        size_t    p     = 0;
+        for (; p < num_planes; ++p) {
+            const word_type sum = totals[p] ^ values[p] ^ carry;
+            carry     = (totals[p] & values[p]) | (carry & (totals[p] ^ values[p]));
+            totals[p] = sum;
+        }
+        for (; p < MEC_PLANES && carry; ++p) {
+            const word_type next = totals[p] & carry;
+            totals[p] ^= carry;
+            carry      = next;
+        }
+    }
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <typename SubBlockType>
+constexpr size_t BatchEvaluator<SubBlockType>::LANES;
+
+template <typename SubBlockType>
+constexpr size_t BatchEvaluator<SubBlockType>::MEC_PLANES;
+
+template <typename SubBlockType>
+BatchEvaluator<SubBlockType>::BatchEvaluator(SubBlockType& sub_block)
+: _call_offsets(sub_block.num_clusters() + 1, 0), _count_planes(1), _snps(sub_block.snp_info().size())
+{
+    // The reads which were discarded by the coverage cap have no calls, so they aren't scored
+    std::vector<index_container> members(sub_block.num_clusters());
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        if (sub_block.read_selected(read_idx)) members[sub_block.read_cluster(read_idx)].push_back(read_idx);
+    }
+
+    size_t max_calls = 0;
+    for (size_t cluster_idx = 0; cluster_idx < members.size(); ++cluster_idx) {
+        for (const auto read_idx : members[cluster_idx]) {
+            const auto& read_info = sub_block.read_info()[read_idx];
+            for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+                const auto value = sub_block(read_idx, snp_idx);
+                if (value > 1) continue;
+                _calls.push_back(static_cast<uint32_t>(snp_idx));
+                _call_values.push_back(value ? ~word_type(0) : word_type(0));
+            }
+        }
+        _call_offsets[cluster_idx + 1] = _calls.size();
+        max_calls = std::max(max_calls, _call_offsets[cluster_idx + 1] - _call_offsets[cluster_idx]);
+    }
+
+    // Enough planes to hold the number of calls of the largest cluster
+    while ((size_t(1) << _count_planes) <= max_calls) ++_count_planes;
+}
+
+template <typename SubBlockType>
+void BatchEvaluator<SubBlockType>::evaluate(const word_container& haplo_one, const word_container& haplo_two,
+                                            index_container&      mec_scores                                ) const
+{
+    const size_t clusters = _call_offsets.size() - 1;
+    total_planes zero_totals;
+    zero_totals.fill(0);
+
+    const total_planes totals = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, clusters), zero_totals,
+        [&](const tbb::blocked_range<size_t>& cluster_ids, total_planes totals) -> total_planes
+        {
+            word_type count_one[MEC_PLANES], count_two[MEC_PLANES], min_count[MEC_PLANES];
+
+            for (size_t cluster_idx = cluster_ids.begin(); cluster_idx != cluster_ids.end(); ++cluster_idx) {
+                std::fill(count_one, count_one + _count_planes, 0);
+                std::fill(count_two, count_two + _count_planes, 0);
+
+                // Count the mismatches with both haplotypes of every candidate
+                for (size_t i = _call_offsets[cluster_idx]; i < _call_offsets[cluster_idx + 1]; ++i) {
+                    increment(count_one, _count_planes, haplo_one[_calls[i]] ^ _call_values[i]);
+                    increment(count_two, _count_planes, haplo_two[_calls[i]] ^ _call_values[i]);
+                }
+
+                // Compare from the most significant plane to find the lanes where count_one < count_two
+                word_type less = 0, equal = ~word_type(0);
+                for (size_t p = _count_planes; p > 0; --p) {
+                    less  |= equal & ~count_one[p - 1] & count_two[p - 1];
+                    equal &= ~(count_one[p - 1] ^ count_two[p - 1]);
+                }
+                for (size_t p = 0; p < _count_planes; ++p)
+                    min_count[p] = (less & count_one[p]) | (~less & count_two[p]);
+
+                add(totals, min_count, _count_planes);
+            }
+            return totals;
+        },
+        [](total_planes a, const total_planes& b) -> total_planes
+        {
+            add(a, b.data(), MEC_PLANES);
+            return a;
+        }
+    );
+
+    // Convert the bit-sliced totals to a score for each candidate
+    mec_scores.assign(LANES, 0);
+    for (size_t lane = 0; lane < LANES; ++lane) {
+        for (size_t p = 0; p < MEC_PLANES; ++p)
+            mec_scores[lane] |= static_cast<size_t>((totals[p] >> lane) & 1) << p;
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_BATCH_EVALUATOR_HPP
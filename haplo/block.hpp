@@ -6,9 +6,17 @@
 #ifndef PARAHAPLO_BLOCK_HPP
 #define PARAHAPLO_BLOCK_HPP
 
+#include "allele_planes.hpp"
+#include "column_view.hpp"
+#include "concurrency.hpp"
+#include "numa.hpp"
 #include "operations.hpp"
+#include "rank_select.hpp"
+#include "read_index.hpp"
 #include "read_info.h"
+#include "read_table.hpp"
 #include "snp_info.hpp"
+#include "sparse_reads.hpp"
 #include "small_containers.h"
 
 #include <boost/iostreams/device/mapped_file.hpp>
@@ -17,7 +25,10 @@
 #include <tbb/concurrent_unordered_map.h>
 #include <tbb/parallel_sort.h>
 #include <thrust/host_vector.h>
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <stdexcept>
 #include <unordered_map>
@@ -42,31 +53,42 @@ using namespace io;
 /// @class      Block 
 /// @brief      Represents a block of input the for which the haplotypes must be determined
 /// @tparam     Elements    The number of elements in the input data
-/// @param      ThreadsX    The threads for the X direction 
-/// @param      ThreadsY    The threads for the Y direction 
+/// @param      ThreadsX    The threads for the X direction, the threads used are set by the concurrency
+/// @param      ThreadsY    The threads for the Y direction, the threads used are set by the concurrency
 // ----------------------------------------------------------------------------------------------------------
 template <size_t Elements, size_t ThreadsX = 1, size_t ThreadsY = 1>
 class Block {
 public:
     // ----------------------------------------- TYPES ALIAS'S ----------------------------------------------
-    using data_container        = BinaryArray<Elements, 2>;    
+    using data_container        = WordArray<Elements, 2>;
+    using data_pointer          = std::shared_ptr<data_container>;
     using binary_vector         = BinaryVector<2>;
     using atomic_type           = tbb::atomic<size_t>;
     using atomic_vector         = tbb::concurrent_vector<size_t>;
-    using read_info_container   = thrust::host_vector<ReadInfo>;
+    using offset_type           = typename std::conditional<(Elements > UINT32_MAX), 
+                                                            uint64_t, uint32_t>::type;
+    using read_info_container   = ReadTable<offset_type>;
     using snp_info_container    = tbb::concurrent_unordered_map<size_t, SnpInfo>;
     using concurrent_umap       = tbb::concurrent_unordered_map<size_t, uint8_t>;
     // ------------------------------------------------------------------------------------------------------
+    static constexpr double     SPARSE_DENSITY  = 1.0 / 16;     //!< Call density below which reads are sparse
 private:
     size_t              _rows;                  //!< The number of reads in the input data
     size_t              _cols;                  //!< The number of SNP sites in the container
     size_t              _first_splittable;      //!< 1st nono mono splittable solumn in splittale vector
-    size_t              _last_aligned;          //!< The last aligned value
-    data_container      _data;                  //!< Container for { '0' | '1' | '-' } data variables
+    data_pointer        _data;                  //!< Container for { '0' | '1' | '-' } data, null if sparse
     read_info_container _read_info;             //!< Information about each read (row)
+    ReadIndex           _read_index;            //!< Interval index of the reads over the columns
+    SparseReads         _sparse_reads;          //!< The calls of the reads, if the reads are sparse
+    bool                _sparse;                //!< If the elements are found from the sparse calls
     snp_info_container  _snp_info;              //!< Information about each snp (col)
     concurrent_umap     _flipped_cols;          //!< Columns which have been flipped
     atomic_vector       _splittable_cols;       //!< A vector of splittable columns
+    concurrent_umap     _weak_links;            //!< Splittable columns which are spanned by some reads
+    RankSelect          _informative_cols;      //!< Bitvector of the columns which aren't monotone
+    Concurrency         _concurrency;           //!< The threads and grain size the block is processed with
+    NumaNodes           _nodes;                 //!< The NUMA nodes the data is placed on
+    std::vector<size_t> _node_rows;             //!< The first row of each node, and the number of rows
     
     // Solutions for the entire block 
     binary_vector       _haplo_one;             //!< The first haplotype
@@ -75,8 +97,9 @@ public:
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Constructor to fill the block with data from the input file
     /// @param[in]  data_file       The file to fill the data with
+    /// @param[in]  concurrency     The threads and grain size to process the block and its sub-blocks with
     // ------------------------------------------------------------------------------------------------------
-    Block(const char* data_file);
+    Block(const char* data_file, const Concurrency& concurrency = Concurrency());
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets the value of an element, if it exists, otherwise returns 3
@@ -85,6 +108,27 @@ public:
     // ------------------------------------------------------------------------------------------------------
     uint8_t operator()(const size_t row_idx, const size_t col_idx) const;
     
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the column and the value of each call (0 or 1 element) of a read, in 
+    ///             column order, from the sparse calls if the reads are sparse
+    /// @param[in]  row_idx     The row index of the read
+    /// @param[in]  function    The function to call, which takes the column and the value
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    void for_each_call(const size_t row_idx, Function function) const;
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if the reads are stored sparsely instead of as packed data, because fewer
+    ///             than SPARSE_DENSITY of the elements between the start and end of the reads are calls
+    // ------------------------------------------------------------------------------------------------------
+    inline bool is_sparse() const { return _sparse; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the sparse calls of the reads, which has no reads unless the reads are sparse
+    // ------------------------------------------------------------------------------------------------------
+    inline const SparseReads& sparse_reads() const { return _sparse_reads; }
+    
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets the number of subblocks in the block
     // ------------------------------------------------------------------------------------------------------
@@ -107,9 +151,15 @@ public:
     // ------------------------------------------------------------------------------------------------------
     inline bool is_monotone(const size_t i) const 
     {
-        return i < _cols ? _snp_info.at(i).is_monotone() : false;
+        return i < _cols ? !_informative_cols.get(i) : false;
     }
     
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the bitvector of the columns which aren't monotone, the rank of a column is its index 
+    ///             with the monotone columns removed, and the select of an index is the column
+    // ------------------------------------------------------------------------------------------------------
+    inline const RankSelect& informative_cols() const { return _informative_cols; }
+    
     // ------------------------------------------------------------------------------------------------------A
     /// @brief      Returns true if the requested column is intrinsically herterozygous, false otherwise -- 
     ///             returns false if the index is out of range
@@ -130,21 +180,115 @@ public:
     /// @brief      Gets the information for a read
     /// @param[in]  i   The index of the read (row)
     // ------------------------------------------------------------------------------------------------------
-    inline const ReadInfo& read_info(const size_t i) const { return _read_info[i]; }    
+    inline ReadInfo read_info(const size_t i) const { return _read_info[i]; }    
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the interval index of the reads, to find the reads which cover columns
+    // ------------------------------------------------------------------------------------------------------
+    inline const ReadIndex& read_index() const { return _read_index; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the threads and grain size the block (and its sub-blocks) are processed with
+    // ------------------------------------------------------------------------------------------------------
+    inline const Concurrency& concurrency() const { return _concurrency; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Splits the rows between NUMA nodes, with about the same number of elements for each node, 
+    ///             and moves the data of each node's rows to the node. The sub-blocks are then solved on the 
+    ///             node which has most of their rows. If the block has a thread limit the nodes get arenas
+    ///             which share it, instead of the arenas of the given nodes
+    /// @param[in]  nodes   The nodes to place the data on
+    // ------------------------------------------------------------------------------------------------------
+    void place(const NumaNodes& nodes);
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the NUMA nodes the data is placed on, a single node if the block hasn't been placed
+    // ------------------------------------------------------------------------------------------------------
+    inline const NumaNodes& nodes() const { return _nodes; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the NUMA node which the data of a row is placed on
+    /// @param[in]  row_idx     The index of the row
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t row_node(const size_t row_idx) const 
+    {
+        const auto first = _node_rows.begin() + 1;
+        return std::upper_bound(first, _node_rows.end() - 1, row_idx) - first;
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the NUMA node which has the data of most of the rows of a sub-block
+    /// @param[in]  i   The index of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    size_t subblock_node(const size_t i) const;
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the data of the block, the elements of each read are contiguous from its offset -- a
+    ///             sparse block has no packed data, so its elements must be found with for_each_call
+    // ------------------------------------------------------------------------------------------------------
+    inline const data_container& data() const { return *_data; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the data of the block as allele and call planes
+    // ------------------------------------------------------------------------------------------------------
+    inline AllelePlanes allele_planes() const 
+    { 
+        return _sparse ? AllelePlanes::from_calls(*this, _read_info, _rows, _cols)
+                       : AllelePlanes(*_data, _read_info, _rows, _cols);
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the first haplotype of the block
+    // ------------------------------------------------------------------------------------------------------
+    inline const binary_vector& haplo_one() const { return _haplo_one; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the second haplotype of the block
+    // ------------------------------------------------------------------------------------------------------
+    inline const binary_vector& haplo_two() const { return _haplo_two; }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      The number of reads in the block (total number of rows)
     // ------------------------------------------------------------------------------------------------------
     inline size_t reads() const { return _rows; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Makes columns which are spanned by at most max_bridging reads splittable, so that the 
+    ///             sub-blocks joined by only a few reads are solved separately. Of each run of adjacent such 
+    ///             columns the one spanned by the fewest reads is used, and a column is only split if reads
+    ///             end and start at it, so that both sub-blocks have values there. The reads which span the
+    ///             column are in neither sub-block, and are used to orient the second sub-block when merged
+    /// @param[in]  max_bridging    The most reads which can span a column for it to be split
+    /// @return     The number of columns which were made splittable
+    // ------------------------------------------------------------------------------------------------------
+    size_t split_weak_links(const size_t max_bridging);
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if a column was made splittable by split_weak_links
+    /// @param[in]  i   The index of the column
+    // ------------------------------------------------------------------------------------------------------
+    inline bool is_weak_link(const size_t i) const { return _weak_links.find(i) != _weak_links.end(); }
 
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Merges the haplotype solution of a sub block into the final solution
+    /// @brief      Merges the haplotype solution of a sub block into the final solution, the sub-blocks 
+    ///             before it must already be merged
     /// @param[in]  sub_block       The sub-block to get the solution from 
     /// @tparam     SubBlockType    The type of the sub-block
     // ------------------------------------------------------------------------------------------------------
     template <typename SubBlockType>
     void merge_haplotype(const SubBlockType& sub_block);
     
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Merges the haplotype solutions of consecutive sub-blocks into the final solution, which is
+    ///             the same as merging them one at a time in order. The columns of the sub-blocks are found 
+    ///             in parallel, the orientation of each sub-block is then resolved at the boundaries, and the 
+    ///             haplotypes are written in parallel with each task owning whole bins
+    /// @param[in]  sub_blocks          Pointers to the sub-blocks, in order of their indices
+    /// @tparam     SubBlockPointers    The type of the container of pointers to the sub-blocks
+    // ------------------------------------------------------------------------------------------------------
+    template <typename SubBlockPointers>
+    void merge_haplotypes(const SubBlockPointers& sub_blocks);
+    
    // ------------------------------------------------------------------------------------------------------
     /// @brief      Determines the MEC score of the haplotpye 
     // ------------------------------------------------------------------------------------------------------
@@ -206,6 +350,24 @@ private:
     ///             from the start of the vector
     // ------------------------------------------------------------------------------------------------------
     void sort_splittable_cols();
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the MEC score of the reads which span a weak link, with the haplotypes of the 
+    ///             sub-block which starts at the link as they are, and swapped
+    /// @param[in]  sub_block       The sub-block which starts at the weak link
+    /// @param[in]  start_col       The first column of the sub-block
+    /// @param[in]  end_col         The last column of the sub-block
+    /// @param[in]  merged          Gets the merged value of a column before the link, which takes the 
+    ///                             column and the haplotype (0 or 1)
+    /// @tparam     SubBlockType    The type of the sub-block
+    /// @tparam     Merged          The type of the function to get the merged values
+    /// @return     The MEC score of the spanning reads without and with the haplotypes swapped
+    // ------------------------------------------------------------------------------------------------------
+    template <typename SubBlockType, typename Merged>
+    std::pair<size_t, size_t> weak_link_scores(const SubBlockType& sub_block, 
+                                               const size_t        start_col, 
+                                               const size_t        end_col  ,
+                                               Merged              merged   ) const;
 };
 
 // ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
@@ -213,22 +375,96 @@ private:
 // ----------------------------------------------- PUBLIC ---------------------------------------------------
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
-Block<Elements, ThreadsX, ThreadsY>::Block(const char* data_file)
-: _rows{0}, _cols{0}, _first_splittable{0}, _last_aligned{0}, _read_info{0}, _splittable_cols{0} 
+Block<Elements, ThreadsX, ThreadsY>::Block(const char* data_file, const Concurrency& concurrency)
+: _rows{0}, _cols{0}, _first_splittable{0}, _data(std::make_shared<data_container>()), _read_info{0}, 
+  _sparse{false}, 
+  _splittable_cols{0}, _concurrency(concurrency), _nodes(1)
 {
-    fill(data_file);                    // Get the data from the input file
-    process_snps();                     // Process the SNPs to determine block params
+    // Only the threads of the block's task arena process it
+    _concurrency.execute([&]
+    {
+        fill(data_file);                    // Get the data from the input file
+    
+        // Keep only the calls of sparse reads, such as long reads with many gaps, and free the packed data
+        size_t elements = 0, calls = 0;
+        for (size_t row_idx = 0; row_idx < _rows; ++row_idx) elements += _read_info[row_idx].length();
+        for (const auto& col_info : _snp_info) calls += col_info.second.zeros() + col_info.second.ones();
+        if (calls < SPARSE_DENSITY * elements) {
+            _sparse_reads = SparseReads(*_data, _read_info, _rows);
+            _sparse       = true;
+            _data.reset();
+        }
+    
+        _read_index = ReadIndex(_read_info, _rows);
+        process_snps();                     // Process the SNPs to determine block params
+    
+        _informative_cols = RankSelect(_cols, [&](const size_t col_idx) 
+                            { 
+                                const auto col_info = _snp_info.find(col_idx);
+                                return col_info == _snp_info.end() || !col_info->second.is_monotone(); 
+                            });
+    });
     
     // Resize the haplotypes
     _haplo_one.resize(_cols); _haplo_two.resize(_cols); 
+    _node_rows = { 0, _rows };
 } 
 
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::place(const NumaNodes& nodes)
+{
+    _nodes = _concurrency.threads() > 0 ? NumaNodes(nodes.size(), _concurrency.threads()) : nodes;
+    _node_rows.assign(nodes.size() + 1, _rows);
+    
+    // The elements of the rows are contiguous in row order, so each node's first row is the first which 
+    // starts after the elements of the nodes before it
+    const size_t elements = _rows == 0 ? 0 : _read_info[_rows - 1].offset() + _read_info[_rows - 1].length();
+    for (size_t node = 0, row_idx = 0; node < nodes.size(); ++node) {
+        while (row_idx < _rows && _read_info[row_idx].offset() * nodes.size() < node * elements) ++row_idx;
+        _node_rows[node] = row_idx;
+    }
+    
+    // The data was all touched by the thread which parsed the file, so move each node's words to it
+    if (_sparse) return;
+    constexpr size_t elements_per_word = data_container::elements_per_word;
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        if (_node_rows[node] == _node_rows[node + 1]) continue;
+        const size_t first_word = _read_info[_node_rows[node]].offset() / elements_per_word;
+        const size_t last_word  = node + 1 == nodes.size() ? _data->num_words() 
+                                : _read_info[_node_rows[node + 1]].offset() / elements_per_word;
+        _nodes.place(_data->words() + first_word, (last_word - first_word) * sizeof(uint64_t), node);
+    }
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+size_t Block<Elements, ThreadsX, ThreadsY>::subblock_node(const size_t i) const
+{
+    if (_nodes.size() == 1) return 0;
+    
+    std::vector<size_t> reads(_nodes.size(), 0);
+    for (const auto row_idx : _read_index.within(subblock(i), subblock(i + 1))) ++reads[row_node(row_idx)];
+    return std::max_element(reads.begin(), reads.end()) - reads.begin();
+}
+
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
 uint8_t Block<Elements, ThreadsX, ThreadsY>::operator()(const size_t row_idx, const size_t col_idx) const 
 {
     // If the element exists
-    return _read_info[row_idx].element_exists(col_idx) == true 
-        ? _data.get(_read_info[row_idx].offset() + col_idx - _read_info[row_idx].start_index()) : 0x03;
+    if (!_read_info[row_idx].element_exists(col_idx)) return 0x03;
+    return _sparse ? _sparse_reads(row_idx, col_idx)
+                   : _data->get(_read_info[row_idx].offset() + col_idx - _read_info[row_idx].start_index());
+} 
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY> template <typename Function>
+void Block<Elements, ThreadsX, ThreadsY>::for_each_call(const size_t row_idx, Function function) const 
+{
+    if (_sparse) { _sparse_reads.for_each_call(row_idx, function); return; }
+    
+    const auto read_info = _read_info[row_idx];
+    for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+        const auto value = _data->get(read_info.offset() + col_idx - read_info.start_index());
+        if (value <= ONE) function(col_idx, value);
+    }
 } 
 
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY> template <typename SubBlockType>
@@ -238,11 +474,23 @@ void Block<Elements, ThreadsX, ThreadsY>::merge_haplotype(const SubBlockType& su
     const size_t end_col   = _splittable_cols[sub_block.index() + _first_splittable + 1];        
     size_t sub_haplo_idx   = 0;                             // Haplo idx in sub block
     bool   flip_all        = false;                         // If we need to flip all the bits 
+    bool   swap_all        = false;                         // If we need to swap the haplotypes
   
-    if (sub_block.index() == 0) _last_aligned = sub_block.base_start_row() - 2;
-
+    // At a weak link the reads which span the link decide if the haplotypes are swapped, which keeps the
+    // values of the NIH columns
+    bool oriented = false;
+    if (sub_block.index() > 0 && is_weak_link(start_col)) {
+        const auto scores = weak_link_scores(sub_block, start_col, end_col, 
+                            [&](const size_t col_idx, const size_t haplo_idx) 
+                            {
+                                return haplo_idx == 0 ? _haplo_one.get(col_idx) : _haplo_two.get(col_idx);
+                            });
+        swap_all = scores.second < scores.first;
+        oriented = scores.second != scores.first;
+    }
+    
     // Check if we need to flip all bits
-    if (_haplo_one.get(start_col) != sub_block.haplo_one().get(0) && !is_monotone(start_col))
+    if (!oriented && _haplo_one.get(start_col) != sub_block.haplo_one().get(0) && !is_monotone(start_col))
         flip_all = true;
     
     // Go over all the columns and set the haplotypes 
@@ -253,42 +501,190 @@ void Block<Elements, ThreadsX, ThreadsY>::merge_haplotype(const SubBlockType& su
             _haplo_two.set(col_idx, operator()(_snp_info[col_idx].start_index(), col_idx));
         } else {
             // We need to get the solution from the sub block, but first check if this is a flipped column
+            uint8_t value_one = sub_block.haplo_one().get(sub_haplo_idx);
+            uint8_t value_two = sub_block.haplo_two().get(sub_haplo_idx);
             if ((_flipped_cols.find(col_idx) != _flipped_cols.end() && !flip_all) || flip_all) {
-                // We flip the bits from the haplotype
-                _haplo_one.set(col_idx, !sub_block.haplo_one().get(sub_haplo_idx));
-                _haplo_two.set(col_idx, !sub_block.haplo_two().get(sub_haplo_idx));
-                ++sub_haplo_idx;
-            } else {
-                // We don't need to flip any of the bits
-                _haplo_one.set(col_idx, sub_block.haplo_one().get(sub_haplo_idx));
-                _haplo_two.set(col_idx, sub_block.haplo_two().get(sub_haplo_idx));
-                ++sub_haplo_idx;  
-            }   
+                value_one = !value_one; value_two = !value_two;
+            }
+            if (swap_all) std::swap(value_one, value_two);
+            
+            _haplo_one.set(col_idx, value_one);
+            _haplo_two.set(col_idx, value_two);
+            ++sub_haplo_idx;
         }
     }
 }
 
-template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
-void Block<Elements, ThreadsX, ThreadsY>::determine_mec_score() const 
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY> template <typename SubBlockPointers>
+void Block<Elements, ThreadsX, ThreadsY>::merge_haplotypes(const SubBlockPointers& sub_blocks)
 {
-    size_t mec_score = 0;
-    
-    for (size_t read_idx = 0; read_idx < _rows; ++read_idx) {
-        size_t contrib_one = 0, contrib_two = 0;
-        for (size_t haplo_idx = 0; haplo_idx < _cols; ++haplo_idx) {
-            // For the first haplotype
-            if (_haplo_one.get(haplo_idx) != operator()(read_idx, haplo_idx) &&
-                operator()(read_idx, haplo_idx) <= 1                        ) {
-                    ++contrib_one;
+    const size_t num_sub_blocks = sub_blocks.size();
+    if (num_sub_blocks == 0) return;
+    
+    // The splittable columns which bound the sub-blocks, sub-block i is from bounds[i] to bounds[i + 1]
+    const auto bounds    = _splittable_cols.begin() + sub_blocks[0]->index() + _first_splittable;
+    const auto first_col = bounds[0], last_col = bounds[num_sub_blocks];
+    
+    // The owner of a column, a boundary column is owned by the sub-block after it, as it's merged last
+    auto owner = [&](const size_t col_idx) -> size_t
+    {
+        const size_t after = std::upper_bound(bounds, bounds + num_sub_blocks, col_idx) - bounds;
+        return after == 0 ? 0 : after - 1;
+    };
+    
+    const RankSelect flipped(_cols, [&](const size_t col_idx) 
+                             { 
+                                 return _flipped_cols.find(col_idx) != _flipped_cols.end(); 
+                             });
+    
+    // The values of the owned columns of each sub-block, before they are oriented, a byte per column so that 
+    // the sub-blocks don't share words, and the value of each sub-block at its end column
+    std::vector<uint8_t> values_one(last_col - first_col + 1), values_two(last_col - first_col + 1);
+    std::vector<uint8_t> end_one(num_sub_blocks), end_two(num_sub_blocks);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_sub_blocks, 1),
+        [&](const tbb::blocked_range<size_t>& indices)
+        {
+            for (size_t i = indices.begin(); i != indices.end(); ++i) {
+                const auto& sub_block     = *sub_blocks[i];
+                size_t      sub_haplo_idx = 0;
+                for (size_t col_idx = bounds[i]; col_idx <= bounds[i + 1]; ++col_idx) {
+                    uint8_t value_one, value_two;
+                    if (is_monotone(col_idx)) {
+                        value_one = value_two = operator()(_snp_info.at(col_idx).start_index(), col_idx);
+                    } else {
+                        value_one = sub_block.haplo_one().get(sub_haplo_idx) ^ flipped.get(col_idx);
+                        value_two = sub_block.haplo_two().get(sub_haplo_idx) ^ flipped.get(col_idx);
+                        ++sub_haplo_idx;
+                    }
+                    if (col_idx == bounds[i + 1]) { end_one[i] = value_one; end_two[i] = value_two; }
+                    if (col_idx != bounds[i + 1] || i + 1 == num_sub_blocks) {
+                        values_one[col_idx - first_col] = value_one; 
+                        values_two[col_idx - first_col] = value_two;
+                    }
+                }
             }
-            if (_haplo_two.get(haplo_idx) != operator()(read_idx, haplo_idx) &&
-                operator()(read_idx, haplo_idx) <= 1                        ) {
-                    ++contrib_two;
+        }
+    );
+    
+    // How each sub-block is oriented -- at a weak link the haplotypes are swapped, otherwise all the bits
+    // are flipped, which (as when merging one sub-block at a time) ignores the flipped columns
+    enum : uint8_t { keep = 0, swap_all = 1, flip_all = 2 };
+    std::vector<uint8_t> orientations(num_sub_blocks, keep);
+    auto orient = [&](const size_t i, const size_t col_idx, uint8_t& value_one, uint8_t& value_two)
+    {
+        if (orientations[i] == swap_all) {
+            std::swap(value_one, value_two);
+        } else if (orientations[i] == flip_all && !is_monotone(col_idx)) {
+            value_one ^= !flipped.get(col_idx); value_two ^= !flipped.get(col_idx);
+        }
+    };
+    
+    // Each sub-block is oriented against the merged values before it, so the orientations are resolved in
+    // order, which only looks at the boundary columns and the reads which span the weak links
+    auto merged = [&](const size_t col_idx, const size_t haplo_idx) -> uint8_t 
+    {
+        if (col_idx < first_col) return haplo_idx == 0 ? _haplo_one.get(col_idx) : _haplo_two.get(col_idx);
+        uint8_t value_one = values_one[col_idx - first_col], value_two = values_two[col_idx - first_col];
+        orient(owner(col_idx), col_idx, value_one, value_two);
+        return haplo_idx == 0 ? value_one : value_two;
+    };
+    for (size_t i = 0; i < num_sub_blocks; ++i) {
+        const auto& sub_block = *sub_blocks[i];
+        bool        oriented  = false;
+        if (sub_block.index() > 0 && is_weak_link(bounds[i])) {
+            const auto scores = weak_link_scores(sub_block, bounds[i], bounds[i + 1], merged);
+            orientations[i] = scores.second < scores.first ? swap_all : keep;
+            oriented        = scores.second != scores.first;
+        }
+        uint8_t before = _haplo_one.get(first_col);
+        if (i > 0) {
+            uint8_t before_two = end_two[i - 1];
+            before             = end_one[i - 1];
+            orient(i - 1, bounds[i], before, before_two);
+        }
+        if (!oriented && before != sub_block.haplo_one().get(0) && !is_monotone(bounds[i])) 
+            orientations[i] = flip_all;
+    }
+    
+    // Each task writes whole bins of the haplotypes
+    constexpr size_t bin_elements = binary_vector::elements_per_bin;
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(first_col / bin_elements, last_col / bin_elements + 1),
+        [&](const tbb::blocked_range<size_t>& bins)
+        {
+            size_t col_idx  = std::max(bins.begin() * bin_elements, size_t(first_col));
+            size_t end      = std::min(bins.end() * bin_elements, size_t(last_col + 1));
+            for (size_t i = owner(col_idx); col_idx < end; ++col_idx) {
+                while (i + 1 < num_sub_blocks && col_idx >= bounds[i + 1]) ++i;
+                uint8_t value_one = values_one[col_idx - first_col];
+                uint8_t value_two = values_two[col_idx - first_col];
+                orient(i, col_idx, value_one, value_two);
+                _haplo_one.set(col_idx, value_one);
+                _haplo_two.set(col_idx, value_two);
             }
         }
-        // Add the minimum contribution 
-        mec_score += std::min(contrib_one, contrib_two);
+    );
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+size_t Block<Elements, ThreadsX, ThreadsY>::split_weak_links(const size_t max_bridging)
+{
+    if (max_bridging == 0 || _cols == 0) return 0;
+    
+    // The number of reads which span each column (start before it and end after it)
+    std::vector<int64_t> bridging(_cols + 1, 0);
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        if (_read_info[row_idx].end_index() < _read_info[row_idx].start_index() + 2) continue;
+        ++bridging[_read_info[row_idx].start_index() + 1];
+        --bridging[_read_info[row_idx].end_index()];
+    }
+    for (size_t col_idx = 1; col_idx < _cols; ++col_idx) bridging[col_idx] += bridging[col_idx - 1];
+    
+    // Both sub-blocks need values at the split column, which only the reads ending or starting there have
+    std::vector<bool> splittable(_cols, false), starts(_cols, false), ends(_cols, false);
+    for (const auto col_idx : _splittable_cols) splittable[col_idx] = true;
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        const auto& read_info = _read_info[row_idx];
+        if (read_info.length() < 2) continue;
+        if (operator()(row_idx, read_info.start_index()) <= ONE) starts[read_info.start_index()] = true;
+        if (operator()(row_idx, read_info.end_index())   <= ONE) ends[read_info.end_index()]     = true;
+    }
+    
+    // Find the runs of weak columns, and split each at the column with the fewest bridging reads 
+    auto is_weak = [&](const size_t col_idx) 
+    {
+        return !splittable[col_idx] && !is_monotone(col_idx) && 
+               bridging[col_idx] <= static_cast<int64_t>(max_bridging);
+    };
+    
+    std::vector<size_t> weak_links;
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) {
+        if (!is_weak(col_idx)) continue;
+        size_t best = _cols;
+        for (; col_idx < _cols && is_weak(col_idx); ++col_idx) {
+            if (!starts[col_idx] || !ends[col_idx]) continue;
+            if (best == _cols || bridging[col_idx] < bridging[best]) best = col_idx;
+        }
+        if (best != _cols) weak_links.push_back(best);
+    }
+    
+    for (const auto col_idx : weak_links) {
+        _splittable_cols.push_back(col_idx);
+        _weak_links[col_idx] = 0;
     }
+    _first_splittable = 0;
+    sort_splittable_cols();
+    
+    return weak_links.size();
+}
+
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
+void Block<Elements, ThreadsX, ThreadsY>::determine_mec_score() const 
+{
+    const size_t mec_score = allele_planes().mec_score(
+                                AllelePlanes::haplotype_plane(_haplo_one.to_binary_vector()),
+                                AllelePlanes::haplotype_plane(_haplo_two.to_binary_vector()));
     std::cout << "MEC SCORE : " << mec_score << "\n";
 }
 
@@ -354,15 +750,15 @@ size_t Block<Elements, ThreadsX, ThreadsY>::process_data(size_t         offset
     for (const auto& element : read_data) {
         switch (element) {
             case '0':
-                _data.set(offset++, ZERO);
+                _data->set(offset++, ZERO);
                 set_col_params(col_idx, _rows, ZERO);
                 break;
             case '1':
-                _data.set(offset++, ONE);
+                _data->set(offset++, ONE);
                 set_col_params(col_idx,_rows, ONE);
                 break;
             case '-':
-                _data.set(offset++, TWO);
+                _data->set(offset++, TWO);
                 break;
             default:
                 std::cerr << "Error reading input data - exiting =(\n";
@@ -392,51 +788,43 @@ void Block<Elements, ThreadsX, ThreadsY>::set_col_params(const size_t  col_idx,
 template <size_t Elements, size_t ThreadsX, size_t ThreadsY>
 void Block<Elements, ThreadsX, ThreadsY>::process_snps()
 {
-    // We can use all the available cores for this 
-    const size_t threads = (ThreadsX + ThreadsY) < _cols ? (ThreadsX + ThreadsY) : _cols;
-    
     // Binary container for if a columns is splittable or not (not by default)
     binary_vector splittable_info(_cols);
     
-    // Over each column in the row
+    // The data in column major order, and the reads which aren't singular (have more than one element)
+    const ColumnView columns = _sparse ? ColumnView::from_calls(*this, _read_info, _rows, _cols)
+                                       : ColumnView(*_data, _read_info, _rows, _cols);
+    const auto       non_single_reads = ColumnView::lane_mask(_rows, [&](const size_t row_idx) 
+                                        { 
+                                            return _read_info[row_idx].length() > 1; 
+                                        });
+    
+    // For each column count the values of the non singular rows, a word of rows at a time, the column is
+    // splittable if no read spans it
     tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, threads),
-        [&](const tbb::blocked_range<size_t>& thread_ids)
+        tbb::blocked_range<size_t>(0, _cols, _concurrency.grain()),
+        [&](const tbb::blocked_range<size_t>& cols)
         {
-            for (size_t thread_id = thread_ids.begin(); thread_id != thread_ids.end(); ++thread_id) {
-                size_t thread_iters = ops::get_thread_iterations(thread_id, _cols, threads);
-    
-                // For each column we need to "walk" downwards and check how many non singular rows there are 
-                for (size_t it = 0; it < thread_iters; ++it) {
-                    size_t col_idx      = it * threads + thread_id;
-                    size_t non_single   = 0;                                // Number of non singular columns
-                    bool   splittable   = true;                             // Assume splittable
-                    auto&  col_info     = _snp_info[col_idx];
-                    
-                    // For each of the elements in the column 
-                    for (size_t row_idx = col_info.start_index(); row_idx <= col_info.end_index(); ++row_idx) {
-                        if (_read_info[row_idx].length() > 1 && operator()(row_idx, col_idx) <= 1)
-                            non_single++;
-                        
-                        // Check for the splittable condition
-                        if (_read_info[row_idx].start_index() < col_idx && 
-                            _read_info[row_idx].end_index()   > col_idx  )
-                                splittable = false;
-                    }
-                  
-                    // If the column fits the non-intrinsically heterozygous criteria, change the type
-                    if (!(std::min(col_info.zeros(), col_info.ones()) >= (non_single / 2)) 
-                           && !col_info.is_monotone()) {
-                        col_info.set_type(NIH);
-                    }
-                    
-                    // If there atre more 1's than 0's flip all the bits
-                    //if (col_info.ones() > col_info.zeros() && !col_info.is_monotone()) 
-                    //    flip_column_bits(col_idx, col_info.start_index(), col_info.end_index());
-                    
-                    // If the column is splittable, add it to the splittable info 
-                    if (splittable && !col_info.is_monotone()) _splittable_cols.push_back(col_idx);
+            for (size_t col_idx = cols.begin(); col_idx != cols.end(); ++col_idx) {
+                size_t counts[2];                                           // Values of non singular rows
+                bool   splittable   = !_read_index.is_spanned(col_idx);
+                auto&  col_info     = _snp_info[col_idx];
+                
+                columns.count(col_idx, non_single_reads, counts);
+                const size_t non_single = counts[0] + counts[1];
+              
+                // If the column fits the non-intrinsically heterozygous criteria, change the type
+                if (!(std::min(col_info.zeros(), col_info.ones()) >= (non_single / 2)) 
+                       && !col_info.is_monotone()) {
+                    col_info.set_type(NIH);
                 }
+                
+                // If there atre more 1's than 0's flip all the bits
+                //if (col_info.ones() > col_info.zeros() && !col_info.is_monotone()) 
+                //    flip_column_bits(col_idx, col_info.start_index(), col_info.end_index());
+                
+                // If the column is splittable, add it to the splittable info 
+                if (splittable && !col_info.is_monotone()) _splittable_cols.push_back(col_idx);
             }
         }
     );
@@ -451,13 +839,13 @@ void Block<Elements, ThreadsX, ThreadsY>::flip_column_bits(const size_t col_idx
 {
     for (size_t row_idx = col_start_row; row_idx <= col_end_row; ++row_idx) {
         size_t mem_offset    = _read_info[row_idx].offset() + col_idx - _read_info[row_idx].start_index(); 
-        auto   element_value = _data.get(mem_offset);
+        auto   element_value = _data->get(mem_offset);
         
         // Check that the element is not a gap, then set it
         if (element_value <= ONE) {                             
             element_value == ZERO 
-                ? _data.set(mem_offset, ONE)
-                : _data.set(mem_offset, ZERO);
+                ? _data->set(mem_offset, ONE)
+                : _data->set(mem_offset, ZERO);
         }
     }
     // Add that this column was flipped
@@ -472,13 +860,55 @@ void Block<Elements, ThreadsX, ThreadsY>::sort_splittable_cols()
     
     // Set the start index to be the first non-monotone column
     // tbb doesn't have erase and it'll be slow to erase from the front
-    while (_snp_info[_splittable_cols[_first_splittable]].is_monotone()) ++_first_splittable;
+    while (_first_splittable + 1 < _splittable_cols.size() &&
+           _snp_info[_splittable_cols[_first_splittable]].is_monotone()) ++_first_splittable;
     
     // Check that the last column is in the vector (just some error checking incase)
     if (_splittable_cols[_splittable_cols.size() - 1] != _cols - 1) 
         _splittable_cols.push_back(_cols - 1);
 }
 
+template <size_t Elements, size_t ThreadsX, size_t ThreadsY> template <typename SubBlockType, typename Merged>
+std::pair<size_t, size_t> Block<Elements, ThreadsX, ThreadsY>::weak_link_scores(
+                                                                const SubBlockType& sub_block,
+                                                                const size_t        start_col,
+                                                                const size_t        end_col  ,
+                                                                Merged              merged   ) const
+{
+    // The haplotypes of the sub-block for each column of the block, 3 for monotone columns
+    std::vector<uint8_t> sub_one(end_col - start_col + 1, THREE), sub_two(end_col - start_col + 1, THREE);
+    for (size_t col_idx = start_col, sub_haplo_idx = 0; col_idx <= end_col; ++col_idx) {
+        if (is_monotone(col_idx)) continue;
+        const uint8_t flipped = _flipped_cols.find(col_idx) != _flipped_cols.end();
+        sub_one[col_idx - start_col] = sub_block.haplo_one().get(sub_haplo_idx) ^ flipped;
+        sub_two[col_idx - start_col] = sub_block.haplo_two().get(sub_haplo_idx) ^ flipped;
+        ++sub_haplo_idx;
+    }
+    
+    // The columns before the link are already merged, so count the errors of the spanning reads against
+    // each haplotype on either side of the link, and pair the sides both ways
+    size_t mec_keep = 0, mec_swap = 0;
+    _read_index.for_each_covering(start_col, [&](const size_t row_idx) 
+    {
+        const auto read_info = _read_info[row_idx];
+        if (read_info.start_index() == start_col || read_info.end_index() == start_col) return;
+        
+        size_t before[2] = {0, 0}, after[2] = {0, 0};
+        for_each_call(row_idx, [&](const size_t col_idx, const uint8_t value) 
+        {
+            if (col_idx < start_col) {
+                before[0] += value != merged(col_idx, 0);
+                before[1] += value != merged(col_idx, 1);
+            } else if (col_idx <= end_col && sub_one[col_idx - start_col] <= ONE) {
+                after[0] += value != sub_one[col_idx - start_col];
+                after[1] += value != sub_two[col_idx - start_col];
+            }
+        });
+        mec_keep += std::min(before[0] + after[0], before[1] + after[1]);
+        mec_swap += std::min(before[0] + after[1], before[1] + after[0]);
+    });
+    return std::make_pair(mec_keep, mec_swap);
+}
 
 }           // End namespace haplo
 #endif      // PARAHAPLO_BLOCK_HPP
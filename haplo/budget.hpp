@@ -0,0 +1,217 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   budget.hpp
+/// @brief  Header file for the wall-clock budgets for solving a job (block) and each of its sub-blocks
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_BUDGET_HPP
+#define PARAHAPLO_BUDGET_HPP
+
+#include <tbb/tbb.h>
+#include <tbb/concurrent_vector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace haplo {
+
+class Budget;
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Deadline
+/// @brief      The time a sub-block has to be solved by, which can be extended with time which other
+///             sub-blocks didn't use if the solver is still improving. A default constructed deadline never
+///             expires. Solvers check the deadline between refinement iterations, so they always hold the best
+///             solution found before the deadline
+// ----------------------------------------------------------------------------------------------------------
+class Deadline {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using clock         = std::chrono::steady_clock;
+    using microseconds  = std::chrono::microseconds;
+    using atomic_time   = tbb::atomic<int64_t>;
+    using atomic_flag   = tbb::atomic<bool>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    Budget*         _budget;        //!< The budget the deadline is from, nullptr if unlimited
+    size_t          _index;         //!< The index of the sub-block the deadline is for
+    atomic_time     _end;           //!< The end time (microseconds from the clock's epoch)
+    atomic_flag     _hit;           //!< If the deadline was reached
+
+    friend class Budget;
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor for an unlimited deadline
+    // ------------------------------------------------------------------------------------------------------
+    Deadline() : _budget(nullptr), _index(0) { _end = 0; _hit = false; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor for a deadline from a budget
+    /// @param[in]  budget      The budget the deadline is from
+    /// @param[in]  index       The index of the sub-block the deadline is for
+    /// @param[in]  end         The end time (microseconds from the clock's epoch)
+    // ------------------------------------------------------------------------------------------------------
+    Deadline(Budget* budget, const size_t index, const int64_t end)
+    : _budget(budget), _index(index) { _end = end; _hit = false; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Copy constructor
+    /// @param[in]  other       The deadline to copy
+    // ------------------------------------------------------------------------------------------------------
+    Deadline(const Deadline& other) : _budget(other._budget), _index(other._index)
+    {
+        _end = static_cast<int64_t>(other._end); _hit = static_cast<bool>(other._hit);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks if the deadline has been reached, if it has and the solver is still improving then
+    ///             the deadline is extended with time other sub-blocks didn't use, if there is any
+    /// @param[in]  improving   If the solver improved its solution in the last iteration
+    /// @return     If the solver must stop
+    // ------------------------------------------------------------------------------------------------------
+    inline bool expired(const bool improving);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks if work which can't stop part way can finish before the deadline, from the time it
+    ///             is expected to take. If it can't the deadline is marked as reached, so the work is done
+    ///             some faster way and the sub-block is reported as at its budget
+    /// @param[in]  seconds     The time the work is expected to take
+    /// @return     If the work can be started
+    // ------------------------------------------------------------------------------------------------------
+    inline bool affords(const double seconds);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If the deadline was reached
+    // ------------------------------------------------------------------------------------------------------
+    inline bool hit() const { return _hit; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      The index of the sub-block the deadline is for
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t index() const { return _index; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      The current time in microseconds from the clock's epoch
+    // ------------------------------------------------------------------------------------------------------
+    static inline int64_t now()
+    {
+        return std::chrono::duration_cast<microseconds>(clock::now().time_since_epoch()).count();
+    }
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Budget
+/// @brief      Wall-clock budget for a job, which gives each sub-block a deadline. Time which a sub-block
+///             doesn't use goes into a pool which sub-blocks that are still improving at their deadline can
+///             take from, and no deadline goes past the end of the job
+// ----------------------------------------------------------------------------------------------------------
+class Budget {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using atomic_time       = tbb::atomic<int64_t>;
+    using index_container   = tbb::concurrent_vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    int64_t         _job_end;               //!< The end time of the job (microseconds from the clock's epoch)
+    int64_t         _sub_block_time;        //!< The time for each sub-block (microseconds)
+    atomic_time     _pool;                  //!< Time which sub-blocks finished early with (microseconds)
+    index_container _hit_sub_blocks;        //!< The sub-blocks which hit their deadline
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- the job starts when the budget is created
+    /// @param[in]  job_seconds         The time for the entire job
+    /// @param[in]  sub_block_seconds   The time for each sub-block
+    // ------------------------------------------------------------------------------------------------------
+    Budget(const double job_seconds, const double sub_block_seconds)
+    : _job_end(Deadline::now() + static_cast<int64_t>(job_seconds * 1e6)),
+      _sub_block_time(static_cast<int64_t>(sub_block_seconds * 1e6))
+    { _pool = 0; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the deadline for a sub-block, starting now
+    /// @param[in]  index   The index of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    Deadline deadline(const size_t index)
+    {
+        return Deadline(this, index, std::min(Deadline::now() + _sub_block_time, _job_end));
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finishes a sub-block, giving the time it didn't use to the pool and recording if it hit the
+    ///             deadline
+    /// @param[in]  deadline    The deadline of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    void finish(const Deadline& deadline)
+    {
+        const int64_t unused = deadline._end - Deadline::now();
+        if (unused > 0)     _pool += unused;
+        if (deadline.hit()) _hit_sub_blocks.push_back(deadline.index());
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Extends a deadline with time from the pool -- at most the time for a sub-block
+    /// @param[in]  deadline    The deadline to extend
+    /// @return     If the deadline was extended
+    // ------------------------------------------------------------------------------------------------------
+    bool extend(Deadline& deadline)
+    {
+        int64_t available = _pool;
+        while (available > 0) {
+            const int64_t grant = std::min(available, _sub_block_time);
+            if (_pool.compare_and_swap(available - grant, available) == available) {
+                deadline._end = std::min(Deadline::now() + grant, _job_end);
+                return true;
+            }
+            available = _pool;
+        }
+        return false;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If the time for the job has run out
+    // ------------------------------------------------------------------------------------------------------
+    inline bool job_expired() const { return Deadline::now() >= _job_end; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      The sub-blocks which hit their deadline
+    // ------------------------------------------------------------------------------------------------------
+    inline const index_container& hit_sub_blocks() const { return _hit_sub_blocks; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Prints the sub-blocks which hit their deadline
+    // ------------------------------------------------------------------------------------------------------
+    void print_report() const
+    {
+        std::cout << "SUB-BLOCKS AT BUDGET : " << _hit_sub_blocks.size() << "\n";
+        for (const auto index : _hit_sub_blocks) std::cout << index << " ";
+        if (!_hit_sub_blocks.empty()) std::cout << "\n";
+    }
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+inline bool Deadline::expired(const bool improving)
+{
+    if (_budget == nullptr) return false;
+
+    const int64_t current = now();
+    if (current < _end) return false;
+
+    // Reached the deadline, try and get more time if the solution is still getting better
+    if (improving && !_budget->job_expired() && _budget->extend(*this)) return false;
+
+    _hit = true;
+    return true;
+}
+
+inline bool Deadline::affords(const double seconds)
+{
+    if (_budget == nullptr) return true;
+    if (seconds * 1e6 < static_cast<double>(_end - now())) return true;
+
+    _hit = true;
+    return false;
+}
+
+}           // End namespace haplo
+#endif      // PARAHAPLO_BUDGET_HPP
@@ -5,28 +5,40 @@
 #ifndef PARHAPLO_BUFFER_HPP
 #define PARHAPLO_BUFFER_HPP
 
+#include "arena.hpp"
+
+#include <new>
+
 namespace haplo {
            
 // ----------------------------------------------------------------------------------------------------------
 /// @class      Buffer
-/// @brief      Wrapper for a buffer object
+/// @brief      Wrapper for a buffer object, which is allocated from the current arena of the thread if it has
+///             one, and otherwise from the heap
 /// @tparam     Type The type of object to create a buffer of
 // ----------------------------------------------------------------------------------------------------------
 template <typename Type>
 class Buffer {
 private:
-    void* _ptr;         //!< The pointer for the buffer
+    Arena*  _arena;     //!< The arena the buffer is from, nullptr if it is from the heap
+    void*   _ptr;       //!< The pointer for the buffer
 public:
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Constructor -- tries to create a buffer with a given size
     /// @param[in]  num_bytes   The number of bytes for the buffer
     // ------------------------------------------------------------------------------------------------------
-    Buffer(const size_t num_bytes) : _ptr(operator new(num_bytes, std::nothrow)) {}
+    Buffer(const size_t num_bytes) 
+    : _arena(Arena::current()), 
+      _ptr(_arena != nullptr ? _arena->allocate(num_bytes, alignof(Type)) 
+                             : operator new(num_bytes, std::nothrow)) {}
    
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Destructor for the buffer
+    /// @brief      Destructor for the buffer, memory from an arena is reclaimed when the arena is reset
     // ------------------------------------------------------------------------------------------------------
-    ~Buffer() { operator delete(_ptr); }
+    ~Buffer() { if (_arena == nullptr) operator delete(_ptr); }
+
+    Buffer(const Buffer&)               = delete;
+    Buffer& operator=(const Buffer&)    = delete;
 
     // ------------------------------------------------------------------------------------------------------
     /// @brief      For determining of the buffer was created successfully
@@ -0,0 +1,336 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   column_view.hpp
+/// @brief  Header file for the column major (snp major) copy of the packed 2 bit data of the reads, so that
+///         the column-wise algorithms read whole words of a column rather than one element of each read
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_COLUMN_VIEW_HPP
+#define PARAHAPLO_COLUMN_VIEW_HPP
+
+#include "arena.hpp"
+
+#include <tbb/tbb.h>
+#include <tbb/blocked_range2d.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ColumnView
+/// @brief      Holds the 2 bit elements of each column in 64 bit words which are aligned to the read axis
+///             (word w of a column holds rows 32w to 32w + 31, big endian), with 3 (not covered) for the rows
+///             which don't cover the column. Each column only stores the words from its first to its last
+///             covering row. Lane masks (the low bit of each 2 bit element) select the rows to include in
+///             comparisons and counts. The view is built by transposing 32 x 32 tiles of the data in parallel
+// ----------------------------------------------------------------------------------------------------------
+class ColumnView {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_type         = uint64_t;
+    using word_container    = std::vector<word_type, ArenaAllocator<word_type>>;
+    using index_container   = std::vector<uint32_t, ArenaAllocator<uint32_t>>;
+    using mask_container    = std::vector<word_type>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t     elements_per_word   = 32;
+    static constexpr word_type  low_lanes           = 0x5555555555555555ull;
+    static constexpr word_type  not_covered         = std::numeric_limits<word_type>::max();
+private:
+    word_container      _words;             //!< The words of all the columns
+    index_container     _first_words;       //!< The read axis word of the first word of each column
+    index_container     _offsets;           //!< The start of each column's words, and the end of the last
+    size_t              _rows;              //!< The number of rows
+    size_t              _cols;              //!< The number of columns
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- transposes the packed 2 bit elements of the reads
+    /// @param[in]  data        The packed 2 bit data of the reads
+    /// @param[in]  read_info   The information for each read (start, end and offset in the data)
+    /// @param[in]  rows        The number of rows (reads)
+    /// @param[in]  cols        The number of columns (snps)
+    /// @tparam     DataType    The type of the data container
+    /// @tparam     InfoType    The type of the read information container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename DataType, typename InfoType>
+    ColumnView(const DataType& data, const InfoType& read_info, const size_t rows, const size_t cols);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the view from the calls of each read rather than from packed data, the elements
+    ///             of the reads which aren't calls are gaps
+    /// @param[in]  calls       The calls of the reads, with a for_each_call(row_idx, function) member
+    /// @param[in]  read_info   The information for each read (start and end)
+    /// @param[in]  rows        The number of rows (reads)
+    /// @param[in]  cols        The number of columns (snps)
+    /// @tparam     CallsType   The type of the calls
+    /// @tparam     InfoType    The type of the read information container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename CallsType, typename InfoType>
+    static ColumnView from_calls(const CallsType& calls, const InfoType& read_info, 
+                                 const size_t     rows , const size_t    cols     );
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of rows
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t rows() const { return _rows; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of columns
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t cols() const { return _cols; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of words on the read axis
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t axis_words() const { return _rows / elements_per_word + 1; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a word of a column, which is all not covered outside the stored words
+    /// @param[in]  col_idx     The index of the column
+    /// @param[in]  axis_word   The index of the word on the read axis
+    // ------------------------------------------------------------------------------------------------------
+    inline word_type word(const size_t col_idx, const size_t axis_word) const
+    {
+        const size_t first = _first_words[col_idx], words = _offsets[col_idx + 1] - _offsets[col_idx];
+        return axis_word >= first && axis_word < first + words
+            ? _words[_offsets[col_idx] + axis_word - first] : not_covered;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets an element
+    /// @param[in]  row_idx     The index of the row
+    /// @param[in]  col_idx     The index of the column
+    // ------------------------------------------------------------------------------------------------------
+    inline uint8_t operator()(const size_t row_idx, const size_t col_idx) const
+    {
+        return (word(col_idx, row_idx / elements_per_word)
+                >> (62 - 2 * (row_idx % elements_per_word))) & 0x03;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks if two columns have the same elements in the rows of a lane mask
+    /// @param[in]  col_left    The index of the first column
+    /// @param[in]  col_right   The index of the second column
+    /// @param[in]  lanes       The lane mask of the rows to compare
+    // ------------------------------------------------------------------------------------------------------
+    bool equal(const size_t col_left, const size_t col_right, const mask_container& lanes) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Counts the 0 and the 1 elements of a column in the rows of a lane mask
+    /// @param[in]  col_idx     The index of the column
+    /// @param[in]  lanes       The lane mask of the rows to count
+    /// @param[out] counts      The number of 0 and of 1 elements
+    // ------------------------------------------------------------------------------------------------------
+    void count(const size_t col_idx, const mask_container& lanes, size_t (&counts)[2]) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates a lane mask with the rows which a predicate is true for
+    /// @param[in]  rows        The number of rows
+    /// @param[in]  predicate   The predicate, which takes the index of a row
+    /// @tparam     Predicate   The type of the predicate
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Predicate>
+    static mask_container lane_mask(const size_t rows, Predicate predicate)
+    {
+        mask_container lanes(rows / elements_per_word + 1, 0);
+        for (size_t row_idx = 0; row_idx < rows; ++row_idx) 
+            if (predicate(row_idx)) add_lane(lanes, row_idx);
+        return lanes;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds a row to a lane mask
+    /// @param[in]  lanes       The lane mask to add the row to
+    /// @param[in]  row_idx     The index of the row
+    // ------------------------------------------------------------------------------------------------------
+    static inline void add_lane(mask_container& lanes, const size_t row_idx)
+    {
+        lanes[row_idx / elements_per_word] |= word_type(1) << (62 - 2 * (row_idx % elements_per_word));
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Transposes a 32 x 32 tile of 2 bit elements in place, element j of word k becomes element
+    ///             k of word j
+    /// @param[in]  tile    The words of the tile
+    // ------------------------------------------------------------------------------------------------------
+    static void transpose(word_type* tile);
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- finds the words of each column, which are all not covered
+    /// @param[in]  read_info   The information for each read (start and end)
+    /// @param[in]  rows        The number of rows (reads)
+    /// @param[in]  cols        The number of columns (snps)
+    /// @tparam     InfoType    The type of the read information container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename InfoType>
+    ColumnView(const InfoType& read_info, const size_t rows, const size_t cols);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the lanes of the 0 elements of a word
+    /// @param[in]  word    The word to get the 0 elements of
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type zero_lanes(const word_type word) { return ~(word | (word >> 1)) & low_lanes; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the lanes of the 1 elements of a word
+    /// @param[in]  word    The word to get the 1 elements of
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type one_lanes(const word_type word) { return word & ~(word >> 1) & low_lanes; }
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <typename InfoType>
+ColumnView::ColumnView(const InfoType& read_info, const size_t rows, const size_t cols)
+: _first_words(cols, 0), _offsets(cols + 1, 0), _rows(rows), _cols(cols)
+{
+    constexpr size_t epw = elements_per_word;
+
+    // The first and last covering row of each column, which bound its words
+    std::vector<size_t> first_rows(cols, rows), last_rows(cols, 0);
+    for (size_t row_idx = 0; row_idx < rows; ++row_idx) {
+        const auto read = read_info[row_idx];
+        for (size_t col_idx = read.start_index(); col_idx <= read.end_index() && col_idx < cols; ++col_idx) {
+            first_rows[col_idx] = std::min(first_rows[col_idx], row_idx);
+            last_rows[col_idx]  = std::max(last_rows[col_idx] , row_idx);
+        }
+    }
+    for (size_t col_idx = 0; col_idx < cols; ++col_idx) {
+        const bool covered    = first_rows[col_idx] <= last_rows[col_idx];
+        _first_words[col_idx] = covered ? first_rows[col_idx] / epw : 0;
+        _offsets[col_idx + 1] = _offsets[col_idx]
+                              + (covered ? last_rows[col_idx] / epw - first_rows[col_idx] / epw + 1 : 0);
+    }
+    _words.assign(_offsets[cols], word_type(not_covered));
+}
+
+template <typename DataType, typename InfoType>
+ColumnView::ColumnView(const DataType& data, const InfoType& read_info, const size_t rows, const size_t cols)
+: ColumnView(read_info, rows, cols)
+{
+    constexpr size_t epw = elements_per_word;
+
+    // Transpose each tile of 32 rows and 32 columns which has any elements
+    tbb::parallel_for(
+        tbb::blocked_range2d<size_t>(0, rows / epw + 1, 0, cols / epw + 1),
+        [&](const tbb::blocked_range2d<size_t>& tiles)
+        {
+            word_type tile[epw];
+            for (size_t row_word = tiles.rows().begin(); row_word != tiles.rows().end(); ++row_word) {
+                for (size_t col_word = tiles.cols().begin(); col_word != tiles.cols().end(); ++col_word) {
+                    const size_t start_col = col_word * epw, end_col = start_col + epw - 1;
+                    bool         empty     = true;
+
+                    // Each row of the tile is the covered part of the read, with 3 for the rest
+                    for (size_t k = 0; k < epw; ++k) {
+                        const size_t row_idx = row_word * epw + k;
+                        tile[k]              = not_covered;
+                        if (row_idx >= rows) continue;
+
+                        const auto   read  = read_info[row_idx];
+                        const size_t start = std::max(read.start_index(), start_col);
+                        const size_t end   = std::min(read.end_index()  , end_col);
+                        if (start > end) continue;
+
+                        const size_t num_bits = (end - start + 1) * 2, shift = (end_col - end) * 2;
+                        const auto   mask     = num_bits == 64 ? word_type(not_covered) 
+                                                               : (word_type(1) << num_bits) - 1;
+                        const auto   values   = data.get_range(read.offset() + start - read.start_index(),
+                                                               end - start + 1);
+                        tile[k] = (not_covered & ~(mask << shift)) | (word_type(values) << shift);
+                        empty   = false;
+                    }
+                    if (empty) continue;
+
+                    transpose(tile);
+                    for (size_t j = 0; j < epw && start_col + j < cols; ++j) {
+                        const size_t col_idx = start_col + j, first = _first_words[col_idx];
+                        if (row_word >= first && row_word < first + _offsets[col_idx + 1] - _offsets[col_idx])
+                            _words[_offsets[col_idx] + row_word - first] = tile[j];
+                    }
+                }
+            }
+        }
+    );
+}
+
+template <typename CallsType, typename InfoType>
+ColumnView ColumnView::from_calls(const CallsType& calls, const InfoType& read_info, 
+                                  const size_t     rows , const size_t    cols     )
+{
+    constexpr size_t epw = elements_per_word;
+    ColumnView       view(read_info, rows, cols);
+
+    // The rows of a read axis word only change that word of each column, so the words are set in parallel
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, rows / epw + 1),
+        [&](const tbb::blocked_range<size_t>& row_words)
+        {
+            for (size_t row_idx = row_words.begin() * epw; row_idx < std::min(row_words.end() * epw, rows); 
+                 ++row_idx) {
+                const size_t shift = 62 - 2 * (row_idx % epw);
+                auto element = [&](const size_t col_idx) -> word_type&
+                {
+                    return view._words[view._offsets[col_idx] + row_idx / epw - view._first_words[col_idx]];
+                };
+
+                // Covered elements are gaps (2) unless they are calls
+                const auto read = read_info[row_idx];
+                for (size_t col_idx = read.start_index(); col_idx <= read.end_index() && col_idx < cols; 
+                     ++col_idx) 
+                    element(col_idx) &= ~(word_type(1) << shift);
+                calls.for_each_call(row_idx, [&](const size_t col_idx, const uint8_t value)
+                {
+                    if (col_idx >= cols) return;
+                    auto& word = element(col_idx);
+                    word = (word & ~(word_type(3) << shift)) | (word_type(value) << shift);
+                });
+            }
+        }
+    );
+    return view;
+}
+
+inline bool ColumnView::equal(const size_t           col_left ,
+                              const size_t           col_right,
+                              const mask_container&  lanes    ) const
+{
+    // Outside of the words of both columns, both are all not covered
+    const size_t start = std::min(_first_words[col_left], _first_words[col_right]);
+    const size_t end   = std::max(_first_words[col_left]  + _offsets[col_left + 1]  - _offsets[col_left],
+                                  _first_words[col_right] + _offsets[col_right + 1] - _offsets[col_right]);
+    for (size_t axis_word = start; axis_word < end; ++axis_word) {
+        const word_type difference = word(col_left, axis_word) ^ word(col_right, axis_word);
+        if ((difference | (difference >> 1)) & low_lanes & lanes[axis_word]) return false;
+    }
+    return true;
+}
+
+inline void ColumnView::count(const size_t col_idx, const mask_container& lanes, size_t (&counts)[2]) const
+{
+    counts[0] = 0; counts[1] = 0;
+    const size_t first = _first_words[col_idx];
+    for (size_t i = _offsets[col_idx]; i < _offsets[col_idx + 1]; ++i) {
+        const word_type selected = lanes[first + i - _offsets[col_idx]];
+        counts[0] += __builtin_popcountll(zero_lanes(_words[i]) & selected);
+        counts[1] += __builtin_popcountll(one_lanes(_words[i])  & selected);
+    }
+}
+
+inline void ColumnView::transpose(word_type* tile)
+{
+    // Swap the off diagonal blocks of elements, halving the block size each time
+    word_type mask = 0x00000000FFFFFFFFull;
+    for (size_t j = 16; j != 0; j >>= 1, mask ^= (mask << (2 * j))) {
+        for (size_t k = 0; k < elements_per_word; k = (k + j + 1) & ~j) {
+            const word_type t = (tile[k] ^ (tile[k + j] >> (2 * j))) & mask;
+            tile[k]     ^= t;
+            tile[k + j] ^= t << (2 * j);
+        }
+    }
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_COLUMN_VIEW_HPP
@@ -0,0 +1,68 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   concurrency.hpp
+/// @brief  Header file for the runtime concurrency settings of a job, which run its parallel work in its own
+///         task arena so that several jobs can share a node without oversubscribing it
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_CONCURRENCY_HPP
+#define PARAHAPLO_CONCURRENCY_HPP
+
+#include <tbb/tbb.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Concurrency
+/// @brief      The number of threads a job can use and the grain size of its parallel loops. With a number of
+///             threads the work of the job is executed in a task arena with that many slots, which is shared
+///             by the copies of the settings (a block and its sub-blocks), otherwise it runs in the arena of
+///             the calling thread and can use all the threads
+// ----------------------------------------------------------------------------------------------------------
+class Concurrency {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using arena_pointer     = std::shared_ptr<tbb::task_arena>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    size_t          _threads;           //!< The most threads the job uses, 0 for all of them
+    size_t          _grain;             //!< The grain size of the parallel loops over rows and columns
+    arena_pointer   _arena;             //!< The arena the job's work is executed in
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the threads and the grain size
+    /// @param[in]  threads     The most threads the job can use, 0 to use all of them
+    /// @param[in]  grain       The grain size of the parallel loops over rows and columns
+    // ------------------------------------------------------------------------------------------------------
+    explicit Concurrency(const size_t threads = 0, const size_t grain = 1)
+    : _threads(threads), _grain(std::max(grain, size_t(1))),
+      _arena(threads == 0 ? nullptr : std::make_shared<tbb::task_arena>(static_cast<int>(threads))) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most threads the job can use, 0 if it can use all of them
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t threads() const { return _threads; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the grain size of the parallel loops over rows and columns
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t grain() const { return _grain; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Executes a function in the arena of the job, so the parallel loops it starts only use the
+    ///             threads of the job -- calling it from work already in the arena runs the function directly
+    /// @param[in]  function    The function to execute
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    inline void execute(Function function) const
+    {
+        if (_arena) _arena->execute(function); else function();
+    }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_CONCURRENCY_HPP
@@ -0,0 +1,477 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   dispatcher.hpp
+/// @brief  Header file for the dispatcher which chooses the engine to solve each sub-block with
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_DISPATCHER_HPP
+#define PARAHAPLO_DISPATCHER_HPP
+
+#include "arena.hpp"
+#include "budget.hpp"
+#include "exact.hpp"
+#include "graph_cpu.hpp"
+#include "multilevel_cpu.hpp"
+#include "numa.hpp"
+
+#include <tbb/tbb.h>
+#include <tbb/concurrent_vector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#ifndef BRUTE_FORCE_BITS
+    #define BRUTE_FORCE_BITS    16      // Most bits (IH + 2 * NIH columns) of the candidates for brute force
+#endif
+#ifndef EXACT_COVERAGE
+    #define EXACT_COVERAGE      12      // Most reads spanning a column for the exact dynamic programming
+#endif
+// Steps per second of the exact solvers, which are checked against the deadline before they start -- about
+// half of what they manage on a single core, so the estimate of the time errs long
+#ifndef BRUTE_FORCE_OPERATIONS_PER_SECOND
+    #define BRUTE_FORCE_OPERATIONS_PER_SECOND   4e6
+#endif
+#ifndef EXACT_OPERATIONS_PER_SECOND
+    #define EXACT_OPERATIONS_PER_SECOND         4e7
+#endif
+#ifndef MULTILEVEL_READS
+    #define MULTILEVEL_READS    4096    // Reads at which the multilevel search is used instead of the graph
+#endif
+#ifndef FILTER_MINOR_COUNT
+    #define FILTER_MINOR_COUNT  0       // Least of the less common value in a solved column (0 for all)
+#endif
+#ifndef MAX_COVERAGE
+    #define MAX_COVERAGE        0       // Most selected reads with a value in a column (0 for no cap)
+#endif
+#ifndef CLUSTER_READS
+    #define CLUSTER_READS       0       // If near-duplicate reads are clustered before solving
+#endif
+#ifndef CLUSTER_DISTANCE
+    #define CLUSTER_DISTANCE    0       // Most elements in which a read differs from its cluster's first read
+#endif
+
+namespace haplo {
+namespace engines {
+
+static constexpr uint8_t trivial     = 0;       // No columns or a single column, solved in closed form
+static constexpr uint8_t brute_force = 1;       // All the candidate haplotypes are evaluated
+static constexpr uint8_t exact       = 2;       // Dynamic programming over the partitions of each column
+static constexpr uint8_t graph       = 3;       // Graph search heuristic
+static constexpr uint8_t multilevel  = 4;       // Multilevel search heuristic
+
+}
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Dispatcher
+/// @brief      Chooses the engine for each sub-block from statistics which are cheap to get once the sub-block
+///             is built (the reads, the IH and NIH columns, and the most reads spanning a column), solves the
+///             sub-block with it, and records the engine and the time. Sub-blocks can be solved concurrently.
+///             When solving a block, each sub-block is built and solved with an arena from a pool, which is
+///             reset and given back to the pool once the sub-block has been merged. There is a pool for each
+///             NUMA node, so a placed block's sub-blocks reuse memory which was touched on their node
+/// @tparam     SubBlockType    The type of the sub-blocks to solve
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class Dispatcher {
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Record
+    /// @brief      Which engine solved a sub-block, how long it took, and which node it was solved on
+    // ------------------------------------------------------------------------------------------------------
+    struct Record {
+        size_t      index;          //!< The index of the sub-block
+        size_t      node;           //!< The NUMA node of the cpu which started solving the sub-block
+        uint8_t     engine;         //!< The engine which solved the sub-block
+        double      seconds;        //!< The time to solve the sub-block
+        size_t      mec_score;      //!< The MEC score of the haplotypes
+        bool        at_budget;      //!< If the sub-block hit its deadline
+    };
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using record_container  = tbb::concurrent_vector<Record>;
+    using arena_pointer     = ArenaPool::arena_pointer;
+    using pool_container    = std::vector<std::unique_ptr<ArenaPool>>;
+    using clock             = std::chrono::steady_clock;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    size_t              _brute_force_bits;  //!< Most bits of the candidates for brute force
+    size_t              _exact_coverage;    //!< Most reads spanning a column for the exact solver
+    size_t              _multilevel_reads;  //!< Reads at which the multilevel search is used
+    size_t              _min_minor_count;   //!< Least of the less common value in a solved column
+    size_t              _max_coverage;      //!< Most selected reads with a value in a column, 0 for no cap
+    bool                _cluster_reads;     //!< If near-duplicate reads are clustered before solving
+    size_t              _cluster_distance;  //!< Most differing elements of the clustered reads
+    record_container    _records;           //!< The engine and time for each solved sub-block
+    pool_container      _arenas;            //!< The arenas for the sub-blocks' structures, a pool per node
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the thresholds for the engines
+    /// @param[in]  brute_force_bits    Most bits (IH + 2 * NIH columns) of the candidates for brute force
+    /// @param[in]  exact_coverage      Most reads spanning a column for the exact solver
+    /// @param[in]  multilevel_reads    Reads at which the multilevel search is used instead of the graph
+    /// @param[in]  min_minor_count     Least of the less common value for a column to be solved, the others
+    ///                                 are filtered out and filled in afterwards (0 for no filtering)
+    /// @param[in]  max_coverage        Most reads with a value in a column which are used to solve, the
+    ///                                 others are placed against the haplotypes afterwards (0 for no cap)
+    /// @param[in]  cluster_reads       If the near-duplicate reads are clustered before solving, so that
+    ///                                 the engines solve each cluster as one read weighted by all of them
+    /// @param[in]  cluster_distance    Most elements in which a clustered read can differ from the first
+    ///                                 read of its cluster
+    // ------------------------------------------------------------------------------------------------------
+    explicit Dispatcher(const size_t brute_force_bits = BRUTE_FORCE_BITS  ,
+                        const size_t exact_coverage   = EXACT_COVERAGE    ,
+                        const size_t multilevel_reads = MULTILEVEL_READS  ,
+                        const size_t min_minor_count  = FILTER_MINOR_COUNT,
+                        const size_t max_coverage     = MAX_COVERAGE      ,
+                        const bool   cluster_reads    = CLUSTER_READS     ,
+                        const size_t cluster_distance = CLUSTER_DISTANCE  )
+    : _brute_force_bits(brute_force_bits), _exact_coverage(exact_coverage)    ,
+      _multilevel_reads(multilevel_reads), _min_minor_count(min_minor_count)  ,
+      _max_coverage(max_coverage)        , _cluster_reads(cluster_reads)      ,
+      _cluster_distance(cluster_distance), _arenas(NumaNodes::system_nodes())
+    {
+        for (auto& pool : _arenas) pool.reset(new ArenaPool());
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Chooses the engine for a sub-block
+    /// @param[in]  sub_block   The sub-block to choose the engine for
+    // ------------------------------------------------------------------------------------------------------
+    uint8_t choose(SubBlockType& sub_block) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a sub-block with the engine chosen for it, and records the engine and the time.
+    ///             With a coverage cap the reads are selected before the engine is chosen, so the engines
+    ///             only solve with the selected reads, and the discarded reads are placed against the
+    ///             haplotypes and scored afterwards. With clustering the near-duplicate reads are clustered
+    ///             next, and the engines solve each cluster as one read weighted by all of its reads (the
+    ///             multilevel search as its first coarse level), and the haplotypes are scored per read
+    ///             afterwards. If there is a minor count the columns below it are filtered out before the
+    ///             engine is chosen, and restored once the sub-block is solved, so the score is for all the
+    ///             columns.
+    ///             With a budget the sub-block gets a deadline from it, which the graph and multilevel
+    ///             searches stop refining at, and the time it didn't use goes back to the budget's pool. The
+    ///             exact engines can't stop part way, so if the deadline can't cover their search the
+    ///             sub-block is solved with the graph search instead, and is recorded as at its budget
+    /// @param[in]  sub_block   The sub-block to solve
+    /// @param[in]  budget      The budget for the job the sub-block is part of, nullptr for no limit
+    /// @return     The MEC score of the haplotypes
+    // ------------------------------------------------------------------------------------------------------
+    size_t solve(SubBlockType& sub_block, Budget* budget = nullptr) { return solve(sub_block, budget, true); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves all the sub-blocks of a block in parallel, and then merges their haplotypes into 
+    ///             the block, so that each sub-block is oriented against the ones before it. If the block is
+    ///             placed on NUMA nodes each sub-block is solved in the arena of the node which has most of
+    ///             its rows, whose threads are bound to the node, instead of in the block's arena
+    /// @param[in]  block       The block to solve
+    /// @param[in]  budget      The budget for solving the block, nullptr for no limit
+    /// @tparam     BlockType   The type of the block
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BlockType>
+    void solve_block(BlockType& block, Budget* budget = nullptr);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most clusters of selected reads which span (start before and end after) a column
+    ///             of a sub-block -- the states of the exact solver
+    /// @param[in]  sub_block   The sub-block to get the coverage of
+    // ------------------------------------------------------------------------------------------------------
+    static size_t max_coverage(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the records of the solved sub-blocks
+    // ------------------------------------------------------------------------------------------------------
+    inline const record_container& records() const { return _records; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the name of an engine
+    /// @param[in]  engine      The engine to get the name of
+    // ------------------------------------------------------------------------------------------------------
+    static const char* engine_name(const uint8_t engine)
+    {
+        static const char* names[] = { "trivial", "brute force", "exact", "graph", "multilevel" };
+        return engine <= engines::multilevel ? names[engine] : "unknown";
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the indices of the solved sub-blocks which hit their deadline
+    // ------------------------------------------------------------------------------------------------------
+    std::vector<size_t> at_budget() const
+    {
+        std::vector<size_t> indices;
+        for (const auto& record : _records) {
+            if (record.at_budget) indices.push_back(record.index);
+        }
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Prints the engine and the time for each solved sub-block, and the sub-blocks which hit 
+    ///             their deadline
+    // ------------------------------------------------------------------------------------------------------
+    void print_report() const
+    {
+        std::cout << "SUB-BLOCK ENGINES : " << _records.size() << "\n";
+        for (const auto& record : _records) {
+            std::cout << record.index << " : " << std::setw(11) << std::left << engine_name(record.engine)
+                      << std::right << " " << std::fixed << std::setprecision(6) << record.seconds
+                      << "s MEC " << record.mec_score << (record.at_budget ? " AT BUDGET" : "") << "\n";
+        }
+        const auto indices = at_budget();
+        std::cout << "SUB-BLOCKS AT BUDGET : " << indices.size() << "\n";
+        for (const auto index : indices) std::cout << index << " ";
+        if (!indices.empty()) std::cout << "\n";
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a sub-block, as solve() does
+    /// @param[in]  sub_block   The sub-block to solve
+    /// @param[in]  budget      The budget for the job the sub-block is part of, nullptr for no limit
+    /// @param[in]  own_arena   If the engines run in the sub-block's task arena, false if the sub-block is
+    ///                         already being solved in another arena (a NUMA node's)
+    /// @return     The MEC score of the haplotypes
+    // ------------------------------------------------------------------------------------------------------
+    size_t solve(SubBlockType& sub_block, Budget* budget, const bool own_arena);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Solves a sub-block with no columns or a single column in closed form, giving the same
+    ///             haplotypes as the brute force solver would
+    /// @param[in]  sub_block   The sub-block to solve
+    /// @return     The MEC score of the haplotypes
+    // ------------------------------------------------------------------------------------------------------
+    size_t solve_trivial(SubBlockType& sub_block) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the haplotypes of a sub-block, with each read going with the
+    ///             haplotype it conflicts with the least
+    /// @param[in]  sub_block   The sub-block to get the score of
+    // ------------------------------------------------------------------------------------------------------
+    static size_t map_mec_score(SubBlockType& sub_block);
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <typename SubBlockType>
+uint8_t Dispatcher<SubBlockType>::choose(SubBlockType& sub_block) const
+{
+    const auto   snp_info = sub_block.snp_info();
+    const size_t snps     = snp_info.size();
+    if (sub_block.reads() == 0 || snps <= 1) return engines::trivial;
+
+    // An IH column has 2 candidate values and a NIH column 4
+    const size_t bits = snps + sub_block.nih_columns();
+    if (bits <= _brute_force_bits)                      return engines::brute_force;
+    if (max_coverage(sub_block) <= _exact_coverage)     return engines::exact;
+    if (sub_block.reads() >= _multilevel_reads)         return engines::multilevel;
+    return engines::graph;
+}
+
+template <typename SubBlockType>
+size_t Dispatcher<SubBlockType>::solve(SubBlockType& sub_block, Budget* budget, const bool own_arena)
+{
+    const auto start = clock::now();
+    const auto node  = NumaNodes::current_node();
+    if (_max_coverage    > 0) sub_block.select_reads(_max_coverage);
+    if (_cluster_reads)       sub_block.cluster_reads(_cluster_distance);
+    if (_min_minor_count > 0) sub_block.filter_columns(_min_minor_count);
+
+    auto     engine   = choose(sub_block);
+    Deadline deadline = budget != nullptr ? budget->deadline(sub_block.index()) : Deadline();
+
+    // The engines only use the threads of the sub-block's task arena (or the arena it's solved in), the exact
+    // engines which the deadline can't cover fall through to the graph search
+    size_t mec_score = 0;
+    auto   search    = [&]
+    {
+        switch (engine) {
+            case engines::trivial:
+                mec_score = solve_trivial(sub_block); return;
+            case engines::brute_force: {
+                BruteForce<SubBlockType> brute_force(sub_block);
+                if (!deadline.affords(brute_force.operations() / BRUTE_FORCE_OPERATIONS_PER_SECOND)) break;
+                brute_force.search(); mec_score = brute_force.mec_score(); return;
+            }
+            case engines::exact: {
+                ColumnDp<SubBlockType> exact(sub_block);
+                if (!deadline.affords(exact.operations() / EXACT_OPERATIONS_PER_SECOND)) break;
+                exact.search(); mec_score = exact.mec_score(); return;
+            }
+            case engines::multilevel: {
+                Multilevel<SubBlockType, devices::cpu> multilevel(sub_block);
+                multilevel.search(deadline); mec_score = multilevel.mec_score(); return;
+            }
+            default: break;
+        }
+        engine = engines::graph;
+        Graph<SubBlockType, devices::cpu> graph(sub_block);
+        graph.search(1, 0, deadline); mec_score = graph.mec_score();
+    };
+    if (own_arena) sub_block.concurrency().execute(search); else search();
+    if (budget != nullptr) budget->finish(deadline);
+
+    // The engines only solve with the selected reads (the multilevel search places the others itself), the
+    // score of the clusters keeps their reads together, and the score of the filtered columns doesn't include
+    // the conflicts at the columns which were removed
+    const bool rescore = sub_block.discarded_reads() > 0 || sub_block.num_clusters() < sub_block.reads() ||
+                         sub_block.filtered();
+    if (sub_block.discarded_reads() > 0 && engine != engines::multilevel) sub_block.place_discarded_reads();
+    if (sub_block.filtered()) sub_block.restore_columns();
+    if (rescore) mec_score = map_mec_score(sub_block);
+
+    Record record;
+    record.index     = sub_block.index();
+    record.node      = node;
+    record.engine    = engine;
+    record.seconds   = std::chrono::duration<double>(clock::now() - start).count();
+    record.mec_score = mec_score;
+    record.at_budget = deadline.hit();
+    _records.push_back(record);
+    return mec_score;
+}
+
+template <typename SubBlockType> template <typename BlockType>
+void Dispatcher<SubBlockType>::solve_block(BlockType& block, Budget* budget)
+{
+    // Each pair of adjacent splittable columns bounds a sub-block
+    if (block.num_subblocks() < 2) return;
+    std::vector<std::unique_ptr<SubBlockType>> sub_blocks(block.num_subblocks() - 1);
+    std::vector<arena_pointer>                 arenas(sub_blocks.size());
+
+    std::vector<size_t>                        nodes(sub_blocks.size(), 0);
+
+    // Builds and solves a sub-block with an arena from the pool of its node
+    auto solve_sub_block = [&](const size_t i, const bool own_arena)
+    {
+        arenas[i] = _arenas[nodes[i] % _arenas.size()]->acquire();
+        ArenaScope scope(*arenas[i]);
+        sub_blocks[i].reset(new SubBlockType(block, i));
+        solve(*sub_blocks[i], budget, own_arena);
+    };
+
+    const auto& numa_nodes = block.nodes();
+    if (numa_nodes.size() == 1) {
+        // The sub-blocks are solved with only the threads of the block's task arena, so blocks solved side 
+        // by side don't oversubscribe the cores
+        block.concurrency().execute([&]
+        {
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, sub_blocks.size(), 1),
+                [&](const tbb::blocked_range<size_t>& indices)
+                {
+                    for (size_t i = indices.begin(); i != indices.end(); ++i) solve_sub_block(i, true);
+                }
+            );
+        });
+    } else {
+        // Each node solves its sub-blocks in its own arena, whose threads are bound to the node while they're
+        // in it, so the rows they read and the arena memory they touch are local -- the engines run in the
+        // node's arena too, which has the block's share of threads
+        std::vector<std::vector<size_t>> node_sub_blocks(numa_nodes.size());
+        for (size_t i = 0; i < sub_blocks.size(); ++i) {
+            nodes[i] = block.subblock_node(i);
+            node_sub_blocks[nodes[i]].push_back(i);
+        }
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, numa_nodes.size(), 1),
+            [&](const tbb::blocked_range<size_t>& node_ids)
+            {
+                for (size_t node = node_ids.begin(); node != node_ids.end(); ++node) {
+                    const auto& indices = node_sub_blocks[node];
+                    numa_nodes.execute(node, [&]
+                    {
+                        tbb::parallel_for(
+                            tbb::blocked_range<size_t>(0, indices.size(), 1),
+                            [&](const tbb::blocked_range<size_t>& positions)
+                            {
+                                for (size_t j = positions.begin(); j != positions.end(); ++j)
+                                    solve_sub_block(indices[j], false);
+                            }
+                        );
+                    });
+                }
+            }
+        );
+    }
+
+    // Nothing from a sub-block's arena is used once it's merged, so the arena can be reused
+    block.concurrency().execute([&] { block.merge_haplotypes(sub_blocks); });
+    for (size_t i = 0; i < sub_blocks.size(); ++i) {
+        sub_blocks[i].reset();
+        _arenas[nodes[i] % _arenas.size()]->release(std::move(arenas[i]));
+    }
+}
+
+template <typename SubBlockType>
+size_t Dispatcher<SubBlockType>::max_coverage(SubBlockType& sub_block)
+{
+    // Add each cluster (its first selected read) at its start and remove it after its end
+    std::vector<int64_t> changes(sub_block.snp_info().size() + 1, 0);
+    std::vector<bool>    counted(sub_block.num_clusters(), false);
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        if (!sub_block.read_selected(read_idx) || counted[sub_block.read_cluster(read_idx)]) continue;
+        counted[sub_block.read_cluster(read_idx)] = true;
+        const auto& read_info = sub_block.read_info()[read_idx];
+        ++changes[std::min(read_info.start_index()    , changes.size() - 1)];
+        --changes[std::min(read_info.end_index() + 1  , changes.size() - 1)];
+    }
+
+    int64_t coverage = 0, max_coverage = 0;
+    for (const auto change : changes) {
+        coverage    += change;
+        max_coverage = std::max(max_coverage, coverage);
+    }
+    return static_cast<size_t>(max_coverage);
+}
+
+template <typename SubBlockType>
+size_t Dispatcher<SubBlockType>::solve_trivial(SubBlockType& sub_block) const
+{
+    const auto snp_info = sub_block.snp_info();
+    if (snp_info.empty()) return 0;
+
+    size_t counts[2] = {0, 0};
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto value = sub_block(read_idx, 0);
+        if (value <= 1 && sub_block.read_selected(read_idx)) ++counts[value];
+    }
+
+    // The candidates are tried in the order of the brute force codes, and the first with the lowest score is
+    // kept, so the haplotypes are the same as the exact solvers' -- for a NIH column different values match
+    // every read, so the haplotypes only have the same value when none of the reads have a 1
+    const bool  ih        = snp_info[0].type() == IH;
+    size_t      mec_score = INT_MAX;
+    uint8_t     best[2]   = {0, 0};
+    for (size_t code = 0; code < (ih ? 2 : 4); ++code) {
+        const uint8_t one   = code & 1, two = ih ? !one : (code >> 1) & 1;
+        const size_t  score = one == two ? counts[!one] : 0;
+        if (score < mec_score) { mec_score = score; best[0] = one; best[1] = two; }
+    }
+    sub_block._haplo_one.set(0, best[0]);
+    sub_block._haplo_two.set(0, best[1]);
+    return mec_score;
+}
+
+template <typename SubBlockType>
+size_t Dispatcher<SubBlockType>::map_mec_score(SubBlockType& sub_block)
+{
+    size_t mec_score = 0;
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto& read_info = sub_block.read_info()[read_idx];
+        size_t      conflicts_one = 0, conflicts_two = 0;
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+            const auto value = sub_block(read_idx, col_idx);
+            if (value > 1) continue;
+            conflicts_one += value != sub_block.haplo_one().get(col_idx);
+            conflicts_two += value != sub_block.haplo_two().get(col_idx);
+        }
+        mec_score += std::min(conflicts_one, conflicts_two);
+    }
+    return mec_score;
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_DISPATCHER_HPP
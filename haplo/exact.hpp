@@ -0,0 +1,417 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   exact.hpp
+/// @brief  Header file for the exact solvers for small sub-blocks -- brute force over the haplotypes, and
+///         dynamic programming over the partitions of the reads which span each column
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_EXACT_HPP
+#define PARAHAPLO_EXACT_HPP
+
+#include "batch_evaluator.hpp"
+#include "snp_info_gpu.h"
+
+#include <tbb/tbb.h>
+#include <thrust/host_vector.h>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifndef NIH
+    #define IH  0x00
+    #define NIH 0x01
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      BruteForce
+/// @brief      Finds the haplotypes with the lowest MEC score by evaluating all of them, 64 at a time with the
+///             bit-sliced evaluator. An IH snp has 2 possible values (the haplotypes are different), a NIH snp
+///             has 4, so there are 2^(IH + 2 * NIH) candidates. Only the reads selected by the sub-block's
+///             coverage cap are scored
+/// @tparam     SubBlockType    The type of the sub-block to find the haplotypes for
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class BruteForce {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using evaluator_type        = BatchEvaluator<SubBlockType>;
+    using word_container        = typename evaluator_type::word_container;
+    using index_container       = typename evaluator_type::index_container;
+    using small_container       = std::vector<uint8_t>;
+    using snp_info_container    = thrust::host_vector<SnpInfoGpu>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    SubBlockType&       _sub_block;
+    snp_info_container  _snp_info;      //!< The information for each of the snps
+    evaluator_type      _evaluator;     //!< Evaluates the candidates
+    size_t              _bits;          //!< The number of bits in the code of a candidate
+    size_t              _mec_score;
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  sub_block   The sub-block to find the haplotypes for
+    // ------------------------------------------------------------------------------------------------------
+    explicit BruteForce(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Evaluates all the candidates and puts the best haplotypes (the lowest code for ties) into
+    ///             the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    void search();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of bits in the code of a candidate, there are 2^bits candidates
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t bits() const { return _bits; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of steps of the search -- every call of every read is compared with each
+    ///             batch of candidates -- to estimate how long it takes before starting it
+    // ------------------------------------------------------------------------------------------------------
+    double operations() const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the haplotypes of a candidate from its code
+    /// @param[in]  code        The code of the candidate
+    /// @param[out] haplo_one   The first haplotype
+    /// @param[out] haplo_two   The second haplotype
+    // ------------------------------------------------------------------------------------------------------
+    void decode(const size_t code, small_container& haplo_one, small_container& haplo_two) const;
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ColumnDp
+/// @brief      Finds the partition of the reads with the lowest MEC score with dynamic programming over the
+///             columns. The state at a column is the partition of the reads which span it, so the cost is
+///             O(2^coverage) per column and it is only for sub-blocks with low coverage. The haplotypes at each
+///             column take the majority of each partition (or the best complementary values at IH columns).
+///             Only the reads selected by the sub-block's coverage cap are partitioned, and the reads of a
+///             cluster are partitioned together, as one read weighted by the values of all of them
+/// @tparam     SubBlockType    The type of the sub-block to find the haplotypes for
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType>
+class ColumnDp {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using cost_type             = uint32_t;
+    using cost_container        = std::vector<cost_type>;
+    using index_container       = std::vector<size_t>;
+    using small_container       = std::vector<uint8_t>;
+    using weight_container      = std::vector<std::array<cost_type, 2>>;
+    using snp_info_container    = thrust::host_vector<SnpInfoGpu>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    SubBlockType&                   _sub_block;
+    snp_info_container              _snp_info;      //!< The information for each of the snps
+    std::vector<index_container>    _active;        //!< The clusters (first reads) which span each column
+    std::vector<weight_container>   _weights;       //!< The zeros and ones of each active cluster's reads
+    std::vector<cost_container>     _costs;         //!< The best cost of each partition of each column
+    size_t                          _max_coverage;  //!< The most reads which span a column
+    size_t                          _mec_score;
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- finds the clusters which span each column, and their values
+    /// @param[in]  sub_block   The sub-block to find the haplotypes for
+    // ------------------------------------------------------------------------------------------------------
+    explicit ColumnDp(SubBlockType& sub_block);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Fills the cost tables, then follows the best partitions back from the last column and puts
+    ///             the haplotypes into the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    void search();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the most clusters which span a column
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t max_coverage() const { return _max_coverage; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of steps of the search -- the cost of each partition of a column goes
+    ///             through the column's reads -- to estimate how long it takes before starting it
+    // ------------------------------------------------------------------------------------------------------
+    double operations() const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the cost of a partition at a column, and the haplotype values for it
+    /// @param[in]  col_idx     The index of the column
+    /// @param[in]  partition   The partition of the active clusters, bit k set if cluster k is in the second
+    ///                         set
+    /// @param[out] value_one   The value of the first haplotype
+    /// @param[out] value_two   The value of the second haplotype
+    // ------------------------------------------------------------------------------------------------------
+    cost_type column_cost(const size_t col_idx, const size_t partition,
+                          uint8_t&     value_one, uint8_t& value_two   ) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the bits of a partition of a column's reads for the reads which also span the previous
+    ///             column, at their positions in the previous column
+    /// @param[in]  partition   The partition of the column's reads
+    /// @param[in]  positions   The position of each of the column's reads in the previous column
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t shared_bits(const size_t partition, const index_container& positions)
+    {
+        size_t bits = 0;
+        for (size_t k = 0; k < positions.size(); ++k) {
+            if (positions[k] != static_cast<size_t>(-1) && ((partition >> k) & 1)) 
+                bits |= size_t(1) << positions[k];
+        }
+        return bits;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the position of each of a column's reads in the previous column (-1 if new)
+    /// @param[in]  col_idx     The index of the column
+    /// @param[out] shared_mask The bits of the reads of the previous column which also span this column
+    // ------------------------------------------------------------------------------------------------------
+    index_container previous_positions(const size_t col_idx, size_t& shared_mask) const;
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+// ----------------------------------------------- BRUTE FORCE ----------------------------------------------
+
+template <typename SubBlockType>
+BruteForce<SubBlockType>::BruteForce(SubBlockType& sub_block)
+: _sub_block(sub_block), _snp_info(sub_block.snp_info()), _evaluator(sub_block), _bits(0), _mec_score(INT_MAX)
+{
+    for (const auto& snp_info : _snp_info) _bits += snp_info.type() == IH ? 1 : 2;
+}
+
+template <typename SubBlockType>
+void BruteForce<SubBlockType>::search()
+{
+    const size_t    snps       = _snp_info.size();
+    const size_t    candidates = size_t(1) << _bits;
+    size_t          best_code  = 0;
+    small_container haplo_one(snps), haplo_two(snps);
+    word_container  words_one(snps), words_two(snps);
+    index_container mec_scores;
+
+    for (size_t base = 0; base < candidates; base += evaluator_type::LANES) {
+        const size_t lanes = std::min(evaluator_type::LANES, candidates - base);
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            decode(base + lane, haplo_one, haplo_two);
+            evaluator_type::set_candidate(words_one, lane, haplo_one);
+            evaluator_type::set_candidate(words_two, lane, haplo_two);
+        }
+        _evaluator.evaluate(words_one, words_two, mec_scores);
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            if (mec_scores[lane] < _mec_score) { _mec_score = mec_scores[lane]; best_code = base + lane; }
+        }
+    }
+
+    decode(best_code, haplo_one, haplo_two);
+    for (size_t i = 0; i < snps; ++i) {
+        _sub_block._haplo_one.set(i, haplo_one[i]);
+        _sub_block._haplo_two.set(i, haplo_two[i]);
+    }
+}
+
+template <typename SubBlockType>
+double BruteForce<SubBlockType>::operations() const
+{
+    const double batches = std::ceil(std::ldexp(1.0, static_cast<int>(_bits)) / evaluator_type::LANES);
+    return batches * static_cast<double>(std::max(_evaluator.calls(), size_t(1)));
+}
+
+template <typename SubBlockType>
+void BruteForce<SubBlockType>::decode(const size_t     code     , small_container& haplo_one,
+                                      small_container& haplo_two                            ) const
+{
+    size_t bit = 0;
+    for (size_t i = 0; i < _snp_info.size(); ++i) {
+        haplo_one[i] = (code >> bit++) & 1;
+        haplo_two[i] = _snp_info[i].type() == IH ? !haplo_one[i] : (code >> bit++) & 1;
+    }
+}
+
+// ------------------------------------------------ COLUMN DP -----------------------------------------------
+
+template <typename SubBlockType>
+ColumnDp<SubBlockType>::ColumnDp(SubBlockType& sub_block)
+: _sub_block(sub_block), _snp_info(sub_block.snp_info()), _max_coverage(0), _mec_score(INT_MAX)
+{
+    const size_t snps = _snp_info.size();
+    _active.resize(snps); _weights.resize(snps);
+
+    // A cluster is represented by its first selected read (the reads of a cluster have the same span), so
+    // the reads which were discarded by the coverage cap and the rest of each cluster are never active
+    std::vector<index_container> members(sub_block.num_clusters());
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        if (sub_block.read_selected(read_idx)) members[sub_block.read_cluster(read_idx)].push_back(read_idx);
+    }
+
+    // Clusters which end leave the active clusters, new clusters go at the back, so the clusters which span
+    // consecutive columns keep their order
+    index_container starts_at(snps + 1, 0), by_start;
+    for (const auto& cluster : members) {
+        if (!cluster.empty()) ++starts_at[sub_block.read_info()[cluster.front()].start_index() + 1];
+    }
+    for (size_t i = 0; i < snps; ++i) starts_at[i + 1] += starts_at[i];
+    by_start.resize(starts_at[snps]);
+    index_container next(starts_at.begin(), starts_at.end() - 1);
+    for (const auto& cluster : members) {
+        if (cluster.empty()) continue;
+        by_start[next[sub_block.read_info()[cluster.front()].start_index()]++] = cluster.front();
+    }
+
+    index_container active;
+    for (size_t col_idx = 0; col_idx < snps; ++col_idx) {
+        active.erase(std::remove_if(active.begin(), active.end(),
+            [&](const size_t read_idx) { return sub_block.read_info()[read_idx].end_index() < col_idx; }),
+            active.end());
+        for (size_t i = starts_at[col_idx]; i < starts_at[col_idx + 1]; ++i) active.push_back(by_start[i]);
+
+        auto& weights = _weights[col_idx];
+        weights.assign(active.size(), {{0, 0}});
+        for (size_t k = 0; k < active.size(); ++k) {
+            for (const auto read_idx : members[sub_block.read_cluster(active[k])]) {
+                const auto value = sub_block(read_idx, col_idx);
+                if (value <= 1) ++weights[k][value];
+            }
+        }
+        _active[col_idx] = active;
+        _max_coverage    = std::max(_max_coverage, active.size());
+    }
+}
+
+template <typename SubBlockType>
+double ColumnDp<SubBlockType>::operations() const
+{
+    double operations = 0.0;
+    for (const auto& active : _active) 
+        operations += std::ldexp(static_cast<double>(std::max(active.size(), size_t(1))), 
+                                 static_cast<int>(active.size()));
+    return operations;
+}
+
+template <typename SubBlockType>
+void ColumnDp<SubBlockType>::search()
+{
+    const size_t snps = _snp_info.size();
+    if (snps == 0) { _mec_score = 0; return; }
+
+    // Forward -- the best cost of each partition is its column cost plus the best cost of the partitions of
+    // the previous column which agree on the shared reads
+    _costs.resize(snps);
+    for (size_t col_idx = 0; col_idx < snps; ++col_idx) {
+        auto& costs = _costs[col_idx];
+        costs.resize(size_t(1) << _active[col_idx].size());
+
+        cost_container  best_previous(1, 0);
+        index_container positions(_active[col_idx].size(), static_cast<size_t>(-1));
+        if (col_idx > 0) {
+            size_t      shared_mask = 0;
+            const auto& previous    = _costs[col_idx - 1];
+            positions = previous_positions(col_idx, shared_mask);
+
+            best_previous.assign(previous.size(), std::numeric_limits<cost_type>::max());
+            for (size_t partition = 0; partition < previous.size(); ++partition) {
+                auto& best = best_previous[partition & shared_mask];
+                best = std::min(best, previous[partition]);
+            }
+        }
+
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, costs.size()),
+            [&](const tbb::blocked_range<size_t>& partitions)
+            {
+                uint8_t value_one, value_two;
+                for (size_t partition = partitions.begin(); partition != partitions.end(); ++partition) {
+                    costs[partition] = column_cost(col_idx, partition, value_one, value_two)
+                                     + best_previous[shared_bits(partition, positions)];
+                }
+            }
+        );
+    }
+
+    // Backward -- follow the best partitions (lowest partition for ties) back from the last column
+    const auto& last      = _costs[snps - 1];
+    size_t      partition = std::min_element(last.begin(), last.end()) - last.begin();
+    _mec_score = last[partition];
+
+    for (size_t col_idx = snps; col_idx > 0; --col_idx) {
+        uint8_t value_one, value_two;
+        column_cost(col_idx - 1, partition, value_one, value_two);
+        _sub_block._haplo_one.set(col_idx - 1, value_one);
+        _sub_block._haplo_two.set(col_idx - 1, value_two);
+
+        if (col_idx > 1) {
+            size_t      shared_mask = 0;
+            const auto  positions   = previous_positions(col_idx - 1, shared_mask);
+            const auto  shared      = shared_bits(partition, positions);
+            const auto& previous    = _costs[col_idx - 2];
+
+            size_t best = static_cast<size_t>(-1);
+            for (size_t p = 0; p < previous.size(); ++p) {
+                if ((p & shared_mask) != shared) continue;
+                if (best == static_cast<size_t>(-1) || previous[p] < previous[best]) best = p;
+            }
+            partition = best;
+        }
+    }
+    _costs.clear();
+}
+
+template <typename SubBlockType>
+typename ColumnDp<SubBlockType>::cost_type
+ColumnDp<SubBlockType>::column_cost(const size_t col_idx, const size_t partition,
+                                    uint8_t&     value_one, uint8_t& value_two   ) const
+{
+    cost_type counts[2][2] = {{0, 0}, {0, 0}};      // [set][value]
+    const auto& weights = _weights[col_idx];
+    for (size_t k = 0; k < weights.size(); ++k) {
+        counts[(partition >> k) & 1][0] += weights[k][0];
+        counts[(partition >> k) & 1][1] += weights[k][1];
+    }
+
+    if (_snp_info[col_idx].type() == IH) {
+        // The haplotypes must be different, so one of the sets has 0 and the other 1
+        const cost_type cost_zero_one = counts[0][1] + counts[1][0];
+        const cost_type cost_one_zero = counts[0][0] + counts[1][1];
+        value_one = cost_one_zero < cost_zero_one ? 1 : 0;
+        value_two = !value_one;
+        return std::min(cost_zero_one, cost_one_zero);
+    }
+    value_one = counts[0][1] > counts[0][0] ? 1 : 0;
+    value_two = counts[1][1] > counts[1][0] ? 1 : 0;
+    return std::min(counts[0][0], counts[0][1]) + std::min(counts[1][0], counts[1][1]);
+}
+
+template <typename SubBlockType>
+typename ColumnDp<SubBlockType>::index_container
+ColumnDp<SubBlockType>::previous_positions(const size_t col_idx, size_t& shared_mask) const
+{
+    const auto&     active   = _active[col_idx];
+    const auto&     previous = _active[col_idx - 1];
+    index_container positions(active.size(), static_cast<size_t>(-1));
+
+    // The reads from the previous column are at the front, in the same order
+    shared_mask = 0;
+    size_t k = 0;
+    for (size_t p = 0; p < previous.size() && k < active.size(); ++p) {
+        if (previous[p] == active[k]) { positions[k++] = p; shared_mask |= size_t(1) << p; }
+    }
+    return positions;
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_EXACT_HPP
@@ -0,0 +1,898 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   Header file for parahaplo graph class -- cpu implementation
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARHAPLO_GRAPH_CPU_HPP
+#define PARHAPLO_GRAPH_CPU_HPP
+
+#include "allele_planes.hpp"
+#include "arena.hpp"
+#include "budget.hpp"
+#include "column_view.hpp"
+#include "devices.hpp"
+#include "edge.h"
+#include "graph.h"
+#include "read_info.h"
+#include "snp_info_gpu.h"
+
+#include <tbb/tbb.h>
+#include <tbb/concurrent_vector.h>
+#include <tbb/parallel_sort.h>
+#include <tbb/spin_mutex.h>
+#include <thrust/host_vector.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#ifndef ITERS
+    #define ITERS           6000        // Number of iterations before ensuring termination
+#endif
+#define SEED_EDGES          16          // Number of strongest edges the randomized starts choose a seed from
+#define ABANDON_LOOKAHEAD   4           // Iterations (at the last gain) a start gets to catch the first start
+#define SPECTRAL_ITERS      300         // Maximum number of power iterations for the spectral partition
+#define SPECTRAL_TOLERANCE  1e-6        // Change in the eigenvector at which the power iterations stop
+
+#ifndef NIH
+    #define IH  0x00
+    #define NIH 0x01
+#endif
+
+namespace haplo {
+namespace inits {
+
+static constexpr uint8_t greedy   = 0;      // Grow the partitions along the strongest edges
+static constexpr uint8_t spectral = 1;      // Split by the sign of the leading eigenvector of the agreements
+
+}
+
+// Specialization for cpu
+template <typename SubBlockType>
+class Graph<SubBlockType, devices::cpu> {
+public:
+    //-------------------------------------------------------------------------------------------------------
+    using small_type                    = uint8_t;
+    using small_container               = thrust::host_vector<small_type>;
+    using read_info_container           = typename SubBlockType::read_info_container;
+    using snp_info_container            = thrust::host_vector<SnpInfoGpu>;
+    using edge_container                = tbb::concurrent_vector<Edge>;
+    using index_container               = std::vector<size_t, ArenaAllocator<size_t>>;
+    using mutex_type                    = tbb::spin_mutex;
+    //-------------------------------------------------------------------------------------------------------
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Component
+    /// @brief      An independent part of the sub-block -- reads which share no snps with the reads of any
+    ///             other component. The last component holds the reads which the sub-block excluded from the
+    ///             components (less than 2 informative values) and the snps only they cover
+    // ------------------------------------------------------------------------------------------------------
+    struct Component {
+        index_container     reads;          //!< The sub-block indices of the reads
+        index_container     snps;           //!< The sub-block indices of the snps
+        index_container     edges;          //!< The indices of the edges, strongest first
+    };
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Solution
+    /// @brief      The state of a single start of the search for a component -- the partition of the reads and
+    ///             the haplotypes which the partition gives, indexed by the position in the component
+    // ------------------------------------------------------------------------------------------------------
+    struct Solution {
+        small_container     sets;           //!< The partition (1 or 2) of each read, 0 if not partitioned
+        small_container     haplo_one;      //!< The haplotype for the first partition
+        small_container     haplo_two;      //!< The haplotype for the second partition
+        index_container     scores_one;     //!< Mismatches in set 1 for each snp (best, worst) value
+        index_container     scores_two;     //!< Mismatches in set 2 for each snp (best, worst) value
+        size_t              mec_score;      //!< The MEC score of the haplotypes
+
+        Solution(const size_t reads, const size_t snps)
+        : sets(reads, 0)        , haplo_one(snps, 0)        , haplo_two(snps, 0),
+          scores_one(snps * 2)  , scores_two(snps * 2)      , mec_score(INT_MAX) {}
+    };
+
+    SubBlockType&               _sub_block;
+    small_container             _data;              //!< The sub-block data, one element per byte
+    read_info_container&        _read_info;         //!< The information for each of the reads
+    snp_info_container          _snp_info;          //!< The information for each of the snps
+    edge_container              _edges;             //!< The edges between overlapping reads
+    index_container             _adjacency;         //!< The edge indices adjacent to each read
+    index_container             _adjacency_offsets; //!< The start of each read's edges in the adjacency
+    std::vector<Component>      _components;        //!< The independent components of the sub-block
+    index_container             _read_components;   //!< The component of each read
+    index_container             _snp_components;    //!< The component of each snp
+    index_container             _local_reads;       //!< The index of each read in its component
+    index_container             _local_snps;        //!< The index of each snp in its component
+    index_container             _leaders;           //!< The read which each read's cluster goes with
+    small_container             _haplo_one;         //!< The first haplotype of the solution
+    small_container             _haplo_two;         //!< The second haplotype of the solution
+    index_container             _seeds;             //!< The seed of the start which solved each component
+    size_t                      _snps;
+    size_t                      _reads;
+    AllelePlanes                _planes;            //!< The sub-block data as allele and call planes
+    const ColumnView&           _columns;           //!< The sub-block data in column major order
+    size_t                      _mec_score;
+    size_t                      _nearest;           //!< Strongest edges of each kind kept per read, 0 for all
+    uint8_t                     _init;              //!< How the initial partitions are found
+public:
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor
+    /// @param[in]  sub_block   The sub-block to find the haplotypes for
+    /// @param[in]  nearest     If not 0, only the nearest strongest agreement (distance < 1) and the nearest
+    ///             strongest disagreement (distance > 1) edges of each read are kept, which bounds the number
+    ///             of edges by 2 * nearest * reads for deep coverage -- an edge is kept if it is one of the
+    ///             strongest of either of its reads
+    //-------------------------------------------------------------------------------------------------------
+    Graph(SubBlockType& sub_block, const size_t nearest = 0);
+
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the graph for the haplotypes, starting from the strongest edge
+    //-------------------------------------------------------------------------------------------------------
+    void search() { search(1, 0); }
+
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the graph for the haplotypes using multiple independent starts which are run in
+    ///             parallel, and keeps the haplotypes of the start with the lowest MEC score. Start 0 is
+    ///             always the deterministic start from the strongest edge, the other starts use a different
+    ///             seed edge and random tie breaking, which is seeded from seed + start index, so the result
+    ///             is reproducible for a given number of starts and seed. Each component of the sub-block is
+    ///             solved independently (and in parallel), with its own best start
+    /// @param[in]  starts      The number of independent starts
+    /// @param[in]  seed        The seed for the random number generators of the starts
+    //-------------------------------------------------------------------------------------------------------
+    void search(const size_t starts, const size_t seed) { Deadline unlimited; search(starts, seed, unlimited); }
+
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the graph for the haplotypes using multiple starts (as above), stopping the refinement
+    ///             when the deadline is reached. The initial solution of start 0 is always found, so there is
+    ///             always a valid solution, and the best solution found before the deadline is kept
+    /// @param[in]  starts      The number of independent starts
+    /// @param[in]  seed        The seed for the random number generators of the starts
+    /// @param[in]  deadline    The deadline for the search
+    //-------------------------------------------------------------------------------------------------------
+    void search(const size_t starts, const size_t seed, Deadline& deadline);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the seed of the start which found the solution for a component -- 0 for the
+    ///             deterministic start
+    /// @param[in]  component   The index of the component
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t seed(const size_t component = 0) const 
+    { 
+        return component < _seeds.size() ? _seeds[component] : 0; 
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of components which are solved independently
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t num_components() const { return _components.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of edges in the graph
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t num_edges() const { return _edges.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets how the initial partitions of the starts are found
+    /// @param[in]  init        The initializer -- inits::greedy (default) or inits::spectral
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_init(const uint8_t init) { _init = init; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Prints the MEC score
+    // ------------------------------------------------------------------------------------------------------
+    void print_mec() const { std::cout << "MEC SCORE : " << _mec_score << "\n"; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of an element of the sub-block, 3 if the read does not cover the snp
+    /// @param[in]  read_idx    The index of the read
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    inline small_type element(const size_t read_idx, const size_t snp_idx) const
+    {
+        return _read_info[read_idx].element_exists(snp_idx)
+            ? _data[_read_info[read_idx].offset() + snp_idx - _read_info[read_idx].start_index()] : 0x03;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If an edge is stronger (further from a distance of 1) than another, ties are broken by the
+    ///             distance and then the reads so that the order of the edges is deterministic
+    /// @param[in]  a           The first edge
+    /// @param[in]  b           The second edge
+    // ------------------------------------------------------------------------------------------------------
+    static inline bool stronger(const Edge& a, const Edge& b)
+    {
+        const float strength_a = std::fabs(a.distance - 1.0f), strength_b = std::fabs(b.distance - 1.0f);
+        if (strength_a != strength_b) return strength_a > strength_b;
+        if (a.distance != b.distance) return a.distance > b.distance;
+        return a.f1 != b.f1 ? a.f1 < b.f1 : a.f2 < b.f2;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the distances between all overlapping reads and sorts the edges so that the
+    ///             strongest edges (most similar or most different reads) are first
+    // ------------------------------------------------------------------------------------------------------
+    void map_distances();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the adjacency list of the edges for each read
+    // ------------------------------------------------------------------------------------------------------
+    void map_adjacency();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the components from the components of the reads in the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    void map_components();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Runs a single start of the search for a component
+    /// @param[in]  component   The index of the component
+    /// @param[in]  start       The index of the start
+    /// @param[in]  seed        The seed for the start
+    /// @param[in]  bound       The MEC score of the first start, for early abandonment (INT_MAX for none)
+    /// @param[in]  deadline    The deadline for the search
+    // ------------------------------------------------------------------------------------------------------
+    Solution solve_start(const size_t component, const size_t start   , const size_t seed,
+                         const size_t bound    , Deadline&    deadline                   ) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Partitions the reads by growing the partitions along the strongest edges from a seed edge,
+    ///             similar reads go into the same partition and different reads into opposite partitions
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to partition the reads of
+    /// @param[in]  seed_edge   The index (in the component) of the edge to start the partitioning from
+    /// @param[in]  generator   The random generator for tie breaking, nullptr for deterministic ties
+    // ------------------------------------------------------------------------------------------------------
+    void map_to_partitions(const size_t      component , Solution&        solution , 
+                           const size_t      seed_edge , std::mt19937_64* generator) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Partitions the reads by the sign of the leading eigenvector of the signed agreement matrix
+    ///             (1 - distance for each edge), found with power iterations on the shifted matrix so that
+    ///             the largest eigenvalue is also the largest in magnitude. Reads without edges are left
+    ///             unpartitioned
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to partition the reads of
+    /// @param[in]  generator   The random generator for the start vector, nullptr for a deterministic start
+    // ------------------------------------------------------------------------------------------------------
+    void map_spectral_partitions(const size_t component, Solution& solution, std::mt19937_64* generator) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Puts the reads of each cluster into the partition of the cluster's first read, which has
+    ///             the edges of all of them, so that the cluster is weighted by all of its reads
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to partition the reads of
+    // ------------------------------------------------------------------------------------------------------
+    void follow_leaders(const size_t component, Solution& solution) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the haplotypes from the partitions, and the mismatches for each snp
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to determine the haplotypes for
+    // ------------------------------------------------------------------------------------------------------
+    void determine_haplotypes(const size_t component, Solution& solution) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Checks that the haplotypes have different values at IH snps, and flips the value of the
+    ///             haplotype which increases the MEC score the least if not
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to check the haplotypes of
+    // ------------------------------------------------------------------------------------------------------
+    void check_haplotypes(const size_t component, Solution& solution) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves each read into the partition whose haplotype it conflicts with the least
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to repartition the reads of
+    /// @param[in]  all_reads   If all reads should be moved, or only those which are not partitioned
+    // ------------------------------------------------------------------------------------------------------
+    void repartition(const size_t component, Solution& solution, const bool all_reads) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the MEC score of the haplotypes of a solution, for the snps of the component
+    /// @param[in]  component   The index of the component
+    /// @param[in]  solution    The solution to determine the MEC score for
+    // ------------------------------------------------------------------------------------------------------
+    size_t map_mec_score(const size_t component, const Solution& solution) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the MEC score of the haplotypes of the whole sub-block
+    // ------------------------------------------------------------------------------------------------------
+    size_t map_mec_score() const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the result of the haplotype to the sub block
+    // ------------------------------------------------------------------------------------------------------
+    void set_sub_block_haplotypes();
+};
+
+// ------------------------------------------------ IMPLEMENTATIONS -----------------------------------------
+
+template <typename SubBlockType>
+Graph<SubBlockType, devices::cpu>::Graph(SubBlockType& sub_block, const size_t nearest)
+: _sub_block(sub_block)                     , _data(sub_block.data().to_binary_vector())    ,
+  _read_info(sub_block.read_info())         , _snp_info(sub_block.snp_info())               ,
+  _snps(_snp_info.size())                   , _reads(sub_block.read_info().size())          ,
+  _planes(sub_block.data(), sub_block.read_info(), _reads, _snps)                           ,
+  _columns(sub_block.columns())                                                             ,
+  _mec_score(INT_MAX)                       , _nearest(nearest)                             ,
+  _init(inits::greedy)
+{
+    map_components();
+    map_distances();
+    map_adjacency();
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::search(const size_t starts, const size_t seed, Deadline& deadline)
+{
+    if (_reads == 0 || _snps == 0) { _mec_score = 0; return; }
+
+    _haplo_one.assign(_snps, 0); _haplo_two.assign(_snps, 0);
+    _seeds.assign(_components.size(), 0);
+
+    const size_t                       num_starts = std::max(starts, size_t(1));
+    std::vector<std::vector<Solution>> solutions(_components.size());
+    for (size_t comp = 0; comp < _components.size(); ++comp) {
+        solutions[comp].assign(num_starts, Solution(_components[comp].reads.size(), 
+                                                    _components[comp].snps.size()));
+    }
+
+    // The first start of each component runs to completion, and its score is the bound which the other
+    // starts are abandoned against -- a bound shared between the running starts would depend on the 
+    // scheduling, and the same seed would not always give the same result
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _components.size()),
+        [&](const tbb::blocked_range<size_t>& component_ids)
+        {
+            for (size_t comp = component_ids.begin(); comp != component_ids.end(); ++comp) 
+                solutions[comp][0] = solve_start(comp, 0, seed, INT_MAX, deadline);
+        }
+    );
+
+    // The components and the remaining starts are all independent, so each (component, start) pair is a
+    // point of a 2D iteration space which is solved in parallel
+    tbb::parallel_for(
+        tbb::blocked_range2d<size_t>(0, _components.size(), 1, 1, num_starts, 1),
+        [&](const tbb::blocked_range2d<size_t>& range)
+        {
+            for (size_t comp = range.rows().begin(); comp != range.rows().end(); ++comp) {
+                for (size_t start = range.cols().begin(); start != range.cols().end(); ++start) {
+                    solutions[comp][start] = solve_start(comp, start, seed + start, 
+                                                         solutions[comp][0].mec_score, deadline);
+                }
+            }
+        }
+    );
+
+    // Choose the best start of each component -- the lowest index for ties so that the result doesn't depend
+    // on the scheduling. The components have no snps in common, so they can write their haplotypes together
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _components.size()),
+        [&](const tbb::blocked_range<size_t>& component_ids)
+        {
+            for (size_t comp = component_ids.begin(); comp != component_ids.end(); ++comp) {
+                const auto& component  = _components[comp];
+                size_t      best_start = 0;
+                for (size_t start = 1; start < num_starts; ++start) {
+                    if (solutions[comp][best_start].mec_score > solutions[comp][start].mec_score) 
+                        best_start = start;
+                }
+                _seeds[comp] = best_start == 0 ? 0 : seed + best_start;
+
+                const auto& best = solutions[comp][best_start];
+                for (size_t i = 0; i < component.snps.size(); ++i) {
+                    _haplo_one[component.snps[i]] = best.haplo_one[i];
+                    _haplo_two[component.snps[i]] = best.haplo_two[i];
+                }
+            }
+        }
+    );
+
+    // The excluded reads can conflict with the haplotypes of the other components' snps, so the score is
+    // determined for the sub-block as a whole
+    _mec_score = map_mec_score();
+
+    // Put the haplotypes back into the sub_block
+    set_sub_block_haplotypes();
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_components()
+{
+    // The reads which the sub-block excluded go into an extra component at the end
+    const size_t excluded = _sub_block.num_components();
+    _components.resize(excluded + 1);
+    _read_components.resize(_reads); _local_reads.resize(_reads);
+
+    for (size_t read_idx = 0; read_idx < _reads; ++read_idx) {
+        const size_t comp = _sub_block.read_component(read_idx) == SubBlockType::NO_COMPONENT
+                          ? excluded : _sub_block.read_component(read_idx);
+        _read_components[read_idx] = comp;
+        _local_reads[read_idx]     = _components[comp].reads.size();
+        _components[comp].reads.push_back(read_idx);
+    }
+
+    // A snp is in the component of any of its (not excluded) reads with a value, since they are all connected
+    // through it, otherwise only excluded reads cover it
+    _snp_components.resize(_snps); _local_snps.resize(_snps);
+    for (size_t snp_idx = 0; snp_idx < _snps; ++snp_idx) {
+        size_t comp = excluded;
+        for (size_t read_idx = _snp_info[snp_idx].start_index();
+             read_idx <= _snp_info[snp_idx].end_index() && read_idx < _reads && comp == excluded;
+             ++read_idx) {
+            if (_read_components[read_idx] != excluded && element(read_idx, snp_idx) <= 1) 
+                comp = _read_components[read_idx];
+        }
+        _snp_components[snp_idx] = comp;
+        _local_snps[snp_idx]     = _components[comp].snps.size();
+        _components[comp].snps.push_back(snp_idx);
+    }
+
+    // Each cluster of near-duplicate reads goes with its first read in the component, the excluded reads
+    // go with themselves
+    _leaders.resize(_reads);
+    index_container cluster_leaders(_sub_block.num_clusters(), _reads);
+    for (size_t read_idx = 0; read_idx < _reads; ++read_idx) {
+        auto& leader = cluster_leaders[_sub_block.read_cluster(read_idx)];
+        if (_read_components[read_idx] != excluded &&
+            (leader == _reads || _read_components[leader] != _read_components[read_idx])) leader = read_idx;
+        _leaders[read_idx] = _read_components[read_idx] == excluded ? read_idx : leader;
+    }
+
+    // When the excluded reads only have values for snps of other components there is nothing to solve for them
+    if (_components.back().snps.empty()) _components.pop_back();
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_distances()
+{
+    // Order the reads by start index, so that only the overlapping reads are compared, the excluded reads
+    // have no edges, and the edges of a clustered read are moved to its cluster's first read
+    const size_t    excluded = _sub_block.num_components();
+    index_container reads;
+    for (size_t i = 0; i < _reads; ++i) {
+        if (_read_components[i] != excluded) reads.push_back(i);
+    }
+    std::stable_sort(reads.begin(), reads.end(),
+        [&](const size_t a, const size_t b) { return _read_info[a].start_index() < _read_info[b].start_index(); });
+
+    // When sparsifying, each read has a bounded heap (weakest edge on top) of its strongest agreement edges
+    // and one of its strongest disagreement edges, so only 2 * nearest edges are held per read
+    std::vector<std::vector<Edge>> heaps(_nearest > 0 ? _reads * 2 : 0);
+    std::vector<mutex_type>        heap_mutexes(heaps.size());
+
+    auto offer = [&](const size_t read_idx, const Edge& edge)
+    {
+        const size_t heap_idx = read_idx * 2 + (edge.distance > 1.0f ? 1 : 0);
+        auto&        heap     = heaps[heap_idx];
+
+        mutex_type::scoped_lock lock(heap_mutexes[heap_idx]);
+        if (heap.size() < _nearest) {
+            heap.push_back(edge); std::push_heap(heap.begin(), heap.end(), stronger);
+        } else if (stronger(edge, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), stronger); 
+            heap.back() = edge;
+            std::push_heap(heap.begin(), heap.end(), stronger);
+        }
+    };
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, reads.size()),
+        [&](const tbb::blocked_range<size_t>& read_ids)
+        {
+            for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                const auto& read_one = _read_info[reads[i]];
+
+                for (size_t j = i + 1; j < reads.size() && 
+                     _read_info[reads[j]].start_index() <= read_one.end_index(); ++j) {
+                    // Reads in different components have no values in common, so the edge would be 1
+                    if (_read_components[reads[i]] != _read_components[reads[j]]) continue;
+                    if (_leaders[reads[i]] == _leaders[reads[j]])                 continue;
+
+                    // Same weighting as the gpu implementation -- a conflict is 10, a value vs a gap or no
+                    // value is 5 and a match is 0
+                    const auto   overlap  = _planes.compare(reads[i], reads[j]);
+                    const size_t distance = overlap.mismatches * 10 + overlap.exclusive * 5;
+                    const size_t valid    = overlap.shared + overlap.exclusive;
+
+                    // A distance of 1 gives no information about the partitions
+                    if (valid > 0 && distance * 2 != valid * 10) {
+                        Edge edge;
+                        edge.distance = static_cast<float>(distance / 10.f) / static_cast<float>(valid) + 0.5f;
+                        edge.f1       = std::min(_leaders[reads[i]], _leaders[reads[j]]);
+                        edge.f2       = std::max(_leaders[reads[i]], _leaders[reads[j]]);
+                        if (_nearest == 0) {
+                            _edges.push_back(edge);
+                        } else {
+                            offer(edge.f1, edge); offer(edge.f2, edge);
+                        }
+                    }
+                }
+            }
+        }
+    );
+
+    // The kept edges are those in the heap of either read, an edge in both heaps is only added for f1
+    for (size_t heap_idx = 0; heap_idx < heaps.size(); ++heap_idx) {
+        for (const auto& edge : heaps[heap_idx]) {
+            if (edge.f1 == heap_idx / 2) { _edges.push_back(edge); continue; }
+            const auto& other = heaps[edge.f1 * 2 + heap_idx % 2];
+            if (std::none_of(other.begin(), other.end(), 
+                    [&](const Edge& e) { return e.f1 == edge.f1 && e.f2 == edge.f2; })) _edges.push_back(edge);
+        }
+    }
+
+    // Sort by strength (distance from 1), the edge indices make the order deterministic
+    tbb::parallel_sort(_edges.begin(), _edges.end(), stronger);
+
+    // Each component gets its own edges, still strongest first
+    for (size_t edge_idx = 0; edge_idx < _edges.size(); ++edge_idx)
+        _components[_read_components[_edges[edge_idx].f1]].edges.push_back(edge_idx);
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_adjacency()
+{
+    _adjacency_offsets.assign(_reads + 1, 0);
+    _adjacency.resize(_edges.size() * 2);
+
+    for (const auto& edge : _edges) { ++_adjacency_offsets[edge.f1 + 1]; ++_adjacency_offsets[edge.f2 + 1]; }
+    for (size_t i = 0; i < _reads; ++i) _adjacency_offsets[i + 1] += _adjacency_offsets[i];
+
+    index_container next(_adjacency_offsets.begin(), _adjacency_offsets.end() - 1);
+    for (size_t edge_idx = 0; edge_idx < _edges.size(); ++edge_idx) {
+        _adjacency[next[_edges[edge_idx].f1]++] = edge_idx;
+        _adjacency[next[_edges[edge_idx].f2]++] = edge_idx;
+    }
+}
+
+template <typename SubBlockType>
+typename Graph<SubBlockType, devices::cpu>::Solution
+Graph<SubBlockType, devices::cpu>::solve_start(const size_t component, const size_t start   , const size_t seed,
+                                               const size_t bound    , Deadline&    deadline                   )
+                                               const
+{
+    const auto& edges = _components[component].edges;
+    Solution    solution(_components[component].reads.size(), _components[component].snps.size());
+
+    // Only the first start has to run when there is no time left, so that there is a solution
+    if (start > 0 && deadline.expired(false)) return solution;
+
+    // Start 0 is the deterministic search from the strongest edge, the others are randomized
+    std::mt19937_64 generator(seed);
+    size_t          seed_edge = 0;
+    if (start > 0 && !edges.empty()) {
+        std::uniform_int_distribution<size_t> edge_dist(0, std::min(edges.size(), size_t(SEED_EDGES)) - 1);
+        seed_edge = edge_dist(generator);
+    }
+
+    std::mt19937_64* start_generator = start > 0 ? &generator : nullptr;
+    if (_init == inits::spectral) map_spectral_partitions(component, solution, start_generator);
+    else                          map_to_partitions(component, solution, seed_edge, start_generator);
+    follow_leaders(component, solution);
+    determine_haplotypes(component, solution);
+    check_haplotypes(component, solution);
+    repartition(component, solution, false);
+    solution.mec_score = map_mec_score(component, solution);
+
+    // Refine the solution, keeping the best haplotypes which have been found
+    Solution current = solution;
+    size_t   prev_mec_score, iters = 0;
+    do {
+        prev_mec_score = current.mec_score;
+
+        repartition(component, current, true);
+        determine_haplotypes(component, current);
+        check_haplotypes(component, current);
+        current.mec_score = map_mec_score(component, current);
+
+        if (solution.mec_score > current.mec_score) solution = current;
+
+        // Give up on this start if it can't catch the first start at the rate it's improving
+        if (current.mec_score > bound && prev_mec_score > current.mec_score &&
+            current.mec_score - bound > (prev_mec_score - current.mec_score) * ABANDON_LOOKAHEAD) break;
+
+        // Stop if out of time, the best solution so far is kept
+        if (deadline.expired(prev_mec_score > current.mec_score)) break;
+    } while (prev_mec_score > current.mec_score && ++iters < ITERS);
+
+    return solution;
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_to_partitions(const size_t      component ,
+                                                          Solution&         solution  ,
+                                                          const size_t      seed_edge ,
+                                                          std::mt19937_64*  generator ) const
+{
+    // Edges are ordered by strength, then by the random tie breaker (or the edge index)
+    using queue_item = std::pair<std::pair<float, size_t>, size_t>;
+    std::priority_queue<queue_item> edge_queue;
+
+    const auto& edges = _components[component].edges;
+    auto&       sets  = solution.sets;
+
+    auto set = [&](const size_t read_idx) -> small_type& { return sets[_local_reads[read_idx]]; };
+
+    auto add_edges = [&](const size_t read_idx)
+    {
+        for (size_t i = _adjacency_offsets[read_idx]; i < _adjacency_offsets[read_idx + 1]; ++i) {
+            const auto edge_idx = _adjacency[i];
+            const auto strength = std::fabs(_edges[edge_idx].distance - 1.0f);
+            edge_queue.push(queue_item(std::make_pair(strength, generator ? (*generator)()
+                                                                          : _edges.size() - edge_idx), edge_idx));
+        }
+    };
+
+    // Grow the partitions from the seed edge, when the partitions can't grow any more (the graph is
+    // disconnected), seed again from the strongest edge which has no partitioned reads
+    bool   seeded    = false;
+    size_t next_seed = 0;
+    while (!edges.empty()) {
+        size_t edge_idx = edges[seed_edge];
+        if (seeded) {
+            while (next_seed < edges.size() && 
+                   (set(_edges[edges[next_seed]].f1) || set(_edges[edges[next_seed]].f2))) ++next_seed;
+            if (next_seed == edges.size()) break;
+            edge_idx = edges[next_seed];
+        }
+        seeded = true;
+
+        const auto& edge = _edges[edge_idx];
+        set(edge.f1) = 1; set(edge.f2) = edge.distance > 1.0f ? 2 : 1;
+        add_edges(edge.f1); add_edges(edge.f2);
+
+        while (!edge_queue.empty()) {
+            const auto& next = _edges[edge_queue.top().second]; edge_queue.pop();
+
+            if (set(next.f1) != 0 && set(next.f2) == 0) {
+                // Different reads go into the opposite partition, similar reads into the same one
+                set(next.f2) = next.distance > 1.0f ? 3 - set(next.f1) : set(next.f1);
+                add_edges(next.f2);
+            } else if (set(next.f2) != 0 && set(next.f1) == 0) {
+                set(next.f1) = next.distance > 1.0f ? 3 - set(next.f2) : set(next.f2);
+                add_edges(next.f1);
+            }
+        }
+    }
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::map_spectral_partitions(const size_t      component,
+                                                                Solution&         solution ,
+                                                                std::mt19937_64*  generator) const
+{
+    const auto&  reads     = _components[component].reads;
+    const size_t num_reads = reads.size();
+    if (_components[component].edges.empty()) return;
+
+    // Shift by the largest absolute row sum, which makes all the eigenvalues of the shifted matrix positive
+    const double shift = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, num_reads), 0.0,
+        [&](const tbb::blocked_range<size_t>& read_ids, double row_max) -> double
+        {
+            for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                double row_sum = 0.0;
+                for (size_t j = _adjacency_offsets[reads[i]]; j < _adjacency_offsets[reads[i] + 1]; ++j)
+                    row_sum += std::fabs(1.0 - _edges[_adjacency[j]].distance);
+                row_max = std::max(row_max, row_sum);
+            }
+            return row_max;
+        },
+        [](const double a, const double b) { return std::max(a, b); }
+    );
+
+    // The start vector must not be orthogonal to the eigenvector, so it can't be all the same
+    std::vector<double> vector(num_reads), next(num_reads);
+    std::uniform_real_distribution<double> value_dist(-0.5, 0.5);
+    for (size_t i = 0; i < num_reads; ++i) 
+        vector[i] = generator ? value_dist(*generator) 
+                              : static_cast<double>((i * 2654435761u) % 1000) / 1000.0 - 0.5;
+
+    for (size_t iters = 0; iters < SPECTRAL_ITERS; ++iters) {
+        // Sparse matrix-vector product over the adjacency of the reads
+        const double norm = std::sqrt(tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, num_reads), 0.0,
+            [&](const tbb::blocked_range<size_t>& read_ids, double sum) -> double
+            {
+                for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                    double value = shift * vector[i];
+                    for (size_t j = _adjacency_offsets[reads[i]]; j < _adjacency_offsets[reads[i] + 1]; ++j) {
+                        const auto& edge  = _edges[_adjacency[j]];
+                        const auto  other = edge.f1 == reads[i] ? edge.f2 : edge.f1;
+                        value += (1.0 - edge.distance) * vector[_local_reads[other]];
+                    }
+                    next[i] = value; sum += value * value;
+                }
+                return sum;
+            },
+            std::plus<double>()
+        ));
+        if (norm == 0.0) break;
+
+        const double change = tbb::parallel_reduce(
+            tbb::blocked_range<size_t>(0, num_reads), 0.0,
+            [&](const tbb::blocked_range<size_t>& read_ids, double max_change) -> double
+            {
+                for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                    next[i] /= norm;
+                    max_change = std::max(max_change, std::fabs(next[i] - vector[i]));
+                }
+                return max_change;
+            },
+            [](const double a, const double b) { return std::max(a, b); }
+        );
+        vector.swap(next);
+        if (change < SPECTRAL_TOLERANCE) break;
+    }
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_reads),
+        [&](const tbb::blocked_range<size_t>& read_ids)
+        {
+            for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                if (_adjacency_offsets[reads[i]] == _adjacency_offsets[reads[i] + 1]) continue;
+                solution.sets[i] = vector[i] >= 0.0 ? 1 : 2;
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::follow_leaders(const size_t component, Solution& solution) const
+{
+    const auto& reads = _components[component].reads;
+    for (size_t i = 0; i < reads.size(); ++i) {
+        const auto leader = _leaders[reads[i]];
+        if (leader != reads[i]) solution.sets[i] = solution.sets[_local_reads[leader]];
+    }
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::determine_haplotypes(const size_t component, Solution& solution) const
+{
+    const auto&  snps      = _components[component].snps;
+    const auto&  reads     = _components[component].reads;
+    const size_t num_snps  = snps.size();
+
+    // The reads of each set, so that the values of a snp can be counted a word of reads at a time
+    ColumnView::mask_container sets[2] = { ColumnView::mask_container(_columns.axis_words(), 0),
+                                           ColumnView::mask_container(_columns.axis_words(), 0) };
+    for (size_t i = 0; i < reads.size(); ++i) 
+        if (solution.sets[i] != 0) ColumnView::add_lane(sets[solution.sets[i] - 1], reads[i]);
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_snps),
+        [&](const tbb::blocked_range<size_t>& snp_ids)
+        {
+            for (size_t i = snp_ids.begin(); i != snp_ids.end(); ++i) {
+                size_t counts[2][2];                                // [set][value]
+                _columns.count(snps[i], sets[0], counts[0]);
+                _columns.count(snps[i], sets[1], counts[1]);
+
+                // The haplotype takes the majority value, the scores are the mismatches for the majority
+                // (best) and the minority (worst) value
+                solution.haplo_one[i]             = counts[0][0] >= counts[0][1] ? 0 : 1;
+                solution.scores_one[i]            = std::min(counts[0][0], counts[0][1]);
+                solution.scores_one[i + num_snps] = std::max(counts[0][0], counts[0][1]);
+                solution.haplo_two[i]             = counts[1][0] >= counts[1][1] ? 0 : 1;
+                solution.scores_two[i]            = std::min(counts[1][0], counts[1][1]);
+                solution.scores_two[i + num_snps] = std::max(counts[1][0], counts[1][1]);
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::check_haplotypes(const size_t component, Solution& solution) const
+{
+    const auto&  snps      = _components[component].snps;
+    const size_t num_snps  = snps.size();
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_snps),
+        [&](const tbb::blocked_range<size_t>& snp_ids)
+        {
+            for (size_t i = snp_ids.begin(); i != snp_ids.end(); ++i) {
+                if (_snp_info[snps[i]].type() == IH && solution.haplo_one[i] == solution.haplo_two[i]) {
+                    // The MEC score increase if each of the haplotypes is flipped
+                    const size_t mec_flip_one = solution.scores_one[i + num_snps] - solution.scores_one[i];
+                    const size_t mec_flip_two = solution.scores_two[i + num_snps] - solution.scores_two[i];
+
+                    // Flip the one which will make the least change to the MEC score
+                    if (mec_flip_one <= mec_flip_two) solution.haplo_one[i] = !solution.haplo_two[i];
+                    else                              solution.haplo_two[i] = !solution.haplo_one[i];
+                }
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::repartition(const size_t component, Solution& solution, 
+                                                    const bool   all_reads                    ) const
+{
+    const auto& reads = _components[component].reads;
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, reads.size()),
+        [&](const tbb::blocked_range<size_t>& read_ids)
+        {
+            for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                if (!all_reads && solution.sets[i] != 0) continue;
+
+                size_t conflicts_one = 0, conflicts_two = 0;
+                const auto& read_info = _read_info[reads[i]];
+                for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+                    const auto value = element(reads[i], snp_idx);
+                    if (value <= 1 && _snp_components[snp_idx] == component) {
+                        conflicts_one += value != solution.haplo_one[_local_snps[snp_idx]];
+                        conflicts_two += value != solution.haplo_two[_local_snps[snp_idx]];
+                    }
+                }
+                // Reads which fit both haplotypes equally stay where they are (or go into set 1)
+                if (conflicts_one < conflicts_two)      solution.sets[i] = 1;
+                else if (conflicts_two < conflicts_one) solution.sets[i] = 2;
+                else if (solution.sets[i] == 0)         solution.sets[i] = 1;
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+size_t Graph<SubBlockType, devices::cpu>::map_mec_score(const size_t component, const Solution& solution) const
+{
+    const auto& reads = _components[component].reads;
+
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, reads.size()), size_t(0),
+        [&](const tbb::blocked_range<size_t>& read_ids, size_t mec_score) -> size_t
+        {
+            for (size_t i = read_ids.begin(); i != read_ids.end(); ++i) {
+                size_t conflicts_one = 0, conflicts_two = 0;
+                const auto& read_info = _read_info[reads[i]];
+                for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+                    const auto value = element(reads[i], snp_idx);
+                    if (value <= 1 && _snp_components[snp_idx] == component) {
+                        conflicts_one += value != solution.haplo_one[_local_snps[snp_idx]];
+                        conflicts_two += value != solution.haplo_two[_local_snps[snp_idx]];
+                    }
+                }
+                mec_score += std::min(conflicts_one, conflicts_two);
+            }
+            return mec_score;
+        },
+        std::plus<size_t>()
+    );
+}
+
+template <typename SubBlockType>
+size_t Graph<SubBlockType, devices::cpu>::map_mec_score() const
+{
+    return _planes.mec_score(AllelePlanes::haplotype_plane(_haplo_one), 
+                             AllelePlanes::haplotype_plane(_haplo_two));
+}
+
+template <typename SubBlockType>
+void Graph<SubBlockType, devices::cpu>::set_sub_block_haplotypes()
+{
+    for (size_t i = 0; i < _snps; ++i) {
+        _sub_block._haplo_one.set(i, _haplo_one[i]);
+        _sub_block._haplo_two.set(i, _haplo_two[i]);
+    }
+}
+
+}           // End namespace haplo
+#endif      // PARAHAPLO_GRAPH_CPU_HPP
@@ -5,6 +5,7 @@
 #ifndef PARHAPLO_GRAPH_GPU_H
 #define PARHAPLO_GRAPH_GPU_H
 
+#include "budget.hpp"
 #include "cuda_error.h"
 #include "data.h"
 #include "devices.hpp"
@@ -23,6 +24,7 @@ class Graph<SubBlockType, devices::gpu> {
 public:
     //-------------------------------------------------------------------------------------------------------
     using binary_vector                 = BinaryVector<2>;
+    using data_container                = typename SubBlockType::data_container;
     using data_type                     = Data;
     using graph_type                    = internal::Graph;
     using read_info_type                = typename data_type::read_info_type;
@@ -35,8 +37,8 @@ public:
 private:
     SubBlockType&               _sub_block;
     // -------------------------------------------- HOST ----------------------------------------------------
-    binary_vector&              _data_cpu;
-    read_info_container&        _read_info;
+    data_container&             _data_cpu;
+    read_info_container         _read_info;         //!< The read information as an array for the device
     snp_info_container          _snp_info;
     small_container             _haplotype;
     small_container             _alignments;
@@ -82,7 +84,15 @@ public:
     /// @brief      Solves the graph for the haplotypes
     //-------------------------------------------------------------------------------------------------------
     CUDA_H
-    void search();
+    void search() { Deadline unlimited; search(unlimited); }
+    
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the graph for the haplotypes, stopping the refinement when the deadline is reached
+    ///             -- the best haplotypes found before the deadline are kept
+    /// @param[in]  deadline    The deadline for the search
+    //-------------------------------------------------------------------------------------------------------
+    CUDA_H
+    void search(Deadline& deadline);
    
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Prints the MEC score
@@ -119,7 +129,8 @@ private:
 template <typename SubBlockType>
 Graph<SubBlockType, devices::gpu>::Graph(SubBlockType& sub_block, const size_t device)
 : _sub_block(sub_block)                     , _data_cpu(sub_block.data())               , 
-  _read_info(sub_block.read_info())         , _snp_info(sub_block.snp_info())           , 
+  _read_info(sub_block.read_info().to_read_info())                                      , 
+  _snp_info(sub_block.snp_info())                                                       , 
   _haplotype(sub_block.snp_info().size())   , _alignments(sub_block.read_info().size()) , 
   _snps(sub_block.snp_info().size())        , _reads(sub_block.read_info().size())      ,
   _device(device)                           , _nih_cols(sub_block.nih_columns())        ,
@@ -181,7 +192,7 @@ Graph<SubBlockType, devices::gpu>::Graph(SubBlockType& sub_block, const size_t d
 }
 
 template <typename SubBlockType>
-void Graph<SubBlockType, devices::gpu>::search()
+void Graph<SubBlockType, devices::gpu>::search(Deadline& deadline)
 {
     // The number of total edges required
     const size_t num_edges = _reads * (_reads - 1) / 2; 
@@ -252,7 +263,8 @@ void Graph<SubBlockType, devices::gpu>::search()
     do {
         prev_mec_score = refine_solution(&streams[0], mem_size);
         if (prev_mec_score == _mec_score) ++terminate;
-    } while (prev_mec_score >= _mec_score && terminate < ITERS);
+    } while (prev_mec_score >= _mec_score && terminate < ITERS && 
+             !deadline.expired(prev_mec_score > _mec_score)         );
     
     // Put the haplotypes back into the sub_block 
     set_sub_block_haplotypes();
@@ -0,0 +1,22 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   Header file for parahaplo multilevel class
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARHAPLO_MULTILEVEL_H
+#define PARHAPLO_MULTILEVEL_H
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      Multilevel
+/// @brief      Multilevel search for the haplotypes of large sub-blocks -- the reads are coarsened into
+///             weighted super-fragments, the coarsest problem is solved, and the solution is projected back
+///             and refined at each level
+/// @tparam     SubBlockType    The type of the sublock to find the haplotypes for
+/// @tparam     DeviceType      The type of device to run the search on
+// ----------------------------------------------------------------------------------------------------------
+template <typename SubBlockType, uint8_t DeviceType>
+class Multilevel;
+
+}           // End namespace haplo
+#endif      // PARAHAPLO_MULTILEVEL_H
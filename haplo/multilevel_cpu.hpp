@@ -0,0 +1,799 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   Header file for parahaplo multilevel class -- cpu implementation
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARHAPLO_MULTILEVEL_CPU_HPP
+#define PARHAPLO_MULTILEVEL_CPU_HPP
+
+#include "budget.hpp"
+#include "devices.hpp"
+#include "multilevel.h"
+#include "read_info.h"
+#include "snp_info_gpu.h"
+
+#include <tbb/tbb.h>
+#include <tbb/concurrent_vector.h>
+#include <tbb/parallel_sort.h>
+#include <thrust/host_vector.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#ifndef COARSEN_WINDOW
+    #define COARSEN_WINDOW          16      // Following fragments (by start) a fragment can merge with
+#endif
+#ifndef COARSEST_FRAGMENTS
+    #define COARSEST_FRAGMENTS      512     // Default number of fragments at which the coarsening stops
+#endif
+#define COARSEN_MIN_AGREEMENT       2       // Minimum weighted matches - conflicts to merge fragments
+#define COARSEN_CONFLICT_RATIO      4       // Matches must be at least this many times the conflicts to merge
+#define COARSEN_MIN_REDUCTION       10      // Percentage the fragments must reduce by for a level to be added
+#define COARSEST_WINDOW             64      // Following fragments compared when solving the coarsest
+#define REFINE_ITERS                64      // Maximum number of refinement iterations at each level
+
+#ifndef NIH
+    #define IH  0x00
+    #define NIH 0x01
+#endif
+
+namespace haplo {
+
+// Specialization for cpu
+template <typename SubBlockType>
+class Multilevel<SubBlockType, devices::cpu> {
+public:
+    //-------------------------------------------------------------------------------------------------------
+    using small_type                    = uint8_t;
+    using small_container               = thrust::host_vector<small_type>;
+    using snp_info_container            = thrust::host_vector<SnpInfoGpu>;
+    using index_container               = std::vector<size_t>;
+    //-------------------------------------------------------------------------------------------------------
+    static constexpr size_t NO_PARENT   = static_cast<size_t>(-1);
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Weight
+    /// @brief      The number of reads in a fragment with each value at a snp
+    // ------------------------------------------------------------------------------------------------------
+    struct Weight {
+        uint32_t    zeros;
+        uint32_t    ones;
+    };
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Fragment
+    /// @brief      A read, or a super-fragment of reads which agree, covering the snps start to end
+    // ------------------------------------------------------------------------------------------------------
+    struct Fragment {
+        size_t      start;          //!< The first snp of the fragment
+        size_t      end;            //!< The last snp of the fragment
+        size_t      offset;         //!< The offset of the fragment's weights in the level's weights
+    };
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Candidate
+    /// @brief      A pair of fragments which could be merged, and how strongly they agree
+    // ------------------------------------------------------------------------------------------------------
+    struct Candidate {
+        int64_t     agreement;
+        size_t      f1;
+        size_t      f2;
+    };
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Level
+    /// @brief      The fragments at one level of the coarsening, level 0 has a fragment per selected read
+    // ------------------------------------------------------------------------------------------------------
+    struct Level {
+        std::vector<Fragment>   fragments;      //!< The fragments of the level
+        std::vector<Weight>     weights;        //!< The weights of all the fragments
+        index_container         parents;        //!< The fragment of the next level each is merged into
+        index_container         cover;          //!< The fragments which cover each snp
+        index_container         cover_offsets;  //!< The start of each snp's fragments in the cover
+    };
+
+    SubBlockType&               _sub_block;
+    snp_info_container          _snp_info;          //!< The information for each of the snps
+    std::vector<Level>          _levels;            //!< The levels of the coarsening, finest first
+    index_container             _fragment_reads;    //!< The read of each fragment of the finest level
+    small_container             _haplo_one;         //!< The first haplotype of the solution
+    small_container             _haplo_two;         //!< The second haplotype of the solution
+    size_t                      _coarsest;          //!< The number of fragments the coarsening stops at
+    size_t                      _snps;
+    size_t                      _reads;
+    size_t                      _mec_score;
+public:
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- creates the fragments for the reads and coarsens them
+    /// @param[in]  sub_block           The sub-block to find the haplotypes for
+    /// @param[in]  coarsest_fragments  The number of fragments the coarsening stops at
+    //-------------------------------------------------------------------------------------------------------
+    Multilevel(SubBlockType& sub_block, const size_t coarsest_fragments = COARSEST_FRAGMENTS);
+
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the coarsest level, then projects the solution back to the reads, refining it at
+    ///             each level, and puts the haplotypes into the sub-block. Reads which the sub-block discarded
+    ///             (coverage cap) have no fragment, they are placed against the haplotypes afterwards
+    //-------------------------------------------------------------------------------------------------------
+    void search() { Deadline unlimited; search(unlimited); }
+
+    //-------------------------------------------------------------------------------------------------------
+    /// @brief      Solves the coarsest level and projects the solution back to the reads (as above), but
+    ///             once the deadline is reached each remaining level is only refined once, which is enough
+    ///             to carry the best partition found so far down to the reads
+    /// @param[in]  deadline    The deadline for the search
+    //-------------------------------------------------------------------------------------------------------
+    void search(Deadline& deadline);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the MEC score of the solution
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t mec_score() const { return _mec_score; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of levels, including the level of the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t levels() const { return _levels.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of fragments at a level
+    /// @param[in]  level   The index of the level
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t fragments(const size_t level) const { return _levels[level].fragments.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Prints the MEC score
+    // ------------------------------------------------------------------------------------------------------
+    void print_mec() const { std::cout << "MEC SCORE : " << _mec_score << "\n"; }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the weight of a fragment at a snp
+    /// @param[in]  level       The level of the fragment
+    /// @param[in]  fragment    The fragment
+    /// @param[in]  snp_idx     The index of the snp
+    // ------------------------------------------------------------------------------------------------------
+    static inline const Weight& weight(const Level& level, const Fragment& fragment, const size_t snp_idx)
+    {
+        return level.weights[fragment.offset + snp_idx - fragment.start];
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the finest level, with a fragment for each selected read
+    // ------------------------------------------------------------------------------------------------------
+    void map_fragments();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds the level of the read clusters of the sub-block as the first coarse level, with a
+    ///             fragment per cluster weighted by the values of all its reads. The reads are still refined
+    ///             individually at the finest level, so a read which fits the other haplotype can still move
+    // ------------------------------------------------------------------------------------------------------
+    void map_clusters();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Creates the list of the fragments which cover each snp for a level
+    /// @param[in]  level       The level to create the cover for
+    // ------------------------------------------------------------------------------------------------------
+    void map_cover(Level& level) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds a coarser level by merging pairs of strongly agreeing overlapping fragments
+    /// @return     If a level was added -- not if the fragments could not be reduced enough
+    // ------------------------------------------------------------------------------------------------------
+    bool coarsen();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines how much two fragments agree at the snps they overlap, the values are weighted
+    ///             by the confidence of each fragment (the difference between its zeros and ones)
+    /// @param[in]  level       The level of the fragments
+    /// @param[in]  f1          The index of the first fragment
+    /// @param[in]  f2          The index of the second fragment
+    /// @param[out] conflicts   The weight of the conflicting snps
+    /// @return     The weight of the matching snps
+    // ------------------------------------------------------------------------------------------------------
+    int64_t agreement(const Level& level, const size_t f1, const size_t f2, int64_t& conflicts) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the fragments of a level ordered by their start snp
+    /// @param[in]  level       The level to order the fragments of
+    // ------------------------------------------------------------------------------------------------------
+    index_container ordered_fragments(const Level& level) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Partitions the fragments of the coarsest level by growing the partitions along the
+    ///             strongest agreements and conflicts
+    /// @param[out] sets        The partition (1 or 2) of each fragment
+    // ------------------------------------------------------------------------------------------------------
+    void solve_coarsest(small_container& sets) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Refines the partition of a level by moving the fragments to the haplotype they conflict
+    ///             with the least, until the MEC score stops improving or the deadline is reached
+    /// @param[in]  level       The level to refine
+    /// @param[in]  sets        The partition of the fragments, the best partition on return
+    /// @param[in]  deadline    The deadline for the search
+    /// @return     The MEC score of the best partition
+    // ------------------------------------------------------------------------------------------------------
+    size_t refine(const Level& level, small_container& sets, Deadline& deadline);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the haplotypes from the partition of a level, and makes sure that the
+    ///             haplotypes are different at the IH snps
+    /// @param[in]  level       The level of the partition
+    /// @param[in]  sets        The partition of the fragments
+    // ------------------------------------------------------------------------------------------------------
+    void determine_haplotypes(const Level& level, const small_container& sets);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the haplotypes at a snp to the majority value of each partition, and if they are the
+    ///             same at an IH snp flips the haplotype which increases the MEC score the least
+    /// @param[in]  snp_idx     The index of the snp
+    /// @param[in]  counts      The number of each value [value] in each partition [set]
+    // ------------------------------------------------------------------------------------------------------
+    void set_haplotypes(const size_t snp_idx, const size_t (&counts)[2][2]);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves each fragment into the partition whose haplotype it conflicts with the least
+    /// @param[in]  level       The level of the partition
+    /// @param[in]  sets        The partition of the fragments
+    // ------------------------------------------------------------------------------------------------------
+    void repartition(const Level& level, small_container& sets) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the MEC score of the haplotypes for a level -- the fragments of a coarse level
+    ///             can only be in one of the partitions as a whole
+    /// @param[in]  level       The level to determine the MEC score for
+    // ------------------------------------------------------------------------------------------------------
+    size_t map_mec_score(const Level& level) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines the MEC score of the haplotypes for all the reads of the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    size_t map_mec_score() const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the result of the haplotype to the sub block
+    // ------------------------------------------------------------------------------------------------------
+    void set_sub_block_haplotypes();
+};
+
+// ------------------------------------------------ IMPLEMENTATIONS -----------------------------------------
+
+template <typename SubBlockType>
+constexpr size_t Multilevel<SubBlockType, devices::cpu>::NO_PARENT;
+
+template <typename SubBlockType>
+Multilevel<SubBlockType, devices::cpu>::Multilevel(SubBlockType& sub_block, const size_t coarsest_fragments)
+: _sub_block(sub_block)         , _snp_info(sub_block.snp_info())   ,
+  _coarsest(coarsest_fragments) , _snps(_snp_info.size())           , 
+  _reads(sub_block.reads())     , _mec_score(INT_MAX)
+{
+    map_fragments();
+    map_clusters();
+    while (coarsen()) {}
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::search(Deadline& deadline)
+{
+    if (_reads == 0 || _snps == 0) { _mec_score = 0; return; }
+
+    _haplo_one.assign(_snps, 0); _haplo_two.assign(_snps, 0);
+
+    small_container sets;
+    solve_coarsest(sets);
+
+    // Refine each level, and project the partition onto the next finer level -- the fragments which were
+    // merged agree, so they go into the partition of the fragment they were merged into
+    for (size_t level_idx = _levels.size(); level_idx > 0; --level_idx) {
+        _mec_score = refine(_levels[level_idx - 1], sets, deadline);
+
+        if (level_idx > 1) {
+            const auto&     finer = _levels[level_idx - 2];
+            small_container finer_sets(finer.fragments.size());
+            tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, finer_sets.size()),
+                [&](const tbb::blocked_range<size_t>& fragment_ids)
+                {
+                    for (size_t i = fragment_ids.begin(); i != fragment_ids.end(); ++i)
+                        finer_sets[i] = sets[finer.parents[i]];
+                }
+            );
+            sets = std::move(finer_sets);
+        }
+    }
+
+    // Put the haplotypes back into the sub_block, and place the reads it discarded against them, which sets
+    // the snps which only the discarded reads have values at
+    set_sub_block_haplotypes();
+    if (_sub_block.discarded_reads() > 0) {
+        _sub_block.place_discarded_reads();
+        for (size_t snp_idx = 0; snp_idx < _snps; ++snp_idx) {
+            _haplo_one[snp_idx] = _sub_block.haplo_one().get(snp_idx);
+            _haplo_two[snp_idx] = _sub_block.haplo_two().get(snp_idx);
+        }
+        _mec_score = map_mec_score();
+    }
+}
+
+// ------------------------------------------------ PRIVATE -------------------------------------------------
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::map_fragments()
+{
+    _levels.resize(1);
+    auto& level = _levels[0];
+
+    _fragment_reads.clear();
+    for (size_t read_idx = 0; read_idx < _reads; ++read_idx) {
+        if (_sub_block.read_selected(read_idx)) _fragment_reads.push_back(read_idx);
+    }
+    level.fragments.resize(_fragment_reads.size());
+
+    size_t offset = 0;
+    for (size_t fragment_idx = 0; fragment_idx < _fragment_reads.size(); ++fragment_idx) {
+        const auto& read_info = _sub_block.read_info()[_fragment_reads[fragment_idx]];
+        level.fragments[fragment_idx].start  = read_info.start_index();
+        level.fragments[fragment_idx].end    = read_info.end_index();
+        level.fragments[fragment_idx].offset = offset;
+        offset += read_info.length();
+    }
+    level.weights.resize(offset);
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _fragment_reads.size()),
+        [&](const tbb::blocked_range<size_t>& fragment_ids)
+        {
+            for (size_t fragment_idx = fragment_ids.begin(); fragment_idx != fragment_ids.end(); 
+                 ++fragment_idx) {
+                const auto& fragment = level.fragments[fragment_idx];
+                for (size_t snp_idx = fragment.start; snp_idx <= fragment.end; ++snp_idx) {
+                    const auto value = _sub_block(_fragment_reads[fragment_idx], snp_idx);
+                    auto&      w     = level.weights[fragment.offset + snp_idx - fragment.start];
+                    w.zeros = value == 0; w.ones = value == 1;
+                }
+            }
+        }
+    );
+    map_cover(level);
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::map_clusters()
+{
+    auto&        reads     = _levels[0];
+    const size_t fragments = reads.fragments.size();
+    if (fragments <= _coarsest) return;
+
+    // The reads of a cluster all have the same span, so the first read of each gives the cluster's span
+    index_container cluster_fragments(_sub_block.num_clusters(), NO_PARENT), parents(fragments), firsts;
+    for (size_t fragment_idx = 0; fragment_idx < fragments; ++fragment_idx) {
+        auto& cluster_idx = cluster_fragments[_sub_block.read_cluster(_fragment_reads[fragment_idx])];
+        if (cluster_idx == NO_PARENT) { cluster_idx = firsts.size(); firsts.push_back(fragment_idx); }
+        parents[fragment_idx] = cluster_idx;
+    }
+    if (firsts.size() == fragments) return;
+
+    Level  clusters;
+    size_t offset = 0;
+    clusters.fragments.resize(firsts.size());
+    for (size_t cluster_idx = 0; cluster_idx < firsts.size(); ++cluster_idx) {
+        clusters.fragments[cluster_idx]        = reads.fragments[firsts[cluster_idx]];
+        clusters.fragments[cluster_idx].offset = offset;
+        offset += clusters.fragments[cluster_idx].end - clusters.fragments[cluster_idx].start + 1;
+    }
+    clusters.weights.assign(offset, Weight{0, 0});
+
+    // Sequential, since a cluster can have any number of reads
+    for (size_t fragment_idx = 0; fragment_idx < fragments; ++fragment_idx) {
+        const auto& read    = reads.fragments[fragment_idx];
+        const auto& cluster = clusters.fragments[parents[fragment_idx]];
+        for (size_t snp_idx = read.start; snp_idx <= read.end; ++snp_idx) {
+            const auto& w = weight(reads, read, snp_idx);
+            auto& total   = clusters.weights[cluster.offset + snp_idx - cluster.start];
+            total.zeros += w.zeros; total.ones += w.ones;
+        }
+    }
+    map_cover(clusters);
+
+    reads.parents = std::move(parents);
+    _levels.push_back(std::move(clusters));
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::map_cover(Level& level) const
+{
+    level.cover_offsets.assign(_snps + 1, 0);
+    for (const auto& fragment : level.fragments) {
+        for (size_t snp_idx = fragment.start; snp_idx <= fragment.end; ++snp_idx)
+            ++level.cover_offsets[snp_idx + 1];
+    }
+    for (size_t i = 0; i < _snps; ++i) level.cover_offsets[i + 1] += level.cover_offsets[i];
+
+    level.cover.resize(level.cover_offsets[_snps]);
+    index_container next(level.cover_offsets.begin(), level.cover_offsets.end() - 1);
+    for (size_t fragment_idx = 0; fragment_idx < level.fragments.size(); ++fragment_idx) {
+        const auto& fragment = level.fragments[fragment_idx];
+        for (size_t snp_idx = fragment.start; snp_idx <= fragment.end; ++snp_idx)
+            level.cover[next[snp_idx]++] = fragment_idx;
+    }
+}
+
+template <typename SubBlockType>
+typename Multilevel<SubBlockType, devices::cpu>::index_container
+Multilevel<SubBlockType, devices::cpu>::ordered_fragments(const Level& level) const
+{
+    index_container order(level.fragments.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+        [&](const size_t a, const size_t b) { return level.fragments[a].start < level.fragments[b].start; });
+    return order;
+}
+
+template <typename SubBlockType>
+int64_t Multilevel<SubBlockType, devices::cpu>::agreement(const Level& level, const size_t f1,
+                                                          const size_t f2   , int64_t&     conflicts) const
+{
+    const auto& frag_one = level.fragments[f1];
+    const auto& frag_two = level.fragments[f2];
+    int64_t     matches  = 0;
+    conflicts = 0;
+
+    for (size_t snp_idx = std::max(frag_one.start, frag_two.start);
+         snp_idx <= std::min(frag_one.end, frag_two.end); ++snp_idx) {
+        const auto&   w1    = weight(level, frag_one, snp_idx);
+        const auto&   w2    = weight(level, frag_two, snp_idx);
+        const int64_t sign1 = static_cast<int64_t>(w1.ones) - w1.zeros;
+        const int64_t sign2 = static_cast<int64_t>(w2.ones) - w2.zeros;
+
+        if (sign1 == 0 || sign2 == 0) continue;
+        if ((sign1 > 0) == (sign2 > 0)) matches   += std::min(std::abs(sign1), std::abs(sign2));
+        else                            conflicts += std::min(std::abs(sign1), std::abs(sign2));
+    }
+    return matches;
+}
+
+template <typename SubBlockType>
+bool Multilevel<SubBlockType, devices::cpu>::coarsen()
+{
+    const size_t fine_idx  = _levels.size() - 1;
+    const size_t fragments = _levels[fine_idx].fragments.size();
+    if (fragments <= _coarsest) return false;
+
+    const auto&                          fine  = _levels[fine_idx];
+    const index_container                order = ordered_fragments(fine);
+    tbb::concurrent_vector<Candidate>    candidates;
+
+    // Only the next few fragments (by start) are compared, which keeps the coarsening linear in the reads
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, fragments),
+        [&](const tbb::blocked_range<size_t>& order_ids)
+        {
+            for (size_t i = order_ids.begin(); i != order_ids.end(); ++i) {
+                const size_t f1 = order[i];
+                for (size_t j = i + 1; j < fragments && j <= i + COARSEN_WINDOW; ++j) {
+                    const size_t f2 = order[j];
+                    if (fine.fragments[f2].start > fine.fragments[f1].end) break;
+
+                    int64_t       conflicts = 0;
+                    const int64_t matches   = agreement(fine, f1, f2, conflicts);
+                    if (matches - conflicts >= COARSEN_MIN_AGREEMENT &&
+                        matches >= conflicts * COARSEN_CONFLICT_RATIO) {
+                        Candidate candidate;
+                        candidate.agreement = matches - conflicts;
+                        candidate.f1        = std::min(f1, f2);
+                        candidate.f2        = std::max(f1, f2);
+                        candidates.push_back(candidate);
+                    }
+                }
+            }
+        }
+    );
+
+    // Greedily match the fragments, strongest agreement first, the indices make the order deterministic
+    tbb::parallel_sort(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b)
+        {
+            if (a.agreement != b.agreement) return a.agreement > b.agreement;
+            return a.f1 != b.f1 ? a.f1 < b.f1 : a.f2 < b.f2;
+        }
+    );
+
+    index_container partners(fragments, NO_PARENT);
+    for (const auto& candidate : candidates) {
+        if (partners[candidate.f1] == NO_PARENT && partners[candidate.f2] == NO_PARENT) {
+            partners[candidate.f1] = candidate.f2; partners[candidate.f2] = candidate.f1;
+        }
+    }
+
+    // Number the coarse fragments in the order of their start, so that they stay local in memory
+    index_container parents(fragments, NO_PARENT);
+    size_t          coarse_fragments = 0;
+    for (const auto fragment_idx : order) {
+        if (parents[fragment_idx] != NO_PARENT) continue;
+        parents[fragment_idx] = coarse_fragments;
+        if (partners[fragment_idx] != NO_PARENT) parents[partners[fragment_idx]] = coarse_fragments;
+        ++coarse_fragments;
+    }
+
+    // Not worth adding another level
+    if (coarse_fragments * 100 > fragments * (100 - COARSEN_MIN_REDUCTION)) return false;
+
+    Level coarse;
+    coarse.fragments.resize(coarse_fragments);
+    for (auto& fragment : coarse.fragments) { fragment.start = _snps; fragment.end = 0; }
+    for (size_t fragment_idx = 0; fragment_idx < fragments; ++fragment_idx) {
+        auto& fragment = coarse.fragments[parents[fragment_idx]];
+        fragment.start = std::min(fragment.start, fine.fragments[fragment_idx].start);
+        fragment.end   = std::max(fragment.end  , fine.fragments[fragment_idx].end  );
+    }
+
+    size_t offset = 0;
+    for (auto& fragment : coarse.fragments) {
+        fragment.offset = offset; offset += fragment.end - fragment.start + 1;
+    }
+    coarse.weights.resize(offset, Weight{0, 0});
+
+    // Each coarse fragment has at most two fine fragments, so the weights can be added in parallel by the
+    // coarse fragments
+    index_container members(coarse_fragments * 2, NO_PARENT);
+    for (size_t fragment_idx = 0; fragment_idx < fragments; ++fragment_idx) {
+        const size_t parent = parents[fragment_idx];
+        members[2 * parent + (members[2 * parent] != NO_PARENT)] = fragment_idx;
+    }
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, coarse_fragments),
+        [&](const tbb::blocked_range<size_t>& coarse_ids)
+        {
+            for (size_t coarse_idx = coarse_ids.begin(); coarse_idx != coarse_ids.end(); ++coarse_idx) {
+                const auto& fragment = coarse.fragments[coarse_idx];
+                for (size_t m = 2 * coarse_idx; m < 2 * coarse_idx + 2 && members[m] != NO_PARENT; ++m) {
+                    const auto& member = fine.fragments[members[m]];
+                    for (size_t snp_idx = member.start; snp_idx <= member.end; ++snp_idx) {
+                        const auto& w = weight(fine, member, snp_idx);
+                        auto& total   = coarse.weights[fragment.offset + snp_idx - fragment.start];
+                        total.zeros += w.zeros; total.ones += w.ones;
+                    }
+                }
+            }
+        }
+    );
+    map_cover(coarse);
+
+    _levels[fine_idx].parents = std::move(parents);
+    _levels.push_back(std::move(coarse));
+    return true;
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::solve_coarsest(small_container& sets) const
+{
+    const auto&           level     = _levels.back();
+    const size_t          fragments = level.fragments.size();
+    const index_container order     = ordered_fragments(level);
+
+    // The signed agreements between the fragments -- positive fragments go into the same partition, and
+    // negative ones into opposite partitions
+    tbb::concurrent_vector<Candidate> edges;
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, fragments),
+        [&](const tbb::blocked_range<size_t>& order_ids)
+        {
+            for (size_t i = order_ids.begin(); i != order_ids.end(); ++i) {
+                const size_t f1 = order[i];
+                for (size_t j = i + 1; j < fragments && j <= i + COARSEST_WINDOW; ++j) {
+                    const size_t f2 = order[j];
+                    if (level.fragments[f2].start > level.fragments[f1].end) break;
+
+                    int64_t       conflicts = 0;
+                    const int64_t matches   = agreement(level, f1, f2, conflicts);
+                    if (matches != conflicts) {
+                        Candidate edge;
+                        edge.agreement = matches - conflicts;
+                        edge.f1        = std::min(f1, f2);
+                        edge.f2        = std::max(f1, f2);
+                        edges.push_back(edge);
+                    }
+                }
+            }
+        }
+    );
+
+    index_container adjacency_offsets(fragments + 1, 0), adjacency(edges.size() * 2);
+    for (const auto& edge : edges) { ++adjacency_offsets[edge.f1 + 1]; ++adjacency_offsets[edge.f2 + 1]; }
+    for (size_t i = 0; i < fragments; ++i) adjacency_offsets[i + 1] += adjacency_offsets[i];
+    index_container next(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (size_t edge_idx = 0; edge_idx < edges.size(); ++edge_idx) {
+        adjacency[next[edges[edge_idx].f1]++] = edge_idx;
+        adjacency[next[edges[edge_idx].f2]++] = edge_idx;
+    }
+
+    // Grow the partitions along the strongest edges, starting again from the next unpartitioned fragment
+    // (in start order) when the graph is disconnected
+    using queue_item = std::pair<std::pair<int64_t, size_t>, size_t>;
+    std::priority_queue<queue_item> edge_queue;
+
+    sets.assign(fragments, 0);
+    auto add_edges = [&](const size_t fragment_idx)
+    {
+        for (size_t i = adjacency_offsets[fragment_idx]; i < adjacency_offsets[fragment_idx + 1]; ++i) {
+            const auto edge_idx = adjacency[i];
+            edge_queue.push(queue_item(std::make_pair(std::abs(edges[edge_idx].agreement),
+                                                      edges.size() - edge_idx), edge_idx));
+        }
+    };
+
+    for (const auto root : order) {
+        if (sets[root] != 0) continue;
+        sets[root] = 1; add_edges(root);
+
+        while (!edge_queue.empty()) {
+            const auto& edge = edges[edge_queue.top().second]; edge_queue.pop();
+            const bool  same = edge.agreement > 0;
+
+            if (sets[edge.f1] != 0 && sets[edge.f2] == 0) {
+                sets[edge.f2] = same ? sets[edge.f1] : 3 - sets[edge.f1];
+                add_edges(edge.f2);
+            } else if (sets[edge.f2] != 0 && sets[edge.f1] == 0) {
+                sets[edge.f1] = same ? sets[edge.f2] : 3 - sets[edge.f2];
+                add_edges(edge.f1);
+            }
+        }
+    }
+}
+
+template <typename SubBlockType>
+size_t Multilevel<SubBlockType, devices::cpu>::refine(const Level& level   , small_container& sets,
+                                                     Deadline&    deadline                        )
+{
+    small_container best_sets, best_one, best_two;
+    size_t          best_mec = INT_MAX;
+
+    // The first iteration gives the haplotypes for the partition, the others only run if they improved it
+    // and there is still time
+    for (size_t iters = 0; iters < REFINE_ITERS; ++iters) {
+        if (iters > 0 && (deadline.hit() || deadline.expired(true))) break;
+        determine_haplotypes(level, sets);
+        const size_t mec_score = map_mec_score(level);
+        if (mec_score >= best_mec) break;
+
+        best_mec = mec_score; best_sets = sets; best_one = _haplo_one; best_two = _haplo_two;
+        repartition(level, sets);
+    }
+
+    sets = std::move(best_sets); _haplo_one = std::move(best_one); _haplo_two = std::move(best_two);
+    return best_mec;
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::determine_haplotypes(const Level&           level,
+                                                                  const small_container& sets )
+{
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _snps),
+        [&](const tbb::blocked_range<size_t>& snp_ids)
+        {
+            for (size_t snp_idx = snp_ids.begin(); snp_idx != snp_ids.end(); ++snp_idx) {
+                size_t counts[2][2] = {{0, 0}, {0, 0}};      // [set][value]
+
+                for (size_t i = level.cover_offsets[snp_idx]; i < level.cover_offsets[snp_idx + 1]; ++i) {
+                    const auto  fragment_idx = level.cover[i];
+                    const auto& w            = weight(level, level.fragments[fragment_idx], snp_idx);
+                    if (sets[fragment_idx] == 0) continue;
+                    counts[sets[fragment_idx] - 1][0] += w.zeros;
+                    counts[sets[fragment_idx] - 1][1] += w.ones;
+                }
+                set_haplotypes(snp_idx, counts);
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::set_haplotypes(const size_t snp_idx, const size_t (&counts)[2][2])
+{
+    // The haplotypes take the majority value, and if they are the same at an IH snp the haplotype which
+    // increases the MEC score the least is flipped
+    _haplo_one[snp_idx] = counts[0][0] >= counts[0][1] ? 0 : 1;
+    _haplo_two[snp_idx] = counts[1][0] >= counts[1][1] ? 0 : 1;
+
+    if (_snp_info[snp_idx].type() == IH && _haplo_one[snp_idx] == _haplo_two[snp_idx]) {
+        const size_t mec_flip_one = std::max(counts[0][0], counts[0][1]) - std::min(counts[0][0], counts[0][1]);
+        const size_t mec_flip_two = std::max(counts[1][0], counts[1][1]) - std::min(counts[1][0], counts[1][1]);
+
+        if (mec_flip_one <= mec_flip_two) _haplo_one[snp_idx] = !_haplo_two[snp_idx];
+        else                              _haplo_two[snp_idx] = !_haplo_one[snp_idx];
+    }
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::repartition(const Level& level, small_container& sets) const
+{
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, level.fragments.size()),
+        [&](const tbb::blocked_range<size_t>& fragment_ids)
+        {
+            for (size_t fragment_idx = fragment_ids.begin(); fragment_idx != fragment_ids.end();
+                 ++fragment_idx) {
+                const auto& fragment      = level.fragments[fragment_idx];
+                size_t      conflicts_one = 0, conflicts_two = 0;
+
+                for (size_t snp_idx = fragment.start; snp_idx <= fragment.end; ++snp_idx) {
+                    const auto& w = weight(level, fragment, snp_idx);
+                    conflicts_one += _haplo_one[snp_idx] ? w.zeros : w.ones;
+                    conflicts_two += _haplo_two[snp_idx] ? w.zeros : w.ones;
+                }
+                // Fragments which fit both haplotypes equally stay where they are (or go into set 1)
+                if (conflicts_one < conflicts_two)      sets[fragment_idx] = 1;
+                else if (conflicts_two < conflicts_one) sets[fragment_idx] = 2;
+                else if (sets[fragment_idx] == 0)       sets[fragment_idx] = 1;
+            }
+        }
+    );
+}
+
+template <typename SubBlockType>
+size_t Multilevel<SubBlockType, devices::cpu>::map_mec_score(const Level& level) const
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, level.fragments.size()), size_t(0),
+        [&](const tbb::blocked_range<size_t>& fragment_ids, size_t mec_score) -> size_t
+        {
+            for (size_t fragment_idx = fragment_ids.begin(); fragment_idx != fragment_ids.end();
+                 ++fragment_idx) {
+                const auto& fragment      = level.fragments[fragment_idx];
+                size_t      conflicts_one = 0, conflicts_two = 0;
+
+                for (size_t snp_idx = fragment.start; snp_idx <= fragment.end; ++snp_idx) {
+                    const auto& w = weight(level, fragment, snp_idx);
+                    conflicts_one += _haplo_one[snp_idx] ? w.zeros : w.ones;
+                    conflicts_two += _haplo_two[snp_idx] ? w.zeros : w.ones;
+                }
+                mec_score += std::min(conflicts_one, conflicts_two);
+            }
+            return mec_score;
+        },
+        std::plus<size_t>()
+    );
+}
+
+template <typename SubBlockType>
+size_t Multilevel<SubBlockType, devices::cpu>::map_mec_score() const
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, _reads), size_t(0),
+        [&](const tbb::blocked_range<size_t>& read_ids, size_t mec_score) -> size_t
+        {
+            for (size_t read_idx = read_ids.begin(); read_idx != read_ids.end(); ++read_idx) {
+                const auto& read_info     = _sub_block.read_info()[read_idx];
+                size_t      conflicts_one = 0, conflicts_two = 0;
+                for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+                    const auto value = _sub_block(read_idx, snp_idx);
+                    if (value <= 1) {
+                        conflicts_one += value != _haplo_one[snp_idx];
+                        conflicts_two += value != _haplo_two[snp_idx];
+                    }
+                }
+                mec_score += std::min(conflicts_one, conflicts_two);
+            }
+            return mec_score;
+        },
+        std::plus<size_t>()
+    );
+}
+
+template <typename SubBlockType>
+void Multilevel<SubBlockType, devices::cpu>::set_sub_block_haplotypes()
+{
+    for (size_t i = 0; i < _snps; ++i) {
+        _sub_block._haplo_one.set(i, _haplo_one[i]);
+        _sub_block._haplo_two.set(i, _haplo_two[i]);
+    }
+}
+
+}           // End namespace haplo
+#endif      // PARAHAPLO_MULTILEVEL_CPU_HPP
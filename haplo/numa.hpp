@@ -0,0 +1,276 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   numa.hpp
+/// @brief  Header file for the NUMA nodes which the data of a block is placed on and the sub-blocks are
+///         solved on, so that the threads of each node mostly read memory which is local to the node
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_NUMA_HPP
+#define PARAHAPLO_NUMA_HPP
+
+#include <tbb/tbb.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// If libnuma is used to place memory and bind threads (link with -lnuma), otherwise there is one node
+#ifndef NUMA_PLACEMENT
+    #define NUMA_PLACEMENT      0
+#endif
+
+#if NUMA_PLACEMENT && defined(__linux__)
+    #include <numa.h>
+    #include <numaif.h>
+    #include <sched.h>
+    #include <unistd.h>
+    #define NUMA_ENABLED        1
+#else
+    #define NUMA_ENABLED        0
+#endif
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      NumaObserver
+/// @brief      Binds each thread which enters the task arena of a node to the cpus of the node, and restores
+///             the affinity the thread had before when it leaves. The workers are shared by all arenas, so a
+///             worker mustn't stay bound to the node of the last arena it worked in
+// ----------------------------------------------------------------------------------------------------------
+class NumaObserver : public tbb::task_scheduler_observer {
+private:
+#if NUMA_ENABLED
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Affinity
+    /// @brief      The affinity a thread had before it entered the arena, if it was bound
+    // ------------------------------------------------------------------------------------------------------
+    struct Affinity {
+        cpu_set_t   cpus;                   //!< The cpus the thread could run on
+        bool        bound = false;          //!< If the thread was bound and its affinity must be restored
+    };
+
+    tbb::enumerable_thread_specific<Affinity>   _affinities;    //!< The affinity of each thread
+#endif
+    size_t                                      _node;          //!< The node to bind the threads to
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- starts observing the arena of a node
+    /// @param[in]  arena   The arena of the node
+    /// @param[in]  node    The node to bind the threads to
+    // ------------------------------------------------------------------------------------------------------
+    NumaObserver(tbb::task_arena& arena, const size_t node) 
+    : tbb::task_scheduler_observer(arena), _node(node) { observe(true); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Destructor -- stops observing the arena, so no thread is notified after it is destroyed
+    // ------------------------------------------------------------------------------------------------------
+    ~NumaObserver() { observe(false); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Saves the affinity of a thread which enters the arena and binds it to the node
+    // ------------------------------------------------------------------------------------------------------
+    void on_scheduler_entry(bool) override;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Restores the affinity of a thread which leaves the arena
+    // ------------------------------------------------------------------------------------------------------
+    void on_scheduler_exit(bool) override;
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      NumaNodes
+/// @brief      The NUMA nodes of the machine, with a task arena for each which has as many slots as the node
+///             has cpus (or an even share of a thread limit). The threads which work in a node's arena are
+///             bound to the cpus of the node while they are in it, and memory is moved to a node with mbind.
+///             Copies share the arenas. Without
+///             NUMA_PLACEMENT (or when the system has no NUMA support) nothing is moved or bound, which still
+///             lets the work be split as if there were more nodes
+// ----------------------------------------------------------------------------------------------------------
+class NumaNodes {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using arena_pointer         = std::shared_ptr<tbb::task_arena>;
+    using arena_container       = std::vector<arena_pointer>;
+    using observer_pointer      = std::shared_ptr<NumaObserver>;
+    using observer_container    = std::vector<observer_pointer>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t     NO_NODE     = static_cast<size_t>(-1);
+private:
+    arena_container     _arenas;            //!< The arena of each node
+    observer_container  _observers;         //!< The observer of each arena, destroyed before the arenas
+    std::vector<size_t> _slots;             //!< The number of slots of each arena
+    bool                _numa;              //!< If memory is placed and threads are bound with libnuma
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Default constructor -- finds the nodes of the system, one if there is no NUMA support
+    // ------------------------------------------------------------------------------------------------------
+    NumaNodes() : NumaNodes(system_nodes()) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the number of nodes, memory is only placed and threads only bound if
+    ///             the system has at least that many nodes
+    /// @param[in]  nodes   The number of nodes
+    /// @param[in]  threads The most threads of all the arenas together, 0 for the cpus of each node
+    // ------------------------------------------------------------------------------------------------------
+    explicit NumaNodes(const size_t nodes, const size_t threads = 0);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of nodes
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _arenas.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if memory is placed and threads are bound with libnuma
+    // ------------------------------------------------------------------------------------------------------
+    inline bool is_numa() const { return _numa; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of slots (threads) of the arena of a node
+    /// @param[in]  node    The node to get the slots of
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t slots(const size_t node) const { return _slots[node]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Executes a function in the arena of a node, every thread which runs its tasks (including
+    ///             the calling thread) is bound to the node while it's in the arena
+    /// @param[in]  node        The node to execute the function on
+    /// @param[in]  function    The function to execute
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    inline void execute(const size_t node, Function function) const { _arenas[node]->execute(function); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the pages which are completely within a range of memory to a node, and makes it the
+    ///             preferred node for the pages which aren't touched yet
+    /// @param[in]  address     The start of the memory
+    /// @param[in]  bytes       The number of bytes of the memory
+    /// @param[in]  node        The node to move the memory to
+    // ------------------------------------------------------------------------------------------------------
+    void place(const void* address, const size_t bytes, const size_t node) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the node which the page of an address is on, NO_NODE if it isn't known
+    /// @param[in]  address     The address to find the node of
+    // ------------------------------------------------------------------------------------------------------
+    size_t node_of(const void* address) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of nodes of the system, 1 if there is no NUMA support
+    // ------------------------------------------------------------------------------------------------------
+    static size_t system_nodes();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the node of the cpu which the calling thread is running on, 0 if there is no NUMA
+    ///             support and NO_NODE if it isn't known
+    // ------------------------------------------------------------------------------------------------------
+    static size_t current_node();
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+inline void NumaObserver::on_scheduler_entry(bool)
+{
+#if NUMA_ENABLED
+    // If the affinity can't be saved the thread isn't bound, since it couldn't be unbound
+    auto& affinity = _affinities.local();
+    affinity.bound = sched_getaffinity(0, sizeof(affinity.cpus), &affinity.cpus) == 0 &&
+                     numa_run_on_node(static_cast<int>(_node)) == 0;
+#endif
+}
+
+inline void NumaObserver::on_scheduler_exit(bool)
+{
+#if NUMA_ENABLED
+    auto& affinity = _affinities.local();
+    if (affinity.bound) sched_setaffinity(0, sizeof(affinity.cpus), &affinity.cpus);
+    affinity.bound = false;
+#endif
+}
+
+inline NumaNodes::NumaNodes(const size_t nodes, const size_t threads)
+: _arenas(std::max(nodes, size_t(1))), _slots(_arenas.size()),
+  _numa(NUMA_ENABLED && system_nodes() >= nodes && nodes > 1)
+{
+    // Each arena has a slot for each cpu of its node, or an even share of the cpus without NUMA support, and
+    // with a thread limit an even share of the threads
+    const size_t cpus = std::max(static_cast<size_t>(std::thread::hardware_concurrency()), size_t(1));
+    for (size_t node = 0; node < _arenas.size(); ++node) {
+        size_t slots = std::max(cpus / _arenas.size(), size_t(1));
+#if NUMA_ENABLED
+        if (_numa) {
+            struct bitmask* node_cpus = numa_allocate_cpumask();
+            if (numa_node_to_cpus(static_cast<int>(node), node_cpus) == 0)
+                slots = std::max(static_cast<size_t>(numa_bitmask_weight(node_cpus)), size_t(1));
+            numa_free_cpumask(node_cpus);
+        }
+#endif
+        if (threads > 0) slots = std::max(threads / _arenas.size(), size_t(1));
+        _slots[node]  = slots;
+        _arenas[node] = std::make_shared<tbb::task_arena>(static_cast<int>(slots));
+        if (_numa) _observers.push_back(std::make_shared<NumaObserver>(*_arenas[node], node));
+    }
+}
+
+inline void NumaNodes::place(const void* address, const size_t bytes, const size_t node) const
+{
+#if NUMA_ENABLED
+    if (!_numa || bytes == 0) return;
+
+    // Only the whole pages are moved, so that the memory either side isn't moved with them
+    const uintptr_t page  = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t start = (reinterpret_cast<uintptr_t>(address) + page - 1) / page * page;
+    const uintptr_t end   = (reinterpret_cast<uintptr_t>(address) + bytes) / page * page;
+    if (end <= start) return;
+
+    struct bitmask* nodes = numa_allocate_nodemask();
+    numa_bitmask_setbit(nodes, static_cast<unsigned int>(node));
+    mbind(reinterpret_cast<void*>(start), end - start, MPOL_PREFERRED, nodes->maskp, nodes->size + 1,
+          MPOL_MF_MOVE);
+    numa_free_nodemask(nodes);
+#else
+    (void)address; (void)bytes; (void)node;
+#endif
+}
+
+inline size_t NumaNodes::node_of(const void* address) const
+{
+#if NUMA_ENABLED
+    if (!_numa) return 0;
+    int node = -1;
+    if (get_mempolicy(&node, nullptr, 0, const_cast<void*>(address), MPOL_F_NODE | MPOL_F_ADDR) != 0)
+        return NO_NODE;
+    return node < 0 ? NO_NODE : static_cast<size_t>(node);
+#else
+    (void)address; return 0;
+#endif
+}
+
+inline size_t NumaNodes::system_nodes()
+{
+#if NUMA_ENABLED
+    if (numa_available() < 0) return 1;
+    return static_cast<size_t>(std::max(numa_num_configured_nodes(), 1));
+#else
+    return 1;
+#endif
+}
+
+inline size_t NumaNodes::current_node()
+{
+#if NUMA_ENABLED
+    if (numa_available() < 0) return 0;
+    const int cpu  = sched_getcpu();
+    const int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+    return node < 0 ? NO_NODE : static_cast<size_t>(node);
+#else
+    return 0;
+#endif
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_NUMA_HPP
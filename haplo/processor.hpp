@@ -13,6 +13,7 @@ namespace proc {
 static constexpr uint8_t row_dups           = 0x00;
 static constexpr uint8_t col_dups           = 0x01;
 static constexpr uint8_t col_rem_mono       = 0X02;
+static constexpr uint8_t row_clusters       = 0x03;
 
 }       // End namespace proc
 
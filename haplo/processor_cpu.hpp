@@ -5,12 +5,18 @@
 #ifndef PARAHAPLO_PROCESSOR_CPU_HPP
 #define PARAHAPLO_PROCESSOR_CPU_HPP
 
+#include "column_view.hpp"
 #include "devices.hpp"
 #include "operations.hpp"
 #include "processor.hpp"
 
 #include <tbb/tbb.h>
 
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
 namespace haplo {
 
 // ------------------------------------------------- ROWS : DUPLICATES  -------------------------------------
@@ -20,20 +26,23 @@ class Processor<FriendType, proc::row_dups, devices::cpu> {
 public:
     // ----------------------------------------------- ALIAS'S ----------------------------------------------
     using friend_type       = FriendType;
+    using hash_container    = std::vector<size_t>;
     // ------------------------------------------------------------------------------------------------------
 private:
-    friend_type& _friend;           //!< The friend class this class has access to to process
+    friend_type&    _friend;        //!< The friend class this class has access to to process
+    hash_container  _hashes;        //!< The hash of the calls of each row
     
 public:    
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Constructor -- sets the friend class to operate on
+    /// @brief      Constructor -- sets the friend class to operate on, and hashes the calls of its rows 
     /// @param[in]  friend_class    The class to do the processing for
     // ------------------------------------------------------------------------------------------------------
-    Processor(friend_type& friend_class) : _friend(friend_class) {}
+    Processor(friend_type& friend_class);
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Operator to invoke the processing on the friend class, the processing looks through all
-    ///             elements of two rows to check for equivalence
+    ///             elements of two rows to check for equivalence, the rows below are split between the 
+    ///             threads of the friend's concurrency
     /// @param      row_idx     The index of the column in the friend class to process
     // ------------------------------------------------------------------------------------------------------
     void operator()(const size_t row_idx);
@@ -42,51 +51,46 @@ private:
     /// @brief      Compares two columns, to check if they are equal and if they result in any node links
     /// @param[in]  row_idx_top     The index of the top row in the comparison
     /// @param[in]  row_idx_bot     The index of the bottom row in the comparison
-    /// @param[in]  threads_x       The number of threads that can be used to across the rows
     /// @return     If the columns are equal
     // ------------------------------------------------------------------------------------------------------
-    bool compare_rows(const size_t   row_idx_top     , 
-                      const size_t   row_idx_bot     , 
-                      const size_t   threads_x       ); 
+    bool compare_rows(const size_t row_idx_top, const size_t row_idx_bot) const; 
 };
   
 // --------------------------------------- IMPLEMENTATION ---------------------------------------------------
 
+template <typename FriendType>
+Processor<FriendType, proc::row_dups, devices::cpu>::Processor(friend_type& friend_class) 
+: _friend(friend_class), _hashes(friend_class._rows)
+{
+    // Rows with different hashes have different calls, so only rows with the same hash are compared
+    const auto planes = friend_class.allele_planes();
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _hashes.size()),
+        [&](const tbb::blocked_range<size_t>& rows)
+        {
+            for (size_t row_idx = rows.begin(); row_idx != rows.end(); ++row_idx) 
+                _hashes[row_idx] = planes.hash(row_idx);
+        }
+    );
+}
+
 template <typename FriendType>
 void Processor<FriendType, proc::row_dups, devices::cpu>::operator()(const size_t row_idx) 
 {
-    constexpr size_t THX = friend_type::THREADS_X; constexpr size_t THY = friend_type::THREADS_Y;
-    
-    const size_t threads_y = THY < (_friend._rows - row_idx - 1) 
-                           ? THY : (_friend._rows - row_idx - 1);
-    
     tbb::atomic<size_t> multiplicity{1};        // The number of rows equal to this row
     
+    // Each pair of this row and a row below it is compared by a single task
     tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, threads_y),
-        [&](const tbb::blocked_range<size_t>& thread_ids_y) 
+        tbb::blocked_range<size_t>(row_idx + 1, _friend._rows, _friend.concurrency().grain()),
+        [&](const tbb::blocked_range<size_t>& rows_bot) 
         {   
-            for (size_t thread_idy = thread_ids_y.begin(); thread_idy != thread_ids_y.end(); ++thread_idy) {
-                size_t thread_iters_y = ops::get_thread_iterations(thread_idy                   , 
-                                                                   _friend._rows - row_idx - 1 , 
-                                                                   threads_y                    ); 
-                
-                for (size_t it_y = 0; it_y < thread_iters_y; ++it_y) {
-                    size_t row_idx_bot = row_idx + it_y * threads_y + thread_idy + 1;
-                    
-                    // If the row below this is not a duplicate
-                    if (_friend._duplicate_rows.find(row_idx_bot) == _friend._duplicate_rows.end()) {
-                        // The number of threads that we can use to process the two columns
-                        const size_t threads_x = (THX / threads_y + (THX % threads_y)) < _friend._cols 
-                                               ? (THX / threads_y + (THX % threads_y)) : _friend._cols;
-                                                    
-                        // Check if the columns are duplicates (also determines link values)
-                        if (compare_rows(row_idx, row_idx_bot, threads_x) == true) {
-                            // Bot is a duplicate if this row
-                            _friend._duplicate_rows[row_idx_bot] = row_idx;
-                            ++multiplicity;
-                        }
-                    }
+            for (size_t row_idx_bot = rows_bot.begin(); row_idx_bot != rows_bot.end(); ++row_idx_bot) {
+                // If the row below this is not a duplicate, check if the rows are duplicates
+                if (_friend._duplicate_rows.find(row_idx_bot) == _friend._duplicate_rows.end() &&
+                    compare_rows(row_idx, row_idx_bot)) {
+                    // Bot is a duplicate if this row
+                    _friend._duplicate_rows[row_idx_bot] = row_idx;
+                    ++multiplicity;
                 }
             }
         }
@@ -97,55 +101,183 @@ void Processor<FriendType, proc::row_dups, devices::cpu>::operator()(const size_
 
 template <typename FriendType>
 bool Processor<FriendType, proc::row_dups, devices::cpu>::compare_rows(const size_t row_idx_top  ,
-                                                                       const size_t row_idx_bot  ,
-                                                                       const size_t threads_x    )
+                                                                       const size_t row_idx_bot  ) const
 {
-    tbb::atomic<bool> rows_equal{true};
-    
-    size_t start_col, end_col;
+    const auto read_top = _friend._read_info[row_idx_top];
+    const auto read_bot = _friend._read_info[row_idx_bot];
     
     // Look for early exit
-    if (_friend._read_info[row_idx_top].start_index() != _friend._read_info[row_idx_bot].start_index()) {
+    if (read_top.start_index() != read_bot.start_index() || read_top.end_index() != read_bot.end_index())
         return false;
-    } else { 
-        start_col = std::min(_friend._read_info[row_idx_top].start_index(),
-                             _friend._read_info[row_idx_bot].start_index());
+    
+    // The hashes cover all the columns, so they only rule out duplicates if no columns are skipped
+    if (_friend._duplicate_cols.empty() && _hashes[row_idx_top] != _hashes[row_idx_bot]) return false;
+
+    for (size_t col_idx = read_top.start_index(); col_idx <= read_top.end_index(); ++col_idx) {
+        // If the values at the column are different, and the column isn't a duplicate
+        if (_friend(row_idx_top, col_idx) != _friend(row_idx_bot, col_idx) &&
+            _friend._duplicate_cols.find(col_idx) == _friend._duplicate_cols.end()) return false;
     }
-    if (_friend._read_info[row_idx_top].end_index() != _friend._read_info[row_idx_bot].end_index()) {
-        return false;
-    } else { 
-        end_col = std::max(_friend._read_info[row_idx_top].end_index(),
-                           _friend._read_info[row_idx_bot].end_index());
-    }    
-    const size_t total_cols = end_col - start_col + 1;
+    return true;
+}
+
+// ------------------------------------------- ROWS : NEAR DUPLICATES --------------------------------------
 
+template <typename FriendType>
+class Processor<FriendType, proc::row_clusters, devices::cpu> {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using friend_type       = FriendType;
+    using index_container   = std::vector<size_t>;
+    using bucket_map        = std::unordered_map<size_t, index_container>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t NO_LEADER = static_cast<size_t>(-1);
+private:
+    friend_type& _friend;           //!< The friend class this class has access to to process
+    
+public:    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the friend class to operate on
+    /// @param[in]  friend_class    The class to do the processing for
+    // ------------------------------------------------------------------------------------------------------
+    Processor(friend_type& friend_class) : _friend(friend_class) {}
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Operator to invoke the processing on the friend class, which groups the rows with the same
+    ///             span that differ in at most max_distance elements. Each row joins the cluster of the first
+    ///             earlier leader (a row which started a cluster) it is close enough to. The span is split 
+    ///             into max_distance + 1 bands, so close enough rows have at least one equal band, and only 
+    ///             the leaders with an equal band (hashed into the same bucket) are compared
+    /// @param[in]  max_distance    The most elements a row can differ from its leader in
+    /// @return     The number of clusters
+    // ------------------------------------------------------------------------------------------------------
+    size_t operator()(const size_t max_distance);
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Hashes the elements of a row between two columns
+    /// @param[in]  row_idx     The index of the row
+    /// @param[in]  start_col   The first column to hash
+    /// @param[in]  end_col     The last column to hash
+    // ------------------------------------------------------------------------------------------------------
+    size_t hash_band(const size_t row_idx, const size_t start_col, const size_t end_col) const;
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Determines if two rows with the same span differ in at most max_distance elements
+    /// @param[in]  row_idx_top     The index of the top row in the comparison
+    /// @param[in]  row_idx_bot     The index of the bottom row in the comparison
+    /// @param[in]  max_distance    The most elements the rows can differ in
+    // ------------------------------------------------------------------------------------------------------
+    bool rows_close(const size_t row_idx_top, const size_t row_idx_bot, const size_t max_distance) const;
+};
+
+// --------------------------------------- IMPLEMENTATION ---------------------------------------------------
+
+template <typename FriendType>
+constexpr size_t Processor<FriendType, proc::row_clusters, devices::cpu>::NO_LEADER;
+
+template <typename FriendType>
+size_t Processor<FriendType, proc::row_clusters, devices::cpu>::operator()(const size_t max_distance)
+{
+    const size_t rows      = _friend._rows;
+    const auto&  read_info = _friend._read_info;
+    
+    // Group the rows by their span -- only rows with the same span are compared
+    index_container order(rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), 
+        [&](const size_t a, const size_t b) 
+        {
+            return read_info[a].start_index() != read_info[b].start_index() 
+                 ? read_info[a].start_index() <  read_info[b].start_index()
+                 : read_info[a].end_index()   != read_info[b].end_index()
+                 ? read_info[a].end_index()   <  read_info[b].end_index() : a < b;
+        }
+    );
+    index_container group_offsets(1, 0);
+    for (size_t i = 1; i <= rows; ++i) {
+        if (i == rows || read_info[order[i]].start_index() != read_info[order[i - 1]].start_index() ||
+                         read_info[order[i]].end_index()   != read_info[order[i - 1]].end_index()    )
+            group_offsets.push_back(i);
+    }
+    if (rows == 0) group_offsets.resize(1);
+    
+    index_container leaders(rows, NO_LEADER);
     tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, threads_x),
-        [&](const tbb::blocked_range<size_t>& thread_ids_x) 
-        {   
-            for (size_t thread_idx = thread_ids_x.begin(); thread_idx != thread_ids_x.end(); ++thread_idx) {
-                size_t thread_iters_x = ops::get_thread_iterations(thread_idx, total_cols, threads_x); 
+        tbb::blocked_range<size_t>(0, group_offsets.size() - 1),
+        [&](const tbb::blocked_range<size_t>& group_ids)
+        {
+            for (size_t group_idx = group_ids.begin(); group_idx != group_ids.end(); ++group_idx) {
+                const auto&  span   = read_info[order[group_offsets[group_idx]]];
+                const size_t length = span.end_index() - span.start_index() + 1;
+                const size_t bands  = std::min(max_distance + 1, length);
                 
-                for (size_t it_x = 0; it_x < thread_iters_x && rows_equal; ++it_x) {
-                    size_t col_idx = it_x * threads_x + thread_idx + start_col;
-                   
-                    // If the columns aren't duplicates
-                    if (_friend._duplicate_cols.find(col_idx) == _friend._duplicate_cols.end()) {
-                        // If the values at these two positions are equivalent
-                        auto value_top = _friend(row_idx_top, col_idx);
-                        auto value_bot = _friend(row_idx_bot, col_idx);
-                        
-                        // Check that that all threads terminate here and that it is not a source of error
-                        if (value_top != value_bot) {
-                            rows_equal = false;
-                            break;
+                std::vector<bucket_map> buckets(bands);
+                index_container         hashes(bands);
+                for (size_t i = group_offsets[group_idx]; i < group_offsets[group_idx + 1]; ++i) {
+                    const size_t row_idx = order[i];
+                    for (size_t band = 0; band < bands; ++band) {
+                        hashes[band] = hash_band(row_idx, span.start_index() + band * length / bands,
+                                                 span.start_index() + (band + 1) * length / bands - 1);
+                    }
+                    
+                    // The earliest leader which is close enough, from any band bucket
+                    for (size_t band = 0; band < bands; ++band) {
+                        const auto bucket = buckets[band].find(hashes[band]);
+                        if (bucket == buckets[band].end()) continue;
+                        for (const auto leader : bucket->second) {
+                            if (leader < leaders[row_idx] && rows_close(leader, row_idx, max_distance))
+                                leaders[row_idx] = leader;
                         }
                     }
+                    if (leaders[row_idx] != NO_LEADER) continue;
+                    
+                    leaders[row_idx] = row_idx;
+                    for (size_t band = 0; band < bands; ++band) 
+                        buckets[band][hashes[band]].push_back(row_idx);
                 }
             }
         }
     );
-    return static_cast<bool>(rows_equal); 
+    
+    // Number the clusters in the order of their leaders
+    _friend._read_clusters.resize(rows);
+    _friend._num_clusters = 0;
+    for (size_t row_idx = 0; row_idx < rows; ++row_idx) {
+        _friend._read_clusters[row_idx] = leaders[row_idx] == row_idx 
+                                        ? _friend._num_clusters++ : _friend._read_clusters[leaders[row_idx]];
+    }
+    return _friend._num_clusters;
+}
+
+template <typename FriendType>
+size_t Processor<FriendType, proc::row_clusters, devices::cpu>::hash_band(const size_t row_idx  ,
+                                                                         const size_t start_col,
+                                                                         const size_t end_col  ) const
+{
+    constexpr size_t elements_per_word = friend_type::data_container::elements_per_word;
+    
+    // FNV-1a over the words of the 2 bit elements
+    const auto&  read_info = _friend._read_info[row_idx];
+    const size_t start     = read_info.offset() + start_col - read_info.start_index();
+    const size_t length    = end_col - start_col + 1;
+    size_t       hash      = 14695981039346656037ULL;
+    for (size_t hashed = 0; hashed < length; hashed += elements_per_word) {
+        hash ^= _friend._data.get_range(start + hashed, std::min(elements_per_word, length - hashed));
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename FriendType>
+bool Processor<FriendType, proc::row_clusters, devices::cpu>::rows_close(const size_t row_idx_top ,
+                                                                         const size_t row_idx_bot ,
+                                                                         const size_t max_distance) const
+{
+    // The rows have the same span, so their elements can be compared a word at a time
+    const auto& read_info_top = _friend._read_info[row_idx_top];
+    const auto& read_info_bot = _friend._read_info[row_idx_bot];
+    return _friend._data.compare_span(_friend._data, read_info_top.offset(), read_info_bot.offset(), 
+                                      read_info_top.length()) <= max_distance;
 }
 
 // ------------------------------- COLUMNS : DUPLICATES AND NODE LINKS  -------------------------------------
@@ -154,18 +286,25 @@ template <typename FriendType>
 class Processor<FriendType, proc::col_dups, devices::cpu> {
 public:
     // ----------------------------------------------- ALIAS'S ----------------------------------------------
-    using friend_type   = FriendType;
+    using friend_type       = FriendType;
+    using mask_container    = ColumnView::mask_container;
     // ------------------------------------------------------------------------------------------------------
 private:
-    friend_type&     _friend;           //!< The friend class this class has access to to process
+    friend_type&        _friend;        //!< The friend class this class has access to to process
+    const ColumnView&   _columns;       //!< The column major data of the friend class
+    mask_container      _rows;          //!< The lane mask of the rows which aren't duplicates
     
 public:    
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Contructor -- sets the friend class to operate on
+    /// @brief      Contructor -- sets the friend class to operate on, and builds its column major data
     /// @param[in]  friend_class    The class to do the processing for
-    /// @param[in]  tree            The tree to initialize
     // ------------------------------------------------------------------------------------------------------
-    Processor(friend_type& friend_class) : _friend(friend_class) {}
+    Processor(friend_type& friend_class) 
+    : _friend(friend_class), _columns(friend_class.columns()),
+      _rows(ColumnView::lane_mask(friend_class._rows, [&](const size_t row_idx) 
+            { 
+                return friend_class._duplicate_rows.find(row_idx) == friend_class._duplicate_rows.end(); 
+            })) {}
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Operator to invoke the processing on the friend class, the processing looks through all
@@ -175,15 +314,15 @@ public:
     void operator()(const size_t col_idx);
 private:
     // ------------------------------------------------------------------------------------------------------
-    /// @brief      Compares two columns, to check if they are equal and if they result in any node links
+    /// @brief      Compares two columns, a word of rows at a time, ignoring the duplicate rows
     /// @param[in]  col_idx_left    The index of the left column
     /// @param[in]  col_idx_right   The index of the right column 
-    /// @param[in]  threads_y       The number of threads that can be used to look down the columns
     /// @return     If the columns are equal
     // ------------------------------------------------------------------------------------------------------
-    bool compare_columns(const size_t   col_idx_left    , 
-                         const size_t   col_idx_right   , 
-                         const size_t   threads_y       );      
+    inline bool compare_columns(const size_t col_idx_left, const size_t col_idx_right) const
+    {
+        return _columns.equal(col_idx_left, col_idx_right, _rows);
+    }
 };
 
 // ---------------------------------------- IMPEMENTATION ---------------------------------------------------
@@ -191,89 +330,21 @@ private:
 template <typename FriendType>
 void Processor<FriendType, proc::col_dups, devices::cpu>::operator()(const size_t col_idx)
 {
-    constexpr size_t THX = friend_type::THREADS_X; constexpr size_t THY = friend_type::THREADS_Y;
-    
-    const size_t threads_x = THX < (_friend._cols - col_idx - 1) 
-                           ? THX : (_friend._cols - col_idx - 1);
-    
-    tbb::atomic<size_t> multiplicity{1};        // The number of columns equal tothis column
-    
-    tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, threads_x),
-        [&](const tbb::blocked_range<size_t>& thread_ids_x) 
-        {   
-            for (size_t thread_idx = thread_ids_x.begin(); thread_idx != thread_ids_x.end(); ++thread_idx) {
-                size_t thread_iters_x = ops::get_thread_iterations(thread_idx                   , 
-                                                                   _friend._cols - col_idx - 1 , 
-                                                                   threads_x                    ); 
-                
-                for (size_t it_x = 0; it_x < thread_iters_x; ++it_x) {
-                    size_t col_idx_right = col_idx + it_x * threads_x + thread_idx + 1;
-                    
-                    // If the column to the right is not a duplicate
-                    if (_friend._duplicate_cols.find(col_idx_right) == _friend._duplicate_cols.end()) {
-                        // The number of threads that we can use to process the two columns
-                        const size_t threads_y = (THY / threads_x + (THY % threads_x)) < _friend._rows 
-                                               ? (THY / threads_x + (THY % threads_x)) : _friend._rows;
-                                               
-                        // Check if the columns are duplicates
-                        if (compare_columns(col_idx, col_idx_right, threads_y) == true) {
-                            // Right is a duplicate of col_idx
-                            _friend._duplicate_cols[col_idx_right] = col_idx;
-                            ++multiplicity;
-                        }
-                    }
-                }
-            }
-        }
-    );
-}
-
-template <typename FriendType>
-bool Processor<FriendType, proc::col_dups, devices::cpu>::compare_columns(const size_t col_idx_left   ,   
-                                                                          const size_t col_idx_right  ,
-                                                                          const size_t threads_y      )
-{
-    tbb::atomic<bool> cols_equal{true};
-    
-    // Find the start row for the comparison 
-    size_t start_row = std::min(_friend._snp_info[col_idx_left].start_index(),
-                                _friend._snp_info[col_idx_right].start_index());
-    
-    // Find the end row for the comparison
-    size_t end_row = std::max(_friend._snp_info[col_idx_left].end_index(),
-                              _friend._snp_info[col_idx_right].end_index());
-
-    // Should add early exit now that the tree is gone 
-    const size_t total_rows = end_row - start_row + 1;
-    const size_t threads    = threads_y > total_rows ? total_rows : threads_y;
-    
+    // Each pair of this column and a column to the right of it is compared by a single task
     tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, threads),
-        [&](const tbb::blocked_range<size_t>& thread_ids) 
+        tbb::blocked_range<size_t>(col_idx + 1, _friend._cols, _friend.concurrency().grain()),
+        [&](const tbb::blocked_range<size_t>& cols_right) 
         {   
-            for (size_t thread_id = thread_ids.begin(); thread_id != thread_ids.end(); ++thread_id) {
-                size_t thread_iters = ops::get_thread_iterations(thread_id, total_rows, threads); 
-              
-                for (size_t it = 0; it < thread_iters; ++it) {
-                    size_t row_idx = it * threads + thread_id + start_row;
-                    
-                    // If the rows aren't duplicates
-                    if (_friend._duplicate_rows.find(row_idx) == _friend._duplicate_rows.end()) {
-                        // If the values at these two positions are equivalent
-                        auto value_left   = _friend(row_idx, col_idx_left);
-                        auto value_right  = _friend(row_idx, col_idx_right);
-                        
-                        if (value_left != value_right) {
-                            //  Definitely can't be a duplicate 
-                            cols_equal = false;
-                        }
-                    }
+            for (size_t col_right = cols_right.begin(); col_right != cols_right.end(); ++col_right) {
+                // If the column to the right is not a duplicate, check if the columns are duplicates
+                if (_friend._duplicate_cols.find(col_right) == _friend._duplicate_cols.end() &&
+                    compare_columns(col_idx, col_right)) {
+                    // Right is a duplicate of col_idx
+                    _friend._duplicate_cols[col_right] = col_idx;
                 }
             }
         }
     );
-    return static_cast<bool>(cols_equal);
 }
 
 }               // End namespace haplo
@@ -0,0 +1,141 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   rank_select.hpp
+/// @brief  Header file for a bitvector with constant time rank and fast select, used to map the columns of
+///         a block to the columns left after removing the monotone columns and back
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_RANK_SELECT_HPP
+#define PARAHAPLO_RANK_SELECT_HPP
+
+#include <tbb/tbb.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      RankSelect
+/// @brief      Holds a bitvector in 64 bit words (bit i is bit i % 64 of word i / 64), with the number of set
+///             bits before each word, so rank is a lookup and a popcount, and the word of every 64th set bit,
+///             so select only searches the words between two samples. Once built the bitvector can't change
+// ----------------------------------------------------------------------------------------------------------
+class RankSelect {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_type         = uint64_t;
+    using word_container    = std::vector<word_type>;
+    using rank_container    = std::vector<uint32_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t bits_per_word   = 64;
+    static constexpr size_t select_sample   = 64;       //!< The number of set bits between select samples
+private:
+    word_container      _words;             //!< The bits
+    rank_container      _ranks;             //!< The number of set bits before each word, and in total
+    rank_container      _samples;           //!< The word of each select_sample-th set bit
+    size_t              _size;              //!< The number of bits
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Default constructor -- an empty bitvector
+    // ------------------------------------------------------------------------------------------------------
+    RankSelect() : _ranks(1, 0), _size(0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sets the bits which a predicate is true for, a word per task in parallel
+    /// @param[in]  size        The number of bits
+    /// @param[in]  predicate   The predicate, which takes the index of a bit
+    /// @tparam     Predicate   The type of the predicate
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Predicate>
+    RankSelect(const size_t size, Predicate predicate);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of bits
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _size; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of set bits
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t count() const { return _ranks.back(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of a bit
+    /// @param[in]  i   The index of the bit
+    // ------------------------------------------------------------------------------------------------------
+    inline bool get(const size_t i) const { return (_words[i / bits_per_word] >> (i % bits_per_word)) & 1; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of set bits before a bit
+    /// @param[in]  i   The index of the bit, which can be the size of the bitvector
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t rank(const size_t i) const
+    {
+        const size_t bit = i % bits_per_word;
+        return _ranks[i / bits_per_word]
+             + (bit == 0 ? 0 : __builtin_popcountll(_words[i / bits_per_word] << (bits_per_word - bit)));
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the index of a set bit
+    /// @param[in]  k   The number of set bits before the bit, which must be less than count()
+    // ------------------------------------------------------------------------------------------------------
+    size_t select(const size_t k) const;
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <typename Predicate>
+RankSelect::RankSelect(const size_t size, Predicate predicate)
+: _words(size / bits_per_word + 1, 0), _ranks(size / bits_per_word + 2, 0), _size(size)
+{
+    const size_t words = _words.size();
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, words), [&](const tbb::blocked_range<size_t>& word_ids)
+    {
+        for (size_t w = word_ids.begin(); w != word_ids.end(); ++w) {
+            const size_t end = std::min(size, (w + 1) * bits_per_word);
+            for (size_t i = w * bits_per_word; i < end; ++i)
+                if (predicate(i)) _words[w] |= word_type(1) << (i % bits_per_word);
+        }
+    });
+
+    // The ranks are an exclusive prefix sum of the counts of the words
+    tbb::parallel_scan(tbb::blocked_range<size_t>(0, words), uint32_t(0),
+        [&](const tbb::blocked_range<size_t>& word_ids, uint32_t rank, const bool is_final)
+        {
+            for (size_t w = word_ids.begin(); w != word_ids.end(); ++w) {
+                rank += __builtin_popcountll(_words[w]);
+                if (is_final) _ranks[w + 1] = rank;
+            }
+            return rank;
+        },
+        [](const uint32_t left, const uint32_t right) { return left + right; }
+    );
+
+    // Each sample is in the first word whose following rank passes it
+    _samples.resize((count() + select_sample - 1) / select_sample);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, _samples.size()), [&](const tbb::blocked_range<size_t>& ks)
+    {
+        for (size_t k = ks.begin(); k != ks.end(); ++k)
+            _samples[k] = std::upper_bound(_ranks.begin(), _ranks.end(), k * select_sample) - _ranks.begin() - 1;
+    });
+}
+
+inline size_t RankSelect::select(const size_t k) const
+{
+    // The word is between the samples before and after k
+    const size_t sample = k / select_sample;
+    const auto   first  = _ranks.begin() + _samples[sample];
+    const auto   last   = sample + 1 < _samples.size() ? _ranks.begin() + _samples[sample + 1] + 1
+                                                        : _ranks.end() - 1;
+    const size_t w      = std::upper_bound(first, last, k) - _ranks.begin() - 1;
+
+    // Clear the set bits of the word before the bit
+    word_type word = _words[w];
+    for (size_t i = _ranks[w]; i < k; ++i) word &= word - 1;
+    return w * bits_per_word + __builtin_ctzll(word);
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_RANK_SELECT_HPP
@@ -0,0 +1,204 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   read_index.hpp
+/// @brief  Header file for the interval index over the reads of a block, which finds the reads which cover
+///         a column (or a range of columns) without scanning all the rows between the first and last row
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_READ_INDEX_HPP
+#define PARAHAPLO_READ_INDEX_HPP
+
+#include "arena.hpp"
+
+#include <tbb/tbb.h>
+#include <tbb/parallel_sort.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ReadIndex
+/// @brief      Holds the reads sorted by their start index, with the maximum end index of all the reads up to
+///             each position. The maximum ends are non decreasing, so the reads which can cover a column are
+///             between the first position whose maximum end reaches the column and the last read which
+///             starts at or before the column, and only those are checked
+// ----------------------------------------------------------------------------------------------------------
+class ReadIndex {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using index_type        = uint32_t;
+    using index_container   = std::vector<index_type, ArenaAllocator<index_type>>;
+    using row_container     = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+private:
+    index_container     _rows;              //!< The index of the read at each sorted position
+    index_container     _starts;            //!< The start index of the read at each sorted position
+    index_container     _ends;              //!< The end index of the read at each sorted position
+    index_container     _max_ends;          //!< The maximum end index of the reads up to each sorted position
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Default constructor -- an index without any reads
+    // ------------------------------------------------------------------------------------------------------
+    ReadIndex() {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- sorts the reads by start index and finds the maximum ends in parallel
+    /// @param[in]  read_info   The information for each read
+    /// @param[in]  reads       The number of reads
+    /// @tparam     InfoType    The type of the read information container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename InfoType>
+    ReadIndex(const InfoType& read_info, const size_t reads);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of reads in the index
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _rows.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the index of each read which has an element in a range of columns,
+    ///             in the order of the start indices of the reads
+    /// @param[in]  start_col   The first column of the range
+    /// @param[in]  end_col     The last column of the range
+    /// @param[in]  function    The function to call, which takes the index of a read
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    void for_each_overlapping(const size_t start_col, const size_t end_col, Function function) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the index of each read which covers a column
+    /// @param[in]  col_idx     The index of the column
+    /// @param[in]  function    The function to call, which takes the index of a read
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    inline void for_each_covering(const size_t col_idx, Function function) const
+    {
+        for_each_overlapping(col_idx, col_idx, function);
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function for each column of a range with each read which covers the column, with
+    ///             the columns processed in parallel, and the reads of a column by the same task
+    /// @param[in]  start_col   The first column of the range
+    /// @param[in]  end_col     The last column of the range
+    /// @param[in]  function    The function to call, which takes the index of a column and of a read
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    void for_each_covering(const size_t start_col, const size_t end_col, Function function) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the indices of the reads which are within a range of columns, in ascending order
+    /// @param[in]  start_col   The first column of the range
+    /// @param[in]  end_col     The last column of the range
+    // ------------------------------------------------------------------------------------------------------
+    row_container within(const size_t start_col, const size_t end_col) const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if any read spans a column (starts before it and ends after it)
+    /// @param[in]  col_idx     The index of the column
+    // ------------------------------------------------------------------------------------------------------
+    inline bool is_spanned(const size_t col_idx) const
+    {
+        const size_t before = std::lower_bound(_starts.begin(), _starts.end(), col_idx) - _starts.begin();
+        return before > 0 && _max_ends[before - 1] > col_idx;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of reads which cover each column of a range, found in parallel
+    /// @param[in]  start_col   The first column of the range
+    /// @param[in]  end_col     The last column of the range
+    // ------------------------------------------------------------------------------------------------------
+    row_container coverage(const size_t start_col, const size_t end_col) const;
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <typename InfoType>
+ReadIndex::ReadIndex(const InfoType& read_info, const size_t reads)
+: _rows(reads), _starts(reads), _ends(reads), _max_ends(reads)
+{
+    // Sort the reads by start index, and by index for the same start, so that ties keep the row order
+    for (size_t row_idx = 0; row_idx < reads; ++row_idx) _rows[row_idx] = index_type(row_idx);
+    tbb::parallel_sort(_rows.begin(), _rows.end(), [&](const index_type left, const index_type right)
+    {
+        const size_t start_left = read_info[left].start_index(), start_right = read_info[right].start_index();
+        return start_left < start_right || (start_left == start_right && left < right);
+    });
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, reads), [&](const tbb::blocked_range<size_t>& positions)
+    {
+        for (size_t i = positions.begin(); i != positions.end(); ++i) {
+            const auto read = read_info[_rows[i]];
+            _starts[i] = index_type(read.start_index()); _ends[i] = index_type(read.end_index());
+        }
+    });
+
+    // The maximum ends are a prefix scan of the ends with max
+    tbb::parallel_scan(tbb::blocked_range<size_t>(0, reads), index_type(0),
+        [&](const tbb::blocked_range<size_t>& positions, index_type max_end, const bool is_final)
+        {
+            for (size_t i = positions.begin(); i != positions.end(); ++i) {
+                max_end = std::max(max_end, _ends[i]);
+                if (is_final) _max_ends[i] = max_end;
+            }
+            return max_end;
+        },
+        [](const index_type left, const index_type right) { return std::max(left, right); }
+    );
+}
+
+template <typename Function>
+void ReadIndex::for_each_overlapping(const size_t start_col, const size_t end_col, Function function) const
+{
+    // All the reads before first end before the range, and all those from last start after it
+    const size_t first = std::lower_bound(_max_ends.begin(), _max_ends.end(), start_col) - _max_ends.begin();
+    const size_t last  = std::upper_bound(_starts.begin()  , _starts.end()  , end_col  ) - _starts.begin();
+    for (size_t i = first; i < last; ++i)
+        if (_ends[i] >= start_col) function(size_t(_rows[i]));
+}
+
+template <typename Function>
+void ReadIndex::for_each_covering(const size_t start_col, const size_t end_col, Function function) const
+{
+    if (start_col > end_col) return;
+    tbb::parallel_for(tbb::blocked_range<size_t>(start_col, end_col + 1),
+        [&](const tbb::blocked_range<size_t>& cols)
+        {
+            for (size_t col_idx = cols.begin(); col_idx != cols.end(); ++col_idx)
+                for_each_covering(col_idx, [&](const size_t row_idx) { function(col_idx, row_idx); });
+        }
+    );
+}
+
+inline ReadIndex::row_container ReadIndex::within(const size_t start_col, const size_t end_col) const
+{
+    row_container rows;
+    const size_t first = std::lower_bound(_starts.begin(), _starts.end(), start_col) - _starts.begin();
+    const size_t last  = std::upper_bound(_starts.begin(), _starts.end(), end_col  ) - _starts.begin();
+    for (size_t i = first; i < last; ++i)
+        if (_ends[i] <= end_col) rows.push_back(_rows[i]);
+
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+inline ReadIndex::row_container ReadIndex::coverage(const size_t start_col, const size_t end_col) const
+{
+    row_container counts(start_col <= end_col ? end_col - start_col + 1 : 0, 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, counts.size()),
+        [&](const tbb::blocked_range<size_t>& cols)
+        {
+            for (size_t i = cols.begin(); i != cols.end(); ++i)
+                for_each_covering(start_col + i, [&](const size_t) { ++counts[i]; });
+        }
+    );
+    return counts;
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_READ_INDEX_HPP
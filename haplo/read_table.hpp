@@ -0,0 +1,169 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   read_table.hpp
+/// @brief  Header file for the compact table of read information for the parahaplo library
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_READ_TABLE_HPP
+#define PARAHAPLO_READ_TABLE_HPP
+
+#include "arena.hpp"
+#include "read_info.h"
+
+#include <thrust/host_vector.h>
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      ReadTable
+/// @brief      Holds the information for each read as a struct of arrays -- 32 bit start and end indices and
+///             an offset of OffsetType -- rather than an array of ReadInfo with 3 size_t fields, so each read
+///             takes 12 bytes instead of 24 with 32 bit offsets, and scanning one field of many reads only
+///             touches that field. Indexing gives an object with the same accessors as ReadInfo. The fields
+///             are allocated from the current arena of the thread which creates the table, if it has one
+/// @tparam     OffsetType  The type of the offsets of the reads in the data
+// ----------------------------------------------------------------------------------------------------------
+template <typename OffsetType = uint32_t>
+class ReadTable {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using index_type        = uint32_t;
+    using offset_type       = OffsetType;
+    using index_container   = std::vector<index_type, ArenaAllocator<index_type>>;
+    using offset_container  = std::vector<offset_type, ArenaAllocator<offset_type>>;
+    // ------------------------------------------------------------------------------------------------------
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @class      Reference
+    /// @brief      The information of a read in the table, which can be changed through the same accessors
+    ///             as ReadInfo
+    // ------------------------------------------------------------------------------------------------------
+    class Reference {
+    private:
+        ReadTable*  _table;         //!< The table the read is in
+        size_t      _idx;           //!< The index of the read in the table
+    public:
+        Reference(ReadTable* table, const size_t idx) : _table(table), _idx(idx) {}
+
+        inline size_t start_index() const { return _table->_starts[_idx];  }
+        inline size_t end_index()   const { return _table->_ends[_idx];    }
+        inline size_t offset()      const { return _table->_offsets[_idx]; }
+        inline size_t length()      const { return end_index() - start_index() + 1; }
+
+        inline bool element_exists(const size_t index) const
+        {
+            return index >= start_index() && index <= end_index();
+        }
+
+        inline void set_start_index(const size_t value) { _table->_starts[_idx] = index_type(value); }
+        inline void set_end_index(const size_t value)   { _table->_ends[_idx]   = index_type(value); }
+
+        inline operator ReadInfo() const { return ReadInfo(_idx, start_index(), end_index(), offset()); }
+    };
+private:
+    index_container     _starts;            //!< The start index of each read
+    index_container     _ends;              //!< The end index of each read
+    offset_container    _offsets;           //!< The offset of each read in the data
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- creates the table with a number of empty reads
+    /// @param[in]  reads   The number of reads
+    // ------------------------------------------------------------------------------------------------------
+    explicit ReadTable(const size_t reads = 0) : _starts(reads, 0), _ends(reads, 0), _offsets(reads, 0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the information of a read
+    /// @param[in]  i   The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline ReadInfo operator[](const size_t i) const 
+    { 
+        return ReadInfo(i, _starts[i], _ends[i], _offsets[i]); 
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the information of a read, which can be changed
+    /// @param[in]  i   The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline Reference operator[](const size_t i) { return Reference(this, i); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds a read to the end of the table
+    /// @param[in]  read_info   The information of the read
+    /// @throw      std::overflow_error if the offset of the read doesn't fit in the offset type
+    // ------------------------------------------------------------------------------------------------------
+    inline void push_back(const ReadInfo& read_info)
+    {
+        if (read_info.offset() > std::numeric_limits<offset_type>::max()) {
+            throw std::overflow_error("Read offset too large for the read table's offset type");
+        }
+        _starts.push_back(static_cast<index_type>(read_info.start_index()));
+        _ends.push_back(static_cast<index_type>(read_info.end_index()));
+        _offsets.push_back(static_cast<offset_type>(read_info.offset()));
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes the last read of the table
+    // ------------------------------------------------------------------------------------------------------
+    inline void pop_back() { _starts.pop_back(); _ends.pop_back(); _offsets.pop_back(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes all the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline void clear() { _starts.clear(); _ends.clear(); _offsets.clear(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Reserves space for a number of reads
+    /// @param[in]  reads   The number of reads to reserve space for
+    // ------------------------------------------------------------------------------------------------------
+    inline void reserve(const size_t reads) 
+    { 
+        _starts.reserve(reads); _ends.reserve(reads); _offsets.reserve(reads); 
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _starts.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Returns true if there are no reads
+    // ------------------------------------------------------------------------------------------------------
+    inline bool empty() const { return _starts.empty(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the start indices of all the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline const index_container& start_indices() const { return _starts; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the end indices of all the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline const index_container& end_indices() const { return _ends; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the offsets of all the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline const offset_container& offsets() const { return _offsets; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the memory used by the table, in bytes
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t bytes() const { return size() * (2 * sizeof(index_type) + sizeof(offset_type)); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Converts the table to an array of ReadInfo, for copying to the device
+    // ------------------------------------------------------------------------------------------------------
+    thrust::host_vector<ReadInfo> to_read_info() const
+    {
+        thrust::host_vector<ReadInfo> read_info(size());
+        for (size_t i = 0; i < size(); ++i) read_info[i] = operator[](i);
+        return read_info;
+    }
+};
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_READ_TABLE_HPP
@@ -8,13 +8,20 @@
 #ifndef PARAHAPLO_SMALL_CONTAINERS_H
 #define PARAHAPLO_SMALL_CONTAINERS_H
 
+#include "arena.hpp"
 #include "cuda_defs.h"
 
-#include <iostream>
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <cstdint>
+#include <iostream>
 #include <limits>
 #include <vector>
 #include <nppdefs.h>
+#ifdef __BMI2__
+    #include <immintrin.h>
+#endif
 #include <thrust/host_vector.h>
 
 namespace haplo {
@@ -230,6 +237,50 @@ public:
         }
     }
     
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes all the elements which are set in a bitmap, moving each kept element only once
+    /// @param[in]  drop    The bitmap of the elements to remove (1 to remove), with get(i) for element i
+    /// @tparam     BitmapType  The type of the bitmap
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BitmapType>
+    inline void remove_elements(const BitmapType& drop) 
+    {
+        compact([&](const size_t i) { return drop.get(i) == 1; });
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes the elements at a sorted list of indices, moving each kept element only once
+    /// @param[in]  indices     The indices of the elements to remove, in ascending order
+    // ------------------------------------------------------------------------------------------------------
+    inline void remove_elements(const std::vector<size_t>& indices) 
+    {
+        size_t next = 0;
+        compact([&](const size_t i) 
+        { 
+            while (next < indices.size() && indices[next] < i) ++next;
+            return next < indices.size() && indices[next] == i;
+        });
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the kept elements to the front in a single pass, and clears the ones after them
+    /// @param[in]  dropped     Returns true if the element at an index must be removed
+    /// @tparam     DropFunction    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename DropFunction>
+    inline void compact(DropFunction dropped)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < _num_elements; ++i) {
+            if (dropped(i)) continue;
+            if (kept != i) set(kept, get(i));
+            ++kept;
+        }
+        for (size_t i = kept; i < _num_elements; ++i) set(i, 0);
+        _num_elements = kept;
+    }
+public:
+    
     void print() 
     {
         for (int i = 0; i < bins + 1; ++i)
@@ -350,6 +401,53 @@ public:
         }
     }
     
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes all the elements which are set in a bitmap, moving each kept element only once
+    /// @param[in]  drop    The bitmap of the elements to remove (1 to remove), with get(i) for element i
+    /// @tparam     BitmapType  The type of the bitmap
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BitmapType>
+    CUDA_H
+    inline void remove_elements(const BitmapType& drop) 
+    {
+        compact([&](const size_t i) { return drop.get(i) == 1; });
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes the elements at a sorted list of indices, moving each kept element only once
+    /// @param[in]  indices     The indices of the elements to remove, in ascending order
+    // ------------------------------------------------------------------------------------------------------
+    CUDA_H
+    inline void remove_elements(const std::vector<size_t>& indices) 
+    {
+        size_t next = 0;
+        compact([&](const size_t i) 
+        { 
+            while (next < indices.size() && indices[next] < i) ++next;
+            return next < indices.size() && indices[next] == i;
+        });
+    }
+private:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the kept elements to the front in a single pass, and clears the ones after them
+    /// @param[in]  dropped     Returns true if the element at an index must be removed
+    /// @tparam     DropFunction    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename DropFunction>
+    CUDA_H
+    inline void compact(DropFunction dropped)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < _num_elements; ++i) {
+            if (dropped(i)) continue;
+            if (kept != i) set(kept, get(i));
+            ++kept;
+        }
+        for (size_t i = kept; i < _num_elements; ++i) set(i, 0);
+        _num_elements = kept;
+    }
+public:
+    
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Adds an element to the back of the vector
     /// @param[in]  value     The element to add to the back of the vector
@@ -378,6 +476,427 @@ public:
     }
 };
 
+// ----------------------------------------------------------------------------------------------------------
+/// @class      WordContainer
+/// @brief      Contianer for elements of 1 or 2 bits which are packed big endian into 64 bit words, so that a
+///             span of elements can be read, written, copied or compared a word at a time rather than an
+///             element at a time. The words can be stored in a fixed array or a vector
+/// @tparam     BitsPerElement  The number of bits per element, 1 or 2
+/// @tparam     WordStorage     The container which holds the words
+// ----------------------------------------------------------------------------------------------------------
+template <byte BitsPerElement, typename WordStorage>
+class WordContainer {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_type             = uint64_t;
+    using standard_container    = thrust::host_vector<uint8_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t bits_per_word       = sizeof(word_type) * 8;
+    static constexpr size_t elements_per_word   = bits_per_word / BitsPerElement;
+    static constexpr size_t element_mask        = (1 << BitsPerElement) - 1;
+protected:
+    WordStorage             _words;             //!< The words holding the elements
+    size_t                  _num_elements;      //!< Number of elements in the container
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor to take the storage and the number of elements
+    /// @param[in]  words           The storage for the words, all zero
+    /// @param[in]  num_elements    The number of elements in the container
+    // ------------------------------------------------------------------------------------------------------
+    WordContainer(const WordStorage& words, const size_t num_elements) 
+    : _words(words), _num_elements(num_elements) {}
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a value from the container
+    /// @param[in]  i   The index of the element to get
+    // ------------------------------------------------------------------------------------------------------
+    inline byte get(const size_t i) const 
+    {
+        return (_words[i / elements_per_word] >> shift(i % elements_per_word)) & element_mask;
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets a value in the container
+    /// @param[in]  i       The index of the element to set
+    /// @param[in]  value   The value to set the element to (0 | 1 for 1 bit, 0 | 1 | 2 | 3 for 2 bits)
+    // ------------------------------------------------------------------------------------------------------
+    inline void set(const size_t i, const byte value)
+    {
+        if (value > element_mask) return;
+        const size_t shift_amount = shift(i % elements_per_word);
+        word_type&   word         = _words[i / elements_per_word];
+        word = (word & ~(static_cast<word_type>(element_mask) << shift_amount)) 
+             | (static_cast<word_type>(value) << shift_amount);
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets up to a word of elements, with the last element in the lowest bits
+    /// @param[in]  start           The index of the first element to get
+    /// @param[in]  num_elements    The number of elements to get, at most elements_per_word
+    // ------------------------------------------------------------------------------------------------------
+    inline word_type get_range(const size_t start, const size_t num_elements) const 
+    {
+        if (num_elements == 0) return 0;
+        const size_t bit_start  = start * BitsPerElement     , num_bits = num_elements * BitsPerElement;
+        const size_t word_idx   = bit_start / bits_per_word  , bit_idx  = bit_start % bits_per_word;
+        
+        // All the elements are in the one word
+        if (bit_idx + num_bits <= bits_per_word) 
+            return (_words[word_idx] >> (bits_per_word - bit_idx - num_bits)) & low_mask(num_bits);
+        
+        // The elements are split between this word and the next one
+        const size_t num_bits_next = bit_idx + num_bits - bits_per_word;
+        return ((_words[word_idx] & low_mask(bits_per_word - bit_idx)) << num_bits_next) 
+             | (_words[word_idx + 1] >> (bits_per_word - num_bits_next));
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets up to a word of elements, from a word with the last element in the lowest bits
+    /// @param[in]  start           The index of the first element to set
+    /// @param[in]  num_elements    The number of elements to set, at most elements_per_word
+    /// @param[in]  values          The values of the elements
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_range(const size_t start, const size_t num_elements, const word_type values)
+    {
+        if (num_elements == 0) return;
+        const size_t    bit_start  = start * BitsPerElement     , num_bits = num_elements * BitsPerElement;
+        const size_t    word_idx   = bit_start / bits_per_word  , bit_idx  = bit_start % bits_per_word;
+        const word_type masked     = values & low_mask(num_bits);
+        
+        if (bit_idx + num_bits <= bits_per_word) {
+            const size_t shift_amount = bits_per_word - bit_idx - num_bits;
+            _words[word_idx] = (_words[word_idx] & ~(low_mask(num_bits) << shift_amount)) 
+                             | (masked << shift_amount);
+            return;
+        }
+        
+        // The lower bits of the values go into the top of the next word
+        const size_t num_bits_next  = bit_idx + num_bits - bits_per_word;
+        const size_t num_bits_first = bits_per_word - bit_idx;
+        _words[word_idx]     = (_words[word_idx] & ~low_mask(num_bits_first)) | (masked >> num_bits_next);
+        _words[word_idx + 1] = (_words[word_idx + 1] & low_mask(bits_per_word - num_bits_next)) 
+                             | (masked << (bits_per_word - num_bits_next));
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Copies a span of elements from another container into this one, a word at a time
+    /// @param[in]  source          The container to copy the elements from
+    /// @param[in]  source_start    The index of the first element to copy in the source container
+    /// @param[in]  start           The index in this container to copy the first element to
+    /// @param[in]  num_elements    The number of elements to copy
+    /// @tparam     SourceType      The type of the source container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename SourceType>
+    inline void copy_span(const SourceType& source      , const size_t source_start, 
+                          const size_t      start       , const size_t num_elements)
+    {
+        for (size_t copied = 0; copied < num_elements; copied += elements_per_word) {
+            const size_t chunk = std::min(elements_per_word, num_elements - copied);
+            set_range(start + copied, chunk, source.get_range(source_start + copied, chunk));
+        }
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Compares a span of elements in this container with a span in another, a word at a time
+    /// @param[in]  other           The container to compare with
+    /// @param[in]  start           The index of the first element of the span in this container
+    /// @param[in]  other_start     The index of the first element of the span in the other container
+    /// @param[in]  num_elements    The number of elements to compare
+    /// @return     The number of elements which are different
+    /// @tparam     OtherType       The type of the other container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename OtherType>
+    inline size_t compare_span(const OtherType& other       , const size_t start       , 
+                               const size_t     other_start , const size_t num_elements) const
+    {
+        size_t differences = 0;
+        for (size_t compared = 0; compared < num_elements; compared += elements_per_word) {
+            const size_t chunk = std::min(elements_per_word, num_elements - compared);
+            differences += count_differences(get_range(start + compared, chunk) ^ 
+                                             other.get_range(other_start + compared, chunk));
+        }
+        return differences;
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a word of the container
+    /// @param[in]  i   The index of the word
+    // ------------------------------------------------------------------------------------------------------
+    inline word_type word(const size_t i) const { return _words[i]; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets a word of the container
+    /// @param[in]  i       The index of the word
+    /// @param[in]  value   The value of the word
+    // ------------------------------------------------------------------------------------------------------
+    inline void set_word(const size_t i, const word_type value) { _words[i] = value; }
+   
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a pointer to the words of the container
+    // ------------------------------------------------------------------------------------------------------
+    inline word_type* words() { return &_words[0]; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a pointer to the words of the container
+    // ------------------------------------------------------------------------------------------------------
+    inline const word_type* words() const { return &_words[0]; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      The number of words which hold the elements of the container
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t num_words() const { return (_num_elements + elements_per_word - 1) / elements_per_word; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      The size (number of elements) in the container 
+    /// @return     The number of elements in the container 
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t size() const { return _num_elements; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes an element from the container, and shifts the later elements left a word at a time
+    /// @param[in]  i   The index of the element to remove
+    // ------------------------------------------------------------------------------------------------------
+    inline void remove_element(const size_t i)
+    {
+        const size_t last_word = (_num_elements - 1) / elements_per_word;
+        const size_t word_idx  = i / elements_per_word;
+        const size_t num_bits  = (i % elements_per_word) * BitsPerElement;
+        
+        // Keep the elements before i in the word and shift the ones after it left
+        const word_type high_mask = num_bits == 0 ? 0 : ~low_mask(bits_per_word - num_bits);
+        _words[word_idx] = (_words[word_idx] & high_mask) 
+                         | ((_words[word_idx] << BitsPerElement) & ~high_mask);
+        
+        // Each following word moves its first element to the end of the word before it
+        for (size_t w = word_idx; w < last_word; ++w) {
+            _words[w]     |= _words[w + 1] >> (bits_per_word - BitsPerElement);
+            _words[w + 1] <<= BitsPerElement;
+        }
+        --_num_elements;
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes all the elements which are set in a bitmap in a single pass -- the kept elements
+    ///             of each word are extracted together (PEXT) and written after the kept elements before them
+    /// @param[in]  drop    The bitmap of the elements to remove (1 to remove), with 1 bit elements
+    /// @tparam     BitmapType  The type of the bitmap, a WordArray or WordVector with 1 bit per element
+    // ------------------------------------------------------------------------------------------------------
+    template <typename BitmapType>
+    inline void remove_elements(const BitmapType& drop)
+    {
+        compact([&](const size_t start, const size_t num_elements) 
+        { 
+            return drop.get_range(start, num_elements); 
+        });
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes the elements at a sorted list of indices in a single pass
+    /// @param[in]  indices     The indices of the elements to remove, in ascending order
+    // ------------------------------------------------------------------------------------------------------
+    inline void remove_elements(const std::vector<size_t>& indices)
+    {
+        size_t next = 0;
+        compact([&](const size_t start, const size_t num_elements) 
+        {
+            word_type dropped = 0;
+            for (; next < indices.size() && indices[next] < start + num_elements; ++next) {
+                if (indices[next] >= start) 
+                    dropped |= word_type(1) << (start + num_elements - 1 - indices[next]);
+            }
+            return dropped;
+        });
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Converts to a vector with one element per byte, unpacking a word at a time
+    // ------------------------------------------------------------------------------------------------------
+    standard_container to_binary_vector() const 
+    {
+        standard_container host_vec(_num_elements);
+        for (size_t start = 0; start < _num_elements; start += elements_per_word) {
+            const size_t    chunk  = std::min(elements_per_word, _num_elements - start);
+            const word_type values = get_range(start, chunk);
+            for (size_t i = 0; i < chunk; ++i) 
+                host_vec[start + i] = (values >> ((chunk - 1 - i) * BitsPerElement)) & element_mask;
+        }
+        return host_vec;
+    }
+protected:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the shift of an element within its word
+    /// @param[in]  i   The index of the element in the word
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t shift(const size_t i) { return bits_per_word - (i + 1) * BitsPerElement; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets a mask of the lowest num_bits bits
+    /// @param[in]  num_bits    The number of bits in the mask, at most a word
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type low_mask(const size_t num_bits) 
+    { 
+        return num_bits >= bits_per_word ? ~word_type(0) : (word_type(1) << num_bits) - 1; 
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Counts the elements of a word which have any bit set
+    /// @param[in]  bits    The bits of the elements
+    // ------------------------------------------------------------------------------------------------------
+    static inline size_t count_differences(word_type bits)
+    {
+        // Fold the upper bit of each 2 bit element onto the lower bit
+        if (BitsPerElement == 2) bits = (bits | (bits >> 1)) & 0x5555555555555555ULL;
+        return __builtin_popcountll(bits);
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Moves the kept elements to the front a word at a time, and clears the words after them
+    /// @param[in]  dropped_bits    Returns the bits (1 to remove, last element lowest) of the elements to 
+    ///             remove for a start index and a number of elements
+    /// @tparam     DropFunction    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename DropFunction>
+    inline void compact(DropFunction dropped_bits)
+    {
+        size_t kept = 0;
+        for (size_t start = 0; start < _num_elements; start += elements_per_word) {
+            const size_t chunk = std::min(elements_per_word, _num_elements - start);
+            
+            // The elements of the chunk are at the top of the word
+            const word_type keep     = (~dropped_bits(start, chunk) & low_mask(chunk)) 
+                                     << (elements_per_word - chunk);
+            const size_t    num_kept = __builtin_popcountll(keep);
+            
+            // Nothing moves until the first element is removed
+            if (num_kept == chunk && kept == start) { kept += num_kept; continue; }
+            
+            set_range(kept, num_kept, extract_bits(_words[start / elements_per_word], spread(keep)));
+            kept += num_kept;
+        }
+        
+        // Clear the elements after the last kept one
+        if (kept % elements_per_word != 0) 
+            set_range(kept, elements_per_word - kept % elements_per_word, 0);
+        const size_t first_word = (kept + elements_per_word - 1) / elements_per_word;
+        for (size_t w = first_word; w * elements_per_word < _num_elements; ++w) _words[w] = 0;
+        _num_elements = kept;
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Spreads a mask with a bit per element to a mask with all the bits of each element set
+    /// @param[in]  mask    The mask with a bit per element, last element lowest
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type spread(word_type mask)
+    {
+        if (BitsPerElement == 1) return mask;
+        mask = (mask | (mask << 16)) & 0x0000FFFF0000FFFFULL;
+        mask = (mask | (mask << 8 )) & 0x00FF00FF00FF00FFULL;
+        mask = (mask | (mask << 4 )) & 0x0F0F0F0F0F0F0F0FULL;
+        mask = (mask | (mask << 2 )) & 0x3333333333333333ULL;
+        mask = (mask | (mask << 1 )) & 0x5555555555555555ULL;
+        return mask | (mask << 1);
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Extracts the bits of a word which are set in a mask to the lowest bits, and keeps their
+    ///             order (PEXT, which is used when the BMI2 instructions are available)
+    /// @param[in]  bits    The bits to extract from
+    /// @param[in]  mask    The mask of the bits to extract
+    // ------------------------------------------------------------------------------------------------------
+    static inline word_type extract_bits(const word_type bits, word_type mask)
+    {
+#ifdef __BMI2__
+        return _pext_u64(bits, mask);
+#else
+        word_type extracted = 0;
+        for (word_type bit = 1; mask != 0; bit <<= 1) {
+            if (bits & mask & (~mask + 1)) extracted |= bit;
+            mask &= mask - 1;
+        }
+        return extracted;
+#endif
+    }
+};
+
+template <byte BitsPerElement, typename WordStorage>
+constexpr size_t WordContainer<BitsPerElement, WordStorage>::bits_per_word;
+template <byte BitsPerElement, typename WordStorage>
+constexpr size_t WordContainer<BitsPerElement, WordStorage>::elements_per_word;
+template <byte BitsPerElement, typename WordStorage>
+constexpr size_t WordContainer<BitsPerElement, WordStorage>::element_mask;
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class  WordArray
+/// @brief  Container which can hold N elements of 1 or 2 bits in a fixed array of 64 bit words
+/// @tparam NumElements     The number of elements the container can hold
+/// @tparam BitsPerElement  The number of bits per element, can be 1 or 2 -- default to 1
+// ----------------------------------------------------------------------------------------------------------
+template <size_t NumElements, byte BitsPerElement = 1>
+class WordArray : public WordContainer<BitsPerElement, 
+                    std::array<uint64_t, NumElements * BitsPerElement / 64 + 1>> {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_storage  = std::array<uint64_t, NumElements * BitsPerElement / 64 + 1>;
+    using base_type     = WordContainer<BitsPerElement, word_storage>;
+    // ------------------------------------------------------------------------------------------------------
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Default constructor
+    // ------------------------------------------------------------------------------------------------------
+    WordArray() : base_type(word_storage(), NumElements) { this->_words.fill(0); }
+};
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class  WordVector
+/// @brief  Container which can hold a variable number of elements of 1 or 2 bits in 64 bit words, which are
+///         allocated from the current arena of the thread which creates the container, if it has one
+/// @tparam BitsPerElement  The number of bits per element, can be 1 or 2
+// ----------------------------------------------------------------------------------------------------------
+template <byte BitsPerElement>
+class WordVector : public WordContainer<BitsPerElement, std::vector<uint64_t, ArenaAllocator<uint64_t>>> {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using word_storage  = std::vector<uint64_t, ArenaAllocator<uint64_t>>;
+    using base_type     = WordContainer<BitsPerElement, word_storage>;
+    // ------------------------------------------------------------------------------------------------------
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor to take the number of elements for the container 
+    /// @param[in]  num_elements    The number of elements in the container
+    // ------------------------------------------------------------------------------------------------------
+    explicit WordVector(const size_t num_elements = 0) 
+    : base_type(word_storage(num_elements / base_type::elements_per_word + 1, 0), num_elements) {}
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Resizes the container (adds to the end if bigger, or removes from the end if smaller), the
+    ///             elements which are added are all zero
+    /// @param[in]  num_elements    The number of elements in the container after the resize
+    // ------------------------------------------------------------------------------------------------------
+    inline void resize(const size_t num_elements)
+    {
+        constexpr size_t elements_per_word = base_type::elements_per_word;
+        
+        // Clear the elements after the end which are kept in the last word
+        if (num_elements < this->_num_elements) {
+            const size_t end = std::min(this->_num_elements, 
+                                        (num_elements / elements_per_word + 1) * elements_per_word);
+            this->set_range(num_elements, end - num_elements, 0);
+        }
+        this->_words.resize(num_elements / elements_per_word + 1, 0);
+        this->_num_elements = num_elements;
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Adds an element to the back of the vector
+    /// @param[in]  value     The element to add to the back of the vector
+    // ------------------------------------------------------------------------------------------------------
+    inline void push_back(const byte value)
+    {
+        if (this->_num_elements / base_type::elements_per_word + 1 > this->_words.size()) 
+            this->_words.push_back(0);
+        this->set(this->_num_elements++, value);
+    }
+};
 
 }           // End namespace haplo
 
@@ -0,0 +1,134 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   sparse_reads.hpp
+/// @brief  Header file for the sparse (compressed sparse row) storage of the calls of the reads, for data
+///         where most of the elements between the start and end of the reads are gaps
+// ----------------------------------------------------------------------------------------------------------
+
+#ifndef PARAHAPLO_SPARSE_READS_HPP
+#define PARAHAPLO_SPARSE_READS_HPP
+
+#include <tbb/tbb.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace haplo {
+
+// ----------------------------------------------------------------------------------------------------------
+/// @class      SparseReads
+/// @brief      Holds only the calls (0 or 1 elements) of each read, as a sorted list of 32 bit entries with
+///             the column in the high 31 bits and the allele in the low bit, and the start of each read's
+///             entries. Each call takes 4 bytes rather than the 2 bits of every element of the packed data,
+///             so it's smaller when fewer than 1 in 16 elements are calls
+// ----------------------------------------------------------------------------------------------------------
+class SparseReads {
+public:
+    // ----------------------------------------------- ALIAS'S ----------------------------------------------
+    using entry_type        = uint32_t;
+    using entry_container   = std::vector<entry_type>;
+    using offset_container  = std::vector<size_t>;
+    // ------------------------------------------------------------------------------------------------------
+    static constexpr size_t     bytes_per_call  = sizeof(entry_type);
+private:
+    entry_container     _entries;           //!< The column and allele of each call
+    offset_container    _offsets;           //!< The start of each read's entries, and the end of the last
+public:
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Default constructor -- no reads
+    // ------------------------------------------------------------------------------------------------------
+    SparseReads() : _offsets(1, 0) {}
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Constructor -- finds the calls of the packed 2 bit elements of the reads in parallel
+    /// @param[in]  data        The packed 2 bit data of the reads
+    /// @param[in]  read_info   The information for each read (start, end and offset in the data)
+    /// @param[in]  reads       The number of reads
+    /// @tparam     DataType    The type of the data container
+    /// @tparam     InfoType    The type of the read information container
+    // ------------------------------------------------------------------------------------------------------
+    template <typename DataType, typename InfoType>
+    SparseReads(const DataType& data, const InfoType& read_info, const size_t reads);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t reads() const { return _offsets.size() - 1; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of calls of all the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t calls() const { return _entries.size(); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of calls of a read
+    /// @param[in]  row_idx     The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t calls(const size_t row_idx) const { return _offsets[row_idx + 1] - _offsets[row_idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the memory used by the calls, in bytes
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t bytes() const { return calls() * bytes_per_call + _offsets.size() * sizeof(size_t); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the value of an element of a read -- 2 if the read doesn't have a call at the column,
+    ///             so the caller must check that the column is in the read
+    /// @param[in]  row_idx     The index of the read
+    /// @param[in]  col_idx     The index of the column
+    // ------------------------------------------------------------------------------------------------------
+    inline uint8_t operator()(const size_t row_idx, const size_t col_idx) const
+    {
+        const auto first = _entries.begin() + _offsets[row_idx];
+        const auto last  = _entries.begin() + _offsets[row_idx + 1];
+        const auto entry = std::lower_bound(first, last, entry_type(col_idx << 1));
+        return entry != last && (*entry >> 1) == col_idx ? (*entry & 1) : 0x02;
+    }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Calls a function with the column and the value of each call of a read, in column order
+    /// @param[in]  row_idx     The index of the read
+    /// @param[in]  function    The function to call, which takes the column and the value
+    /// @tparam     Function    The type of the function
+    // ------------------------------------------------------------------------------------------------------
+    template <typename Function>
+    inline void for_each_call(const size_t row_idx, Function function) const
+    {
+        for (size_t i = _offsets[row_idx]; i < _offsets[row_idx + 1]; ++i)
+            function(size_t(_entries[i] >> 1), uint8_t(_entries[i] & 1));
+    }
+};
+
+// ---------------------------------------------- IMPLEMENTATIONS -------------------------------------------
+
+template <typename DataType, typename InfoType>
+SparseReads::SparseReads(const DataType& data, const InfoType& read_info, const size_t reads)
+: _offsets(reads + 1, 0)
+{
+    // Count the calls of each read, then each read's entries start after those of the reads before it
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, reads), [&](const tbb::blocked_range<size_t>& rows)
+    {
+        for (size_t row_idx = rows.begin(); row_idx != rows.end(); ++row_idx) {
+            const auto read = read_info[row_idx];
+            for (size_t i = 0; i < read.length(); ++i) 
+                if (data.get(read.offset() + i) <= 1) ++_offsets[row_idx + 1];
+        }
+    });
+    for (size_t row_idx = 0; row_idx < reads; ++row_idx) _offsets[row_idx + 1] += _offsets[row_idx];
+
+    _entries.resize(_offsets[reads]);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, reads), [&](const tbb::blocked_range<size_t>& rows)
+    {
+        for (size_t row_idx = rows.begin(); row_idx != rows.end(); ++row_idx) {
+            const auto read  = read_info[row_idx];
+            size_t     entry = _offsets[row_idx];
+            for (size_t i = 0; i < read.length(); ++i) {
+                const auto value = data.get(read.offset() + i);
+                if (value <= 1) _entries[entry++] = entry_type(((read.start_index() + i) << 1) | value);
+            }
+        }
+    });
+}
+
+}               // End namespace haplo
+#endif          // PARAHAPLO_SPARSE_READS_HPP
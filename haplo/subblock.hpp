@@ -13,7 +13,7 @@ namespace haplo {
 // ----------------------------------------------------------------------------------------------------------
 /// @class      SubBlock   
 /// @brief      General class for creating sub blocks from an entire block, which can then be solved in
-///             parallel
+///             parallel -- on the cpu the threads are set at runtime by the concurrency of the block
 /// @tparam     ThreadsX    The number of threads to use in the X dimesion (columns)
 /// @tparam     ThreadsY    The number of threads to use in the Y dimension (rows)
 /// @tparam     DeviceType  The type of device to use 
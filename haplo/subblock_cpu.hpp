@@ -5,13 +5,22 @@
 #ifndef PARAHAPLO_SUB_BLOCK_CPU_HPP
 #define PARAHAPLO_SUB_BLOCK_CPU_HPP
 
+#include "allele_planes.hpp"
+#include "arena.hpp"
+#include "column_view.hpp"
 #include "devices.hpp"
 #include "graph.h"
+#include "multilevel.h"
 #include "processor_cpu.hpp"
 #include "subblock.hpp"
 #include "snp_info_gpu.h"
 
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <numeric>
 #include <sstream>
+#include <vector>
 
 namespace haplo {
 
@@ -23,13 +32,20 @@ public:
     using sub_block_type        = SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>;
     using atomic_type           = tbb::atomic<size_t>;
     using binary_vector         = BinaryVector<2>;              
+    using data_container        = WordVector<2>;
     using atomic_vector         = tbb::concurrent_vector<size_t>;
-    using concurrent_umap       = typename BaseBlock::concurrent_umap;
-    using read_info_container   = typename BaseBlock::read_info_container;
+    using umap_allocator        = ArenaAllocator<std::pair<const size_t, uint8_t>>;
+    using concurrent_umap       = tbb::concurrent_unordered_map<size_t, uint8_t, std::hash<size_t>,
+                                                                std::equal_to<size_t>, umap_allocator>;
+    using read_info_container   = ReadTable<typename BaseBlock::offset_type>;
     using snp_info_container    = typename BaseBlock::snp_info_container;
+    using component_container   = std::vector<size_t>;
+    using selection_container   = std::vector<uint8_t>;
+    using column_pointer        = std::shared_ptr<const ColumnView>;
     // ------------------------------------------------------------------------------------------------------
-    static constexpr size_t     THREADS_X   = ThreadsX;
-    static constexpr size_t     THREADS_Y   = ThreadsY;
+    static constexpr size_t     THREADS_X       = ThreadsX;
+    static constexpr size_t     THREADS_Y       = ThreadsY;
+    static constexpr size_t     NO_COMPONENT    = static_cast<size_t>(-1);
 private:
     size_t              _num_nih;           //!< The number of NIH columns
     size_t              _index;             //!< The index of the unsplittable block within the base block
@@ -38,7 +54,8 @@ private:
     size_t              _elements;          //!< The number of elements in the sub block
     size_t              _base_start_row;    //!< The start row of the subblock in the base block
     
-    binary_vector       _data;              //!< The data for the block
+    data_container      _data;              //!< The data for the block
+    mutable column_pointer _columns;        //!< The column major data, built when first used
     binary_vector       _haplo_one;         //!< The first haplotype
     binary_vector       _haplo_two;         //!< The second haplotype 
         
@@ -50,6 +67,41 @@ private:
     concurrent_umap     _duplicate_cols;        //!< Map of duplicate cols
     concurrent_umap     _row_multiplicities;    //!< How many duplicates each row has
     
+    size_t              _num_components;        //!< The number of independent components of the reads
+    component_container _read_components;       //!< The component of each read, NO_COMPONENT if excluded
+    selection_container _selected_reads;        //!< If each read is used to solve, 0 if over the coverage cap
+    size_t              _discarded_reads;       //!< The number of reads discarded by the coverage cap
+    component_container _read_clusters;         //!< The cluster of near-duplicate reads of each read
+    size_t              _num_clusters;          //!< The number of clusters of near-duplicate reads
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @struct     Unfiltered
+    /// @brief      The state of the sub-block before the columns were filtered, restored after solving
+    // ------------------------------------------------------------------------------------------------------
+    struct Unfiltered {
+        data_container      data;
+        read_info_container read_info;
+        snp_info_container  snp_info;
+        concurrent_umap     duplicate_rows;
+        concurrent_umap     duplicate_cols;
+        concurrent_umap     row_multiplicities;
+        component_container read_components;
+        selection_container selected_reads;
+        component_container read_clusters;
+        size_t              cols;
+        size_t              rows;
+        size_t              elements;
+        size_t              num_nih;
+        size_t              num_components;
+        size_t              discarded_reads;
+        size_t              num_clusters;
+    };
+
+    Unfiltered          _unfiltered;            //!< The sub-block before the columns were filtered
+    component_container _column_map;            //!< The unfiltered column of each filtered column
+    component_container _row_map;               //!< The unfiltered row of each filtered row
+    bool                _filtered;              //!< If the columns are filtered
+    
     // Friend class that can process rows and columns    
     template <typename FriendType, byte ProcessType, byte DeviceType>
     friend class Processor;
@@ -57,6 +109,20 @@ private:
     // Graph is s friend class so that it can access the data 
     template <typename SubBlockType, byte DeviceType>
     friend class Graph;
+    
+    // Multilevel is a friend class so that it can set the haplotypes
+    template <typename SubBlockType, byte DeviceType>
+    friend class Multilevel;
+
+    // The exact solvers and the dispatcher are friends so that they can set the haplotypes
+    template <typename SubBlockType>
+    friend class BruteForce;
+
+    template <typename SubBlockType>
+    friend class ColumnDp;
+
+    template <typename SubBlockType>
+    friend class Dispatcher;
 
 public:
     // ------------------------------------------------------------------------------------------------------
@@ -101,7 +167,22 @@ public:
     // ------------------------------------------------------------------------------------------------------
     /// @brief      A refernce to the data
     // ------------------------------------------------------------------------------------------------------
-    inline binary_vector& data()  { return _data; }
+    inline data_container& data()  { return _data; }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the data of the sub-block as allele and call planes
+    // ------------------------------------------------------------------------------------------------------
+    inline AllelePlanes allele_planes() const { return AllelePlanes(_data, _read_info, _rows, _cols); }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the data of the sub-block in column major order. The view is built by the first call
+    ///             after the data changes, so the first call must not be from concurrent tasks
+    // ------------------------------------------------------------------------------------------------------
+    inline const ColumnView& columns() const 
+    { 
+        if (!_columns) _columns = std::make_shared<const ColumnView>(_data, _read_info, _rows, _cols);
+        return *_columns; 
+    }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      A reference to the first haplotype
@@ -127,11 +208,102 @@ public:
     // @brief       Gets the number of NIH columns
     // ------------------------------------------------------------------------------------------------------
     inline size_t nih_columns() const { return _num_nih; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of independent components of the sub-block -- sets of reads which share no
+    ///             informative snps with the reads of any other component, so they can be solved separately
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t num_components() const { return _num_components; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the component of a read, NO_COMPONENT if the read has less than 2 informative values
+    ///             and so gives no information about how the haplotypes are linked
+    /// @param[in]  row_idx     The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t read_component(const size_t row_idx) const { return _read_components[row_idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Selects the reads which are used to solve the sub-block so that no column has more than
+    ///             max_coverage informative values from the selected reads. The reads with the most informative
+    ///             values are considered first (they link the most snps), and a read is discarded if any of its
+    ///             informative columns is already at the cap. The components are found again for the selected
+    ///             reads, so the discarded reads are excluded, and the solvers place them against the final
+    ///             haplotypes. A max_coverage of 0 selects all the reads
+    /// @param[in]  max_coverage    The maximum number of selected reads with a 0 or 1 value in a column
+    /// @return     The number of reads which were discarded
+    // ------------------------------------------------------------------------------------------------------
+    size_t select_reads(const size_t max_coverage);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If a read is used to solve the sub-block, false if it was discarded by the coverage cap
+    /// @param[in]  row_idx     The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline bool read_selected(const size_t row_idx) const { return _selected_reads[row_idx] != 0; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of reads which were discarded by the coverage cap
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t discarded_reads() const { return _discarded_reads; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Places the reads which were discarded by the coverage cap with the haplotype they conflict
+    ///             with the least, once a solver has set the haplotypes from the selected reads. The columns
+    ///             which only discarded reads have values in take the majority value of the reads placed with
+    ///             each haplotype, and different values at IH columns
+    // ------------------------------------------------------------------------------------------------------
+    void place_discarded_reads();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Groups the reads with the same span which differ in at most max_distance elements into
+    ///             clusters, which the solvers can use as a single fragment weighted by the values of all 
+    ///             the reads in it. Each read is in its own cluster until this is called
+    /// @param[in]  max_distance    The most elements in which a read can differ from its cluster's first read
+    /// @return     The number of clusters
+    // ------------------------------------------------------------------------------------------------------
+    size_t cluster_reads(const size_t max_distance);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the cluster of a read -- the clusters are numbered in the order of their first read
+    /// @param[in]  row_idx     The index of the read
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t read_cluster(const size_t row_idx) const { return _read_clusters[row_idx]; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the number of clusters of the reads
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t num_clusters() const { return _num_clusters; }
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Removes the columns which give little information about the haplotypes from the sub-block
+    ///             -- those with fewer than min_minor_count of the less common value, and optionally the NIH
+    ///             columns -- along with the reads which only have values in them, so that the solvers work
+    ///             on fewer snps. The haplotypes which are found are for the filtered columns until
+    ///             restore_columns is called. The reads keep their selection and clusters, and the duplicate
+    ///             rows and columns are found again for the filtered data. Nothing is done if the columns are
+    ///             already filtered, or if every column would be removed
+    /// @param[in]  min_minor_count     The least number of the less common value a column must have
+    /// @param[in]  remove_nih          If the NIH columns should be removed
+    /// @return     The number of columns which were removed
+    // ------------------------------------------------------------------------------------------------------
+    size_t filter_columns(const size_t min_minor_count, const bool remove_nih = false);
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Restores the columns removed by filter_columns, expanding the haplotypes of the filtered
+    ///             columns. Each read goes into the partition of the haplotype it conflicts with the least,
+    ///             and the removed columns take the majority value of each partition (of all the reads if a
+    ///             partition has no values), and different values at IH columns
+    // ------------------------------------------------------------------------------------------------------
+    void restore_columns();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      If the columns of the sub-block are filtered
+    // ------------------------------------------------------------------------------------------------------
+    inline bool filtered() const { return _filtered; }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets a reference to the read information
     // ------------------------------------------------------------------------------------------------------
-    inline thrust::host_vector<ReadInfo>& read_info() { return _read_info; }
+    inline read_info_container& read_info() { return _read_info; }
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets the snp info as a host vector
@@ -161,6 +333,27 @@ public:
         }
     }
 
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the column in the base block of a column of the sub-block (before any filtering)
+    /// @param[in]  col_idx     The index of the column in the sub-block
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t base_column(const size_t col_idx) const 
+    { 
+        const auto& informative = base_block()->informative_cols();
+        return informative.select(informative.rank(base_start_index()) + col_idx);
+    }
+    
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Gets the column of the sub-block (before any filtering) of a non monotone column of the base 
+    ///             block which is in the sub-block
+    /// @param[in]  base_col_idx    The index of the column in the base block
+    // ------------------------------------------------------------------------------------------------------
+    inline size_t column(const size_t base_col_idx) const 
+    {
+        const auto& informative = base_block()->informative_cols();
+        return informative.rank(base_col_idx) - informative.rank(base_start_index());
+    }
+
 private:
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Gets a pointer to the block which is a base class of this unsplittable block
@@ -192,6 +385,28 @@ private:
     /// @brief      Find the duplicate rows
     // ------------------------------------------------------------------------------------------------------
     void find_duplicate_rows();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Counts the informative (0 or 1) values of each read
+    // ------------------------------------------------------------------------------------------------------
+    std::vector<size_t> count_informative() const;
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Finds the connected components of the read-snp graph, where reads are connected through
+    ///             the snps they have a 0 or 1 value for. Monotone columns are already removed, duplicate
+    ///             columns connect the same reads as the columns they duplicate, and reads with a single
+    ///             informative value are excluded as they can't link any snps, as are unselected reads
+    // ------------------------------------------------------------------------------------------------------
+    void find_components();
+
+    // ------------------------------------------------------------------------------------------------------
+    /// @brief      Sets the haplotypes at the columns which weren't solved to the majority value of the reads
+    ///             placed with each haplotype (of all the reads if no placed read has a value in the column),
+    ///             and makes them different at IH columns by flipping the one which conflicts the least
+    /// @param[in]  solved      If each column was solved, those keep their values
+    /// @param[in]  placements  The haplotype (1 or 2) each read is placed with, 0 if it isn't placed
+    // ------------------------------------------------------------------------------------------------------
+    void set_unsolved_columns(const std::vector<bool>& solved, const std::vector<uint8_t>& placements);
     
     // ------------------------------------------------------------------------------------------------------
     /// @brief      Sets the parameters for a column -- the start and end index
@@ -205,17 +420,18 @@ private:
     /// @brief      Adds elements to the data vector and updates the offset
     /// @param[in]  row_idx         The index of the row that the elements are being added for
     /// @param[in]  read_length     The number of elements to add from the read
-    /// @param[in]  mono_weights    The weights for how many monotone columes are before the start index
     /// @param[in]  offset          The offset in memory for where to start adding the elements
     // ------------------------------------------------------------------------------------------------------
-    size_t add_elements(const size_t               row_idx     , const size_t read_length, 
-                        const std::vector<size_t>& mono_weights, size_t       offset     );    
+    size_t add_elements(const size_t row_idx, const size_t read_length, size_t offset);    
 };
 
 // -------------------------------------------- IMPLEMENTATIONS ---------------------------------------------
 
 // ----------------------------------------------- PUBLIC ---------------------------------------------------
 
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
+constexpr size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::NO_COMPONENT;
+
 template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
 SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::SubBlock(const BaseBlock& block, 
                                                                 const size_t     index) 
@@ -227,7 +443,11 @@ SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::SubBlock(const BaseBlock&
   _elements(0)                                                          ,
   _base_start_row(0)                                                    ,
   _data(0)                                                              ,
-  _read_info(0)                                                 
+  _read_info(0)                                                         ,
+  _num_components(0)                                                    ,
+  _discarded_reads(0)                                                   ,
+  _num_clusters(0)                                                      ,
+  _filtered(false)
 {
     std::ostringstream error_message;
     error_message   << "Index for unsplittable block past max index\n" 
@@ -242,9 +462,17 @@ SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::SubBlock(const BaseBlock&
          std::cerr << "Out of Range error: " << oor.what() << '\n'; 
     }
     
-    fill();                                             // Fill the block with data
-    find_duplicate_rows();                              // Find the duplicate rows and the row mltiplicities
-    process_snps();                                     // Process the snps
+    // The sub-block uses the threads of the block's task arena
+    this->concurrency().execute([&]
+    {
+        fill();                                         // Fill the block with data
+        find_duplicate_rows();                          // Find the duplicate rows and the row mltiplicities
+        process_snps();                                 // Process the snps
+    });
+    _selected_reads.assign(_rows, 1);                   // All the reads are used until a coverage cap
+    _read_clusters.resize(_rows);                       // Each read is in its own cluster
+    std::iota(_read_clusters.begin(), _read_clusters.end(), 0); _num_clusters = _rows;
+    find_components();                                  // Find the independent components
     _haplo_one.resize(_cols);                           // Allocate memory for haplo one
     _haplo_two.resize(_cols);                           // Allocate memory for haplo two
 }
@@ -270,102 +498,350 @@ void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::print_haplotypes() c
     for (auto i = 0; i < _haplo_two.size() + 6; ++i) std::cout << "-";
 }
 
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::select_reads(const size_t max_coverage)
+{
+    _selected_reads.assign(_rows, 1);
+    _discarded_reads = 0;
+    
+    if (max_coverage > 0) {
+        // Consider the reads which link the most snps first, the index breaks ties
+        const auto          informative = count_informative();
+        std::vector<size_t> order(_rows);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), 
+            [&](const size_t a, const size_t b) { return informative[a] > informative[b]; });
+        
+        std::vector<size_t> coverage(_cols, 0);
+        for (const auto row_idx : order) {
+            const auto& read_info = _read_info[row_idx];
+            bool        full      = false;
+            for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index() && !full; ++col_idx)
+                full = operator()(row_idx, col_idx) <= ONE && coverage[col_idx] >= max_coverage;
+            
+            if (full) {
+                _selected_reads[row_idx] = 0; ++_discarded_reads; continue;
+            }
+            for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) 
+                if (operator()(row_idx, col_idx) <= ONE) ++coverage[col_idx];
+        }
+    }
+    
+    find_components();
+    return _discarded_reads;
+}
 
-// -------------------------------------------- PRIVATE -----------------------------------------------------
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::place_discarded_reads()
+{
+    if (_discarded_reads == 0) return;
+
+    // The solver found the haplotypes at the columns which the selected reads have values in, and the
+    // columns which the discarded reads have no values in keep the values it gave them
+    std::vector<bool> selected(_cols, false), discarded(_cols, false), solved(_cols, false);
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        auto& has_value = _selected_reads[row_idx] ? selected : discarded;
+        for (size_t col_idx = _read_info[row_idx].start_index(); 
+             col_idx <= _read_info[row_idx].end_index(); ++col_idx) {
+            if (operator()(row_idx, col_idx) <= ONE) has_value[col_idx] = true;
+        }
+    }
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) 
+        solved[col_idx] = selected[col_idx] || !discarded[col_idx];
+
+    // Each discarded read goes with the haplotype it conflicts with the least at the solved columns
+    std::vector<uint8_t> placements(_rows, 0);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _rows),
+        [&](const tbb::blocked_range<size_t>& rows)
+        {
+            for (size_t row_idx = rows.begin(); row_idx != rows.end(); ++row_idx) {
+                if (_selected_reads[row_idx]) continue;
+                size_t conflicts_one = 0, conflicts_two = 0;
+                for (size_t col_idx = _read_info[row_idx].start_index(); 
+                     col_idx <= _read_info[row_idx].end_index(); ++col_idx) {
+                    const auto element = operator()(row_idx, col_idx);
+                    if (element > ONE || !solved[col_idx]) continue;
+                    conflicts_one += element != _haplo_one.get(col_idx);
+                    conflicts_two += element != _haplo_two.get(col_idx);
+                }
+                placements[row_idx] = conflicts_two < conflicts_one ? 2 : 1;
+            }
+        }
+    );
+    set_unsolved_columns(solved, placements);
+}
 
 template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
-void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::fill()
+size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::cluster_reads(const size_t max_distance)
 {
-    size_t offset = 0; size_t monos_found = 0; bool first_row_set = false;
-    std::vector<size_t> mono_weights(base_end_index() - base_start_index() + 1);
+    // Create a processor for the rows to group the near-duplicates
+    Processor<sub_block_type, proc::row_clusters, devices::cpu> row_processor(*this);
+    return row_processor(max_distance);
+}
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::filter_columns(const size_t min_minor_count, 
+                                                                             const bool   remove_nih     )
+{
+    if (_filtered) return 0;
     
-    for (size_t col_idx = base_start_index(); col_idx <= base_end_index(); ++col_idx) {
-        if (base_block()->is_monotone(col_idx)) ++monos_found;
-        mono_weights[col_idx - base_start_index()] = monos_found;
+    std::vector<bool> keep(_cols, false);
+    _column_map.clear();
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) {
+        if (_snp_info.find(col_idx) == _snp_info.end()) continue;
+        const auto& snp_info = _snp_info.at(col_idx);
+        keep[col_idx] = std::min(snp_info.zeros(), snp_info.ones()) >= min_minor_count &&
+                        !(remove_nih && snp_info.type() == NIH);
+        if (keep[col_idx]) _column_map.push_back(col_idx);
     }
-    _cols -= monos_found;       // Subtract the number of montone columns from the total columns
-    
-    // Go over each of the data rows and check for singularity
-    for (size_t row_idx = 0; row_idx < base_block()->reads(); ++row_idx) {
-        // If the row is part of this subblock
-        if (base_block()->read_info(row_idx).start_index() >= base_start_index() &&
-            base_block()->read_info(row_idx).end_index()   <= base_end_index()    ) {
-
-            // Determine the parameters of the read
-            auto read_length = base_block()->read_info(row_idx).length();
-
-            // If the read is not singular
-            if (read_length > 1) {
-                _read_info.push_back(ReadInfo(_rows, 0, 0, offset));
-                offset = add_elements(row_idx, read_length, mono_weights, offset);
-                _elements += _read_info[_rows].length();
-                ++_rows;
-                
-                // Check if we found the first row
-                if (!first_row_set && offset > 0) 
-                    first_row_set = true;
-                else if (!first_row_set)
-                    ++_base_start_row;
+    // Solving without any columns would put every read in the same partition, so don't filter
+    if (_column_map.size() == _cols || _column_map.empty()) return 0;
+    
+    std::vector<size_t> filtered_cols(_cols, 0);
+    for (size_t i = 0; i < _column_map.size(); ++i) filtered_cols[_column_map[i]] = i;
+    
+    // Move the unfiltered state out of the way 
+    _unfiltered.data.resize(0); _columns.reset();
+    std::swap(_unfiltered.data, _data);
+    std::swap(_unfiltered.read_info, _read_info);
+    std::swap(_unfiltered.snp_info, _snp_info);
+    std::swap(_unfiltered.duplicate_rows, _duplicate_rows);
+    std::swap(_unfiltered.duplicate_cols, _duplicate_cols);
+    std::swap(_unfiltered.row_multiplicities, _row_multiplicities);
+    std::swap(_unfiltered.read_components, _read_components);
+    std::swap(_unfiltered.selected_reads, _selected_reads);
+    std::swap(_unfiltered.read_clusters, _read_clusters);
+    _unfiltered.cols            = _cols;            _unfiltered.rows            = _rows;
+    _unfiltered.elements        = _elements;        _unfiltered.num_nih         = _num_nih;
+    _unfiltered.num_components  = _num_components;  _unfiltered.discarded_reads = _discarded_reads;
+    _unfiltered.num_clusters    = _num_clusters;
+    _data.resize(0); _read_info.clear(); _snp_info.clear(); 
+    _duplicate_rows.clear(); _duplicate_cols.clear(); _row_multiplicities.clear();
+    
+    // Copy the values of the kept columns of each read which has any
+    _row_map.clear(); _rows = 0; _elements = 0;
+    for (size_t row_idx = 0; row_idx < _unfiltered.rows; ++row_idx) {
+        const auto& read_info = _unfiltered.read_info[row_idx];
+        size_t      start     = _cols, end = 0;
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+            if (!keep[col_idx]) continue;
+            start = std::min(start, col_idx); end = col_idx;
+        }
+        if (start == _cols) continue;
+        
+        const size_t length = filtered_cols[end] - filtered_cols[start] + 1;
+        _read_info.push_back(ReadInfo(_rows, filtered_cols[start], filtered_cols[end], _elements));
+        _data.resize(_elements + length);
+        for (size_t col_idx = start; col_idx <= end; ++col_idx) {
+            if (!keep[col_idx]) continue;
+            const auto element = _unfiltered.data.get(read_info.offset() + col_idx - read_info.start_index());
+            _data.set(_elements++, element);
+            if (element <= ONE) set_col_params(filtered_cols[col_idx], _rows, element);
+        }
+        _row_map.push_back(row_idx);
+        ++_rows;
+    }
+    
+    _cols = _column_map.size(); _num_nih = 0;
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) 
+        _snp_info[col_idx].set_type(_unfiltered.snp_info[_column_map[col_idx]].type());
+    
+    // Reads and columns which differed only at the removed columns are now duplicates, so find them again
+    this->concurrency().execute([&]
+    {
+        find_duplicate_rows();
+        process_snps();
+    });
+    
+    // The reads keep their selection, and the clusters keep their reads (which have the same span, so they
+    // are all kept or all removed), numbered in the order of their first read
+    _selected_reads.resize(_rows); _read_clusters.resize(_rows);
+    _discarded_reads = 0; _num_clusters = 0;
+    component_container cluster_map(_unfiltered.num_clusters, NO_COMPONENT);
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        _selected_reads[row_idx] = _unfiltered.selected_reads[_row_map[row_idx]];
+        if (!_selected_reads[row_idx]) ++_discarded_reads;
+        
+        auto& cluster_idx = cluster_map[_unfiltered.read_clusters[_row_map[row_idx]]];
+        if (cluster_idx == NO_COMPONENT) cluster_idx = _num_clusters++;
+        _read_clusters[row_idx] = cluster_idx;
+    }
+    find_components();
+    _haplo_one.resize(_cols); _haplo_two.resize(_cols);
+    _filtered = true;
+    
+    return _unfiltered.cols - _cols;
+}
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::restore_columns()
+{
+    if (!_filtered) return;
+    
+    // Each read goes with the haplotype it conflicts with the least at the filtered columns
+    std::vector<uint8_t> placements(_unfiltered.rows, 0);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _rows),
+        [&](const tbb::blocked_range<size_t>& rows)
+        {
+            for (size_t row_idx = rows.begin(); row_idx != rows.end(); ++row_idx) {
+                size_t conflicts_one = 0, conflicts_two = 0;
+                for (size_t col_idx = _read_info[row_idx].start_index(); 
+                     col_idx <= _read_info[row_idx].end_index(); ++col_idx) {
+                    const auto element = operator()(row_idx, col_idx);
+                    if (element > ONE) continue;
+                    conflicts_one += element != _haplo_one.get(col_idx);
+                    conflicts_two += element != _haplo_two.get(col_idx);
+                }
+                placements[_row_map[row_idx]] = conflicts_two < conflicts_one ? 2 : 1;
             }
         }
+    );
+    
+    std::vector<uint8_t> haplo_one(_cols), haplo_two(_cols);
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) {
+        haplo_one[col_idx] = _haplo_one.get(col_idx); haplo_two[col_idx] = _haplo_two.get(col_idx);
+    }
+    
+    // Put the unfiltered state back
+    _columns.reset();
+    std::swap(_unfiltered.data, _data);
+    std::swap(_unfiltered.read_info, _read_info);
+    std::swap(_unfiltered.snp_info, _snp_info);
+    std::swap(_unfiltered.duplicate_rows, _duplicate_rows);
+    std::swap(_unfiltered.duplicate_cols, _duplicate_cols);
+    std::swap(_unfiltered.row_multiplicities, _row_multiplicities);
+    std::swap(_unfiltered.read_components, _read_components);
+    std::swap(_unfiltered.selected_reads, _selected_reads);
+    std::swap(_unfiltered.read_clusters, _read_clusters);
+    _cols            = _unfiltered.cols;            _rows            = _unfiltered.rows;
+    _elements        = _unfiltered.elements;        _num_nih         = _unfiltered.num_nih;
+    _num_components  = _unfiltered.num_components;  _discarded_reads = _unfiltered.discarded_reads;
+    _num_clusters    = _unfiltered.num_clusters;
+    _unfiltered.data.resize(0); _unfiltered.read_info.clear(); _unfiltered.snp_info.clear();
+    
+    _haplo_one.resize(_cols); _haplo_two.resize(_cols);
+    std::vector<bool> kept(_cols, false);
+    for (size_t i = 0; i < _column_map.size(); ++i) {
+        _haplo_one.set(_column_map[i], haplo_one[i]); _haplo_two.set(_column_map[i], haplo_two[i]);
+        kept[_column_map[i]] = true;
+    }
+    
+    // The removed columns take the majority of the reads in each partition
+    set_unsolved_columns(kept, placements);
+    _filtered = false;
+}
+
+// -------------------------------------------- PRIVATE -----------------------------------------------------
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::set_unsolved_columns(
+                                                                const std::vector<bool>&    solved    ,
+                                                                const std::vector<uint8_t>& placements)
+{
+    std::vector<std::array<size_t, 6>> counts(_cols, std::array<size_t, 6>{{0, 0, 0, 0, 0, 0}});
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        for (size_t col_idx = _read_info[row_idx].start_index(); 
+             col_idx <= _read_info[row_idx].end_index(); ++col_idx) {
+            const auto element = operator()(row_idx, col_idx);
+            if (solved[col_idx] || element > ONE) continue;
+            ++counts[col_idx][placements[row_idx] * 2 + element];        // [all, set one, set two][value]
+        }
+    }
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) {
+        if (solved[col_idx]) continue;
+        auto&        c     = counts[col_idx];
+        const size_t zeros = c[0] + c[2] + c[4], ones = c[1] + c[3] + c[5];
+        
+        const uint8_t value_one = c[2] + c[3] > 0 ? c[3] > c[2] : ones > zeros;
+        const uint8_t value_two = c[4] + c[5] > 0 ? c[5] > c[4] : ones > zeros;
+        _haplo_one.set(col_idx, value_one); _haplo_two.set(col_idx, value_two);
+        
+        // The haplotypes must be different at IH columns, so flip the one which conflicts the least
+        if (_snp_info.find(col_idx) != _snp_info.end() && _snp_info.at(col_idx).type() == IH && 
+            value_one == value_two) {
+            const size_t flip_one = std::max(c[2], c[3]) - std::min(c[2], c[3]);
+            const size_t flip_two = std::max(c[4], c[5]) - std::min(c[4], c[5]);
+            if (flip_one <= flip_two) _haplo_one.set(col_idx, !value_two);
+            else                      _haplo_two.set(col_idx, !value_one);
+        }
+    }
+}
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::fill()
+{
+    size_t offset = 0; bool first_row_set = false;
+    
+    // Only the non monotone columns are kept
+    _cols = column(base_end_index() + 1);
+    
+    // Go over each of the rows which are part of this subblock and check for singularity
+    for (const auto row_idx : base_block()->read_index().within(base_start_index(), base_end_index())) {
+        // Determine the parameters of the read
+        auto read_length = base_block()->read_info(row_idx).length();
+
+        // If the read is not singular
+        if (read_length > 1) {
+            _read_info.push_back(ReadInfo(_rows, 0, 0, offset));
+            const size_t read_offset = offset;
+            offset = add_elements(row_idx, read_length, offset);
+            
+            // The read only covers monotone columns
+            if (offset == read_offset) { _read_info.pop_back(); continue; }
+            _elements += _read_info[_rows].length();
+            ++_rows;
+            
+            // Check if we found the first row
+            if (!first_row_set && offset > 0) 
+                first_row_set = true;
+            else if (!first_row_set)
+                ++_base_start_row;
+        }
     }
    
 }
 
 template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
 size_t SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::add_elements(
-                                                            const size_t               base_row_idx,
-                                                            const size_t               read_length ,
-                                                            const std::vector<size_t>& mono_weights,
-                                                            size_t                     offset      )
+                                                            const size_t base_row_idx,
+                                                            const size_t read_length ,
+                                                            size_t       offset      )
 {
     // Make sure there is enough space
     _data.resize(_data.size() + read_length);                       
  
-    // The start and end index of the column
-    size_t read_start     = base_block()->read_info(base_row_idx).start_index() - base_start_index();
-    size_t start_col      = read_start - mono_weights[read_start];
-    size_t end_col        = start_col + read_length;
-    
-    // For the case where the start element of a read is monotone, re add the mono weight
-    if (base_block()->is_monotone(read_start + base_start_index())) {
-        start_col = read_start; end_col = start_col + read_length;
-    }
+    // The start of the read relative to the start of the sub-block
+    const size_t read_start = base_block()->read_info(base_row_idx).start_index() - base_start_index();
+    const size_t first      = offset;   // Offset of the first element of the read
     
-    bool   start_set    = false;        // If the start element has been found
     size_t num_elements = 0;            // Number of elements in the read
-    size_t mono_counter = 0;            // Number of monotones as the start of the read
-    
-    for (size_t col_idx = start_col; col_idx < end_col; ++col_idx) {
-        auto   base_col_idx  = col_idx + base_start_index() + mono_weights[read_start];
-        auto   base_elem_val = base_block()->operator()(base_row_idx, base_col_idx);
-        bool   is_mono_col   = base_block()->is_monotone(base_col_idx);
-
-        // If not a monotone column, and start is not found, set start
-        // otherwise count the number of initial monotone columns
-        if (!start_set && !is_mono_col) { 
-            _read_info[_rows].set_start_index(col_idx - mono_counter);
-            start_set = true;
-        } else if (!start_set && is_mono_col) ++mono_counter;
+    
+    for (size_t rel_col_idx = read_start; rel_col_idx < read_start + read_length; ++rel_col_idx) {
+        const auto base_col_idx = rel_col_idx + base_start_index();
+        
+        // Monotone columns are removed, so each column moves left by the monotone columns before it
+        if (base_block()->is_monotone(base_col_idx)) continue;
+        
+        // Each element is a gap unless the read has a call at the column
+        const auto col_idx = column(base_col_idx);
+        _data.set(offset++, TWO);
+        
+        if (num_elements++ == 0) _read_info[_rows].set_start_index(col_idx);
         
         // Check to see if the column is NIH
-        if (!is_mono_col && !base_block()->is_intrin_hetro(base_col_idx)) 
-            _snp_info[col_idx].set_type(NIH);
-    
-        // Check what value to add to the data
-        if (base_elem_val == 0 && !is_mono_col) {
-            _data.set(offset++, ZERO);
-            set_col_params(col_idx, _rows, ZERO);
-            ++num_elements;
-        } else if (base_elem_val == 1 && !is_mono_col) {
-            _data.set(offset++, ONE);
-            set_col_params(col_idx, _rows, ONE);
-            ++num_elements;
-        } else if (base_elem_val == 2 && !is_mono_col) {
-            _data.set(offset++, TWO);
-            ++num_elements;
-        }
+        if (!base_block()->is_intrin_hetro(base_col_idx)) _snp_info[col_idx].set_type(NIH);
     }
+    
+    // Only the calls are copied, so the reads of a sparse block are never unpacked
+    base_block()->for_each_call(base_row_idx, [&](const size_t base_col_idx, const uint8_t value)
+    {
+        if (base_block()->is_monotone(base_col_idx)) return;
+        const auto col_idx = column(base_col_idx);
+        _data.set(first + col_idx - _read_info[_rows].start_index(), value);
+        set_col_params(col_idx, _rows, value);
+    });
     // Set the end index
     _read_info[_rows].set_end_index(_read_info[_rows].start_index() + num_elements - 1);
     
@@ -406,7 +882,7 @@ template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY>
 void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::process_snps()
 {
     // Create a column processor to operate on the columns of the sub-block,
-    // finding duplicate columns and determining the haplotype links
+    // finding duplicate columns and determining the haplotype links -- it compares the column major data
     Processor<sub_block_type, proc::col_dups, devices::cpu> col_processor(*this); 
     
     // Start from the last column and go backwards 
@@ -420,6 +896,73 @@ void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::process_snps()
     }
 }
 
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+std::vector<size_t> SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::count_informative() const
+{
+    std::vector<size_t> informative(_rows, 0);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, _rows),
+        [&](const tbb::blocked_range<size_t>& rows)
+        {
+            for (size_t row_idx = rows.begin(); row_idx != rows.end(); ++row_idx) {
+                for (size_t col_idx = _read_info[row_idx].start_index(); 
+                     col_idx <= _read_info[row_idx].end_index(); ++col_idx) {
+                    if (operator()(row_idx, col_idx) <= ONE) ++informative[row_idx];
+                }
+            }
+        }
+    );
+    return informative;
+}
+
+template <typename BaseBlock, size_t ThreadsX, size_t ThreadsY> 
+void SubBlock<BaseBlock, ThreadsX, ThreadsY, devices::cpu>::find_components()
+{
+    // Number of informative (0 or 1) values of each read, unselected reads are treated as having none
+    auto informative = count_informative();
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) 
+        if (!_selected_reads[row_idx]) informative[row_idx] = 0;
+    
+    // Union-find over the reads, with path halving
+    std::vector<size_t> parents(_rows);
+    std::iota(parents.begin(), parents.end(), 0);
+    auto find_root = [&](size_t row_idx) 
+    {
+        while (parents[row_idx] != row_idx) {
+            parents[row_idx] = parents[parents[row_idx]];
+            row_idx          = parents[row_idx];
+        }
+        return row_idx;
+    };
+    
+    // Join all the reads with a value in each column -- the snp info gives the range of the rows
+    for (size_t col_idx = 0; col_idx < _cols; ++col_idx) {
+        if (_duplicate_cols.find(col_idx) != _duplicate_cols.end() || 
+            _snp_info.find(col_idx)       == _snp_info.end()        ) continue;
+        
+        const auto& snp_info = _snp_info[col_idx];
+        size_t      root     = NO_COMPONENT;
+        for (size_t row_idx = snp_info.start_index(); 
+             row_idx <= snp_info.end_index() && row_idx < _rows; ++row_idx) {
+            if (informative[row_idx] < 2 || operator()(row_idx, col_idx) > ONE) continue;
+            
+            const size_t row_root = find_root(row_idx);
+            if (root == NO_COMPONENT)  root = row_root;
+            else if (row_root != root) parents[std::max(root, row_root)] = std::min(root, row_root);
+            root = std::min(root, row_root);
+        }
+    }
+    
+    // Number the components in the order of their first read 
+    _read_components.assign(_rows, NO_COMPONENT);
+    _num_components = 0;
+    for (size_t row_idx = 0; row_idx < _rows; ++row_idx) {
+        if (informative[row_idx] < 2) continue;
+        const size_t root = find_root(row_idx);
+        _read_components[row_idx] = root == row_idx ? _num_components++ : _read_components[root];
+    }
+}
+
 }               // End namespace haplo
 #endif          // PARAHAPLO_SUB_BLOCK_CPU_HPP
 
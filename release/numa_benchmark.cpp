@@ -0,0 +1,122 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   numa_benchmark.cpp
+/// @brief  Benchmark for the NUMA placement of a block -- the share of the data pages which the sub-blocks
+///         read from a node other than the one which solved them, and the time to solve the block, without
+///         and with placement
+// ----------------------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+#include <unistd.h>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/dispatcher.hpp"
+
+using namespace std::chrono;
+
+using block_type    = haplo::Block<1 << 20, 4, 4>;
+using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+static constexpr const char* input  = "geraci_0.1/700_10_0.1_0.4/output_1_188068.txt";
+
+// ----------------------------------------------------------------------------------------------------------
+/// @brief      Gets the share of the data pages of the rows of the solved sub-blocks which aren't on the node
+///             that actually solved them, which is the node of the cpu the dispatcher recorded for each. The
+///             pages and nodes which aren't known aren't counted
+/// @param[in]  block       The block to get the share for
+/// @param[in]  nodes       The nodes of the system
+/// @param[in]  dispatcher  The dispatcher which solved the block
+// ----------------------------------------------------------------------------------------------------------
+double remote_share(const block_type& block, const haplo::NumaNodes& nodes, 
+                    const haplo::Dispatcher<subblock_type>& dispatcher)
+{
+    const uintptr_t page     = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const size_t    elements = block_type::data_container::elements_per_word;
+    size_t          remote   = 0, total = 0;
+
+    // A sparse block has no packed data to place
+    if (block.is_sparse()) return 0.0;
+    for (const auto& record : dispatcher.records()) {
+        if (record.node == haplo::NumaNodes::NO_NODE) continue;
+        const size_t i = record.index;
+
+        // The pages of the rows of the sub-block
+        std::set<uintptr_t> pages;
+        for (const auto row_idx : block.read_index().within(block.subblock(i), block.subblock(i + 1))) {
+            const auto      read_info = block.read_info(row_idx);
+            const auto      words     = block.data().words();
+            const uintptr_t first     = reinterpret_cast<uintptr_t>(words + read_info.offset() / elements);
+            const uintptr_t last      = reinterpret_cast<uintptr_t>(
+                                            words + (read_info.offset() + read_info.length()) / elements);
+            for (uintptr_t address = first / page * page; address <= last; address += page) 
+                pages.insert(address);
+        }
+
+        for (const auto address : pages) {
+            const size_t node = nodes.node_of(reinterpret_cast<const void*>(address));
+            if (node == haplo::NumaNodes::NO_NODE) continue;
+            remote += node != record.node;
+            ++total;
+        }
+    }
+    return total == 0 ? 0.0 : static_cast<double>(remote) / static_cast<double>(total);
+}
+
+// ----------------------------------------------------------------------------------------------------------
+/// @brief      Gets the number of sub-blocks which weren't solved on the node they were placed on
+/// @param[in]  block       The block which was solved
+/// @param[in]  dispatcher  The dispatcher which solved the block
+// ----------------------------------------------------------------------------------------------------------
+size_t moved_subblocks(const block_type& block, const haplo::Dispatcher<subblock_type>& dispatcher)
+{
+    size_t moved = 0;
+    for (const auto& record : dispatcher.records()) 
+        moved += record.node != block.subblock_node(record.index);
+    return moved;
+}
+
+// ----------------------------------------------------------------------------------------------------------
+/// @brief      Solves a block and gets the time it took
+/// @param[in]  block       The block to solve
+/// @param[in]  dispatcher  The dispatcher to solve the block with
+// ----------------------------------------------------------------------------------------------------------
+double solve_time(block_type& block, haplo::Dispatcher<subblock_type>& dispatcher)
+{
+    const auto start = high_resolution_clock::now();
+    dispatcher.solve_block(block);
+    return duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    const char*            input_file = argc > 1 ? argv[1] : input;
+    const haplo::NumaNodes nodes;
+    std::cout << "nodes : " << nodes.size() << (nodes.is_numa() ? "" : " (no numa support)") << "\n";
+
+    // The blocks are large, so they go on the heap
+    std::unique_ptr<block_type> unplaced(new block_type(input_file)), placed(new block_type(input_file));
+    placed->place(nodes);
+
+    // The locality is measured against the node each sub-block was solved on, so they're solved first
+    haplo::Dispatcher<subblock_type> unplaced_dispatcher, placed_dispatcher;
+    const double unplaced_time = solve_time(*unplaced, unplaced_dispatcher);
+    const double placed_time   = solve_time(*placed  , placed_dispatcher  );
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "remote pages without placement : " << remote_share(*unplaced, nodes, unplaced_dispatcher) 
+              << "\n"
+              << "remote pages with placement    : " << remote_share(*placed  , nodes, placed_dispatcher  ) 
+              << "\n"
+              << "sub-blocks off their node      : " << moved_subblocks(*placed, placed_dispatcher) 
+              << " of " << placed_dispatcher.records().size() << "\n"
+              << "solve time without placement   : " << unplaced_time << "s\n"
+              << "solve time with placement      : " << placed_time   << "s\n";
+
+    // With a single node every page is local, so the shares say nothing about placement
+    if (!nodes.is_numa()) 
+        std::cout << "(one node : the remote shares are not a measurement of placement)\n";
+}
@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   batch_evaluator_tests.cpp
+/// @brief  Test suite for parahaplo bit-sliced batch evaluator tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE BatchEvaluatorTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/batch_evaluator.hpp"
+
+#include <random>
+
+static constexpr const char* input_six   = "input_files/input_six.txt";
+static constexpr const char* input_seven = "input_files/input_seven.txt";
+
+// Scalar MEC score of a single candidate to check the bit-sliced scores against
+template <typename SubBlockType>
+size_t scalar_mec_score(SubBlockType& sub_block, const std::vector<uint8_t>& haplo_one,
+                        const std::vector<uint8_t>& haplo_two                          )
+{
+    size_t mec_score = 0;
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto& read_info = sub_block.read_info()[read_idx];
+        size_t mismatches_one = 0, mismatches_two = 0;
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+            const auto value = sub_block(read_idx, snp_idx);
+            if (value > 1) continue;
+            if (value != haplo_one[snp_idx]) ++mismatches_one;
+            if (value != haplo_two[snp_idx]) ++mismatches_two;
+        }
+        mec_score += std::min(mismatches_one, mismatches_two);
+    }
+    return mec_score;
+}
+
+BOOST_AUTO_TEST_SUITE( BatchEvaluatorSuite )
+
+BOOST_AUTO_TEST_CASE( canEvaluateKnownCandidates )
+{
+    using block_type      = haplo::Block<27, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using evaluator_type  = haplo::BatchEvaluator<subblock_type>;
+
+    block_type      block(input_seven);
+    subblock_type   sub_block(block, 1);
+    evaluator_type  evaluator(sub_block);
+
+    const size_t snps = evaluator.snps();
+    evaluator_type::word_container  haplo_one(snps, 0), haplo_two(snps, 0);
+    evaluator_type::index_container mec_scores;
+
+    // Candidate 1 matches all the reads, candidate 0 (all zeros) mismatches the ones in each read
+    std::vector<uint8_t> zeros(snps, 0), ones(snps, 1);
+    evaluator_type::set_candidate(haplo_two, 1, ones);
+    evaluator.evaluate(haplo_one, haplo_two, mec_scores);
+
+    BOOST_CHECK( mec_scores.size() == evaluator_type::LANES                         );
+    BOOST_CHECK( mec_scores[0]     == scalar_mec_score(sub_block, zeros, zeros)     );
+    BOOST_CHECK( mec_scores[1]     == 0                                             );
+    BOOST_CHECK( mec_scores[1]     == scalar_mec_score(sub_block, zeros, ones)      );
+}
+
+BOOST_AUTO_TEST_CASE( canEvaluateRandomCandidates )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using evaluator_type  = haplo::BatchEvaluator<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    evaluator_type  evaluator(sub_block);
+
+    const size_t snps = evaluator.snps();
+    evaluator_type::word_container  haplo_one(snps, 0), haplo_two(snps, 0);
+    evaluator_type::index_container mec_scores;
+
+    std::mt19937 generator(13);
+    std::bernoulli_distribution distribution(0.5);
+    std::vector<std::vector<uint8_t>> ones(evaluator_type::LANES), twos(evaluator_type::LANES);
+    for (size_t candidate = 0; candidate < evaluator_type::LANES; ++candidate) {
+        for (size_t i = 0; i < snps; ++i) {
+            ones[candidate].push_back(distribution(generator));
+            twos[candidate].push_back(distribution(generator));
+        }
+        evaluator_type::set_candidate(haplo_one, candidate, ones[candidate]);
+        evaluator_type::set_candidate(haplo_two, candidate, twos[candidate]);
+    }
+
+    evaluator.evaluate(haplo_one, haplo_two, mec_scores);
+
+    for (size_t candidate = 0; candidate < evaluator_type::LANES; ++candidate) 
+        BOOST_CHECK( mec_scores[candidate] == scalar_mec_score(sub_block, ones[candidate], twos[candidate]) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,8 @@ using namespace std::chrono;
 
 static constexpr const char* input_1      = "input_files/input_zero.txt";
 static constexpr const char* input_6      = "input_files/input_six.txt";
+static constexpr const char* input_8      = "input_files/input_eight.txt";
+static constexpr const char* input_9      = "input_files/input_nine.txt";
 static constexpr const char* input_7      = "tests_files/output_7.txt";
 static constexpr const char* input_test_1 = "tests_files/output_1.txt";     // 1543 elements
 
@@ -46,6 +48,134 @@ BOOST_AUTO_TEST_CASE( canCreateABlockAndGetData )
     BOOST_CHECK( block(9, 11) == 1 );
 }
 
+BOOST_AUTO_TEST_CASE( canStoreReadInformationCompactly )
+{
+    using block_type = haplo::Block<28>; 
+    
+    block_type block(input_1);
+    
+    // The reads are 0 1 11 / 1 2 00 / 1 3 100 / ... / 4 11 0--101-1
+    BOOST_CHECK( block.read_info(0).start_index() == 0  );
+    BOOST_CHECK( block.read_info(2).end_index()   == 3  );
+    BOOST_CHECK( block.read_info(2).offset()      == 4  );
+    BOOST_CHECK( block.read_info(8).length()      == 8  );
+    BOOST_CHECK( block.read_info(8).element_exists(11) == true  );
+    BOOST_CHECK( block.read_info(8).element_exists(3)  == false );
+    
+    // A table of reads takes 12 bytes a read with 32 bit offsets
+    haplo::ReadTable<> table;
+    for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) table.push_back(block.read_info(row_idx));
+    BOOST_CHECK( table.bytes() == block.reads() * 12 );
+    
+    table[1].set_end_index(5);
+    BOOST_CHECK( table[1].length()          == 5 );
+    BOOST_CHECK( table.end_indices()[1]     == 5 );
+    BOOST_CHECK( table.start_indices()[2]   == 1 );
+    
+    // An offset which doesn't fit the offset type isn't truncated
+    haplo::ReadTable<uint8_t> small_table;
+    BOOST_CHECK_NO_THROW( small_table.push_back(haplo::ReadInfo(0, 0, 3, 255)) );
+    BOOST_CHECK_THROW( small_table.push_back(haplo::ReadInfo(1, 0, 3, 256)), std::overflow_error );
+    BOOST_CHECK( small_table.size() == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( canStoreSparseReadsAsCalls )
+{
+    using block_type = haplo::Block<800, 4, 4>;
+    
+    // Each read spans all 20 columns and has a single call, at column row % 20
+    block_type sparse_block(input_9);
+    block_type dense_block(input_1);
+    
+    BOOST_CHECK( sparse_block.is_sparse()             == true  );
+    BOOST_CHECK( dense_block.is_sparse()              == false );
+    BOOST_CHECK( sparse_block.sparse_reads().calls()  == 40    );
+    
+    for (size_t row_idx = 0; row_idx < sparse_block.reads(); ++row_idx) {
+        for (size_t col_idx = 0; col_idx < 20; ++col_idx) {
+            const uint8_t expected = col_idx == row_idx % 20 ? row_idx / 20 : 2;
+            BOOST_CHECK( sparse_block(row_idx, col_idx) == expected );
+        }
+        size_t calls = 0;
+        sparse_block.for_each_call(row_idx, [&](const size_t col_idx, const uint8_t value) 
+        {
+            BOOST_CHECK( col_idx == row_idx % 20 ); BOOST_CHECK( value == row_idx / 20 ); ++calls;
+        });
+        BOOST_CHECK( calls == 1 );
+    }
+    
+    // The dense block gives the same calls through the same interface
+    std::vector<size_t> cols;
+    dense_block.for_each_call(8, [&](const size_t col_idx, const uint8_t) { cols.push_back(col_idx); });
+    BOOST_CHECK( cols == std::vector<size_t>({4, 7, 8, 9, 11}) );
+}
+
+BOOST_AUTO_TEST_CASE( canBuildViewsAndSubBlocksFromSparseCalls )
+{
+    using block_type    = haplo::Block<800, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    // The sparse block has no packed data, so everything is built from its calls
+    block_type            block(input_9);
+    haplo::ReadTable<>    table;
+    for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) table.push_back(block.read_info(row_idx));
+    
+    const auto columns = haplo::ColumnView::from_calls(block, table, block.reads(), 20);
+    const auto planes  = block.allele_planes();
+    for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) {
+        BOOST_CHECK( planes.calls(row_idx) == 1 );
+        for (size_t col_idx = 0; col_idx < 20; ++col_idx) 
+            BOOST_CHECK( columns(row_idx, col_idx) == block(row_idx, col_idx) );
+    }
+    
+    subblock_type sub_block(block, block.num_subblocks() - 2);
+    BOOST_CHECK( sub_block.reads() == block.reads() );
+    for (size_t row_idx = 0; row_idx < sub_block.reads(); ++row_idx) {
+        for (size_t col_idx = 0; col_idx < 20; ++col_idx)
+            BOOST_CHECK( sub_block(row_idx, col_idx) == block(row_idx, col_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canFindTheReadsCoveringColumns )
+{
+    using block_type = haplo::Block<148, 4, 4>;
+    
+    block_type  block(input_8);
+    const auto& index = block.read_index();
+    const auto  cols  = block.subblock(block.num_subblocks() - 1) + 1;
+    
+    BOOST_CHECK( index.size() == block.reads() );
+    
+    // Each query finds the same reads as checking every read
+    std::vector<tbb::atomic<size_t>> batch_counts(cols);
+    index.for_each_covering(0, cols - 1, [&](const size_t col_idx, const size_t) { ++batch_counts[col_idx]; });
+    const auto counts = index.coverage(0, cols - 1);
+    
+    for (size_t col_idx = 0; col_idx < cols; ++col_idx) {
+        std::vector<size_t> expected, found;
+        bool spanned = false;
+        for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) {
+            const auto read = block.read_info(row_idx);
+            if (read.element_exists(col_idx)) expected.push_back(row_idx);
+            if (read.start_index() < col_idx && read.end_index() > col_idx) spanned = true;
+        }
+        index.for_each_covering(col_idx, [&](const size_t row_idx) { found.push_back(row_idx); });
+        std::sort(found.begin(), found.end());
+        
+        BOOST_CHECK( found                  == expected        );
+        BOOST_CHECK( counts[col_idx]        == expected.size() );
+        BOOST_CHECK( batch_counts[col_idx]  == expected.size() );
+        BOOST_CHECK( index.is_spanned(col_idx) == spanned      );
+    }
+    
+    // The reads within a range are in ascending order
+    std::vector<size_t> expected;
+    for (size_t row_idx = 0; row_idx < block.reads(); ++row_idx) 
+        if (block.read_info(row_idx).start_index() >= 10 && block.read_info(row_idx).end_index() <= 20)
+            expected.push_back(row_idx);
+    BOOST_CHECK( index.within(10, 20) == expected );
+}
+
 BOOST_AUTO_TEST_CASE( canDetermineMonotoneColumns )
 {
     // Define for 28 elements with 4 cores for each dimension
@@ -67,6 +197,31 @@ BOOST_AUTO_TEST_CASE( canDetermineMonotoneColumns )
     BOOST_CHECK( block.is_monotone(11) == false ); 
 }
 
+BOOST_AUTO_TEST_CASE( canMapColumnsWithoutTheMonotoneColumns )
+{
+    using block_type = haplo::Block<28, 4, 4>; 
+    
+    block_type  block(input_1);    
+    const auto& informative = block.informative_cols();
+    
+    // Columns 0, 5, 6, 8 and 9 are monotone
+    BOOST_CHECK( informative.count()  == 7  );
+    BOOST_CHECK( informative.rank(5)  == 4  );
+    BOOST_CHECK( informative.rank(12) == 7  );
+    BOOST_CHECK( informative.select(0) == 1  );
+    BOOST_CHECK( informative.select(4) == 7  );
+    BOOST_CHECK( informative.select(6) == 11 );
+    
+    // Over many words, select is the inverse of rank for the set bits
+    haplo::RankSelect bits(1000, [](const size_t i) { return i % 7 == 0 || (i > 300 && i < 500); });
+    size_t set = 0;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        BOOST_CHECK( bits.rank(i) == set );
+        if (bits.get(i)) BOOST_CHECK( bits.select(set++) == i );
+    }
+    BOOST_CHECK( bits.count() == set );
+}
+
 BOOST_AUTO_TEST_CASE( canDetermineSplittableColumns )
 {
     using block_type = haplo::Block<28, 4, 4>;
@@ -80,4 +235,21 @@ BOOST_AUTO_TEST_CASE( canDetermineSplittableColumns )
     BOOST_CHECK( block.subblock(3)     == 11 );
 }
 
+BOOST_AUTO_TEST_CASE( canSplitWeakLinks )
+{
+    using block_type = haplo::Block<148, 4, 4>;
+    
+    block_type block(input_8);
+    
+    // Column 15 is spanned by 2 reads, and all the others by more
+    BOOST_CHECK( block.num_subblocks()     == 3     );
+    BOOST_CHECK( block.split_weak_links(1) == 0     );
+    BOOST_CHECK( block.split_weak_links(2) == 1     );
+    BOOST_CHECK( block.num_subblocks()     == 4     );
+    BOOST_CHECK( block.subblock(2)         == 15    );
+    BOOST_CHECK( block.subblock(3)         == 29    );
+    BOOST_CHECK( block.is_weak_link(15)    == true  );
+    BOOST_CHECK( block.is_weak_link(29)    == false );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,497 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   dispatcher_tests.cpp
+/// @brief  Test suite for parahaplo exact solver and engine dispatcher tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE DispatcherTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/dispatcher.hpp"
+
+static constexpr const char* input_zero  = "input_files/input_zero.txt";
+static constexpr const char* input_six   = "input_files/input_six.txt";
+static constexpr const char* input_seven = "input_files/input_seven.txt";
+static constexpr const char* input_eight = "input_files/input_eight.txt";
+static constexpr const char* input_eleven = "input_files/input_eleven.txt";
+static constexpr const char* input_twelve = "input_files/input_twelve.txt";
+static constexpr const char* input_thirteen = "input_files/input_thirteen.txt";
+
+BOOST_AUTO_TEST_SUITE( DispatcherSuite )
+
+BOOST_AUTO_TEST_CASE( exactSolversFindTheSameScore )
+{
+    using block_type    = haplo::Block<28, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    block_type block(input_zero);
+    const size_t mec_scores[3] = { 1, 0, 1 };
+
+    for (size_t i = 0; i < 3; ++i) {
+        subblock_type sub_block_one(block, i), sub_block_two(block, i);
+        haplo::BruteForce<subblock_type> brute_force(sub_block_one);
+        haplo::ColumnDp<subblock_type>   exact(sub_block_two);
+
+        brute_force.search();
+        exact.search();
+
+        BOOST_CHECK( brute_force.mec_score() == mec_scores[i] );
+        BOOST_CHECK( exact.mec_score()       == mec_scores[i] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canChooseEngines )
+{
+    using block_type      = haplo::Block<27, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_seven);
+    subblock_type   single_column(block, 0), small(block, 1);
+    dispatcher_type dispatcher, no_brute_force(0);
+
+    BOOST_CHECK( dispatcher.choose(single_column)       == haplo::engines::trivial     );
+    BOOST_CHECK( dispatcher.choose(small)               == haplo::engines::brute_force );
+    BOOST_CHECK( no_brute_force.choose(small)           == haplo::engines::exact       );
+    BOOST_CHECK( dispatcher_type::max_coverage(small)   == 5                           );
+
+    BOOST_CHECK( dispatcher.solve(single_column)        == 0 );
+    BOOST_CHECK( dispatcher.solve(small)                == 0 );
+    BOOST_CHECK( no_brute_force.solve(small)            == 0 );
+
+    BOOST_CHECK( dispatcher.records().size()            == 2                           );
+    BOOST_CHECK( dispatcher.records()[1].index          == 1                           );
+    BOOST_CHECK( dispatcher.records()[1].engine         == haplo::engines::brute_force );
+    BOOST_CHECK( no_brute_force.records()[0].engine     == haplo::engines::exact       );
+    for (size_t i = 0; i < small.snp_info().size(); ++i) 
+        BOOST_CHECK( small.haplo_one().get(i) != small.haplo_two().get(i) );
+}
+
+BOOST_AUTO_TEST_CASE( trivialSolverMatchesBruteForce )
+{
+    using block_type      = haplo::Block<18, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    // The first column has three 1's and a 0, so the majority is 1 but the brute force keeps the first of the
+    // candidates which match all the reads
+    block_type      block(input_eleven);
+    subblock_type   trivial(block, 0), brute_force(block, 0);
+    dispatcher_type dispatcher;
+    BOOST_CHECK( dispatcher.choose(trivial) == haplo::engines::trivial );
+
+    haplo::BruteForce<subblock_type> solver(brute_force);
+    solver.search();
+    
+    BOOST_CHECK( dispatcher.solve(trivial)         == solver.mec_score()         );
+    BOOST_CHECK( dispatcher.records()[0].mec_score == 0                          );
+    BOOST_CHECK( trivial.haplo_one().get(0)        == brute_force.haplo_one().get(0) );
+    BOOST_CHECK( trivial.haplo_two().get(0)        == brute_force.haplo_two().get(0) );
+}
+
+BOOST_AUTO_TEST_CASE( canChooseHeuristicEngines )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    dispatcher_type dispatcher, multilevel(BRUTE_FORCE_BITS, EXACT_COVERAGE, 100);
+
+    BOOST_CHECK( dispatcher.choose(sub_block) == haplo::engines::graph      );
+    BOOST_CHECK( multilevel.choose(sub_block) == haplo::engines::multilevel );
+    BOOST_CHECK( dispatcher.solve(sub_block)  <  sub_block.size()           );
+    BOOST_CHECK( dispatcher.records()[0].seconds >= 0.0                     );
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithBudget )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block_one(block, 1), sub_block_two(block, 1);
+    dispatcher_type dispatcher;
+    
+    // The graph search stops at the deadline, but still has a solution
+    haplo::Budget no_time(0.0, 0.0);
+    BOOST_CHECK( dispatcher.solve(sub_block_one, &no_time) < sub_block_one.size() );
+    BOOST_CHECK( dispatcher.records()[0].at_budget                                );
+    BOOST_CHECK( dispatcher.at_budget().size() == 1                               );
+    BOOST_CHECK( dispatcher.at_budget()[0]     == 1                               );
+    BOOST_CHECK( no_time.hit_sub_blocks().size() == 1                             );
+
+    // Without a budget the sub-block is never at its limit
+    dispatcher.solve(sub_block_two);
+    BOOST_CHECK( !dispatcher.records()[1].at_budget                               );
+    BOOST_CHECK( dispatcher.at_budget().size() == 1                               );
+}
+
+BOOST_AUTO_TEST_CASE( enginesStopAtTheBudget )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block_one(block, 1), sub_block_two(block, 1);
+    dispatcher_type exact(0, 1000), multilevel(0, 0, 0);
+    BOOST_CHECK( exact.choose(sub_block_one)      == haplo::engines::exact      );
+    BOOST_CHECK( multilevel.choose(sub_block_two) == haplo::engines::multilevel );
+
+    // The exact search can't be covered by no time, so the graph search solves the sub-block instead
+    haplo::Budget no_time(0.0, 0.0);
+    BOOST_CHECK( exact.solve(sub_block_one, &no_time) < sub_block_one.size()    );
+    BOOST_CHECK( exact.records()[0].engine == haplo::engines::graph             );
+    BOOST_CHECK( exact.records()[0].at_budget                                   );
+
+    // The multilevel search stops refining, but still has a solution
+    BOOST_CHECK( multilevel.solve(sub_block_two, &no_time) < sub_block_two.size() );
+    BOOST_CHECK( multilevel.records()[0].engine == haplo::engines::multilevel     );
+    BOOST_CHECK( multilevel.records()[0].at_budget                                );
+    BOOST_CHECK( no_time.hit_sub_blocks().size() == 2                             );
+
+    // A small exact search fits in the time
+    using small_block_type    = haplo::Block<28, 4, 4>;
+    using small_subblock_type = haplo::SubBlock<small_block_type, 4, 4, haplo::devices::cpu>;
+
+    small_block_type                        small_block(input_zero);
+    small_subblock_type                     small_sub_block(small_block, 0);
+    haplo::Dispatcher<small_subblock_type>  small_exact(0, 1000);
+    haplo::Budget                           plenty(1000.0, 1000.0);
+    BOOST_CHECK( small_exact.solve(small_sub_block, &plenty) == 1               );
+    BOOST_CHECK( small_exact.records()[0].engine == haplo::engines::exact       );
+    BOOST_CHECK( !small_exact.records()[0].at_budget                            );
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithCappedCoverage )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block_one(block, 1), sub_block_two(block, 1);
+    dispatcher_type uncapped(0), capped(0, EXACT_COVERAGE, MULTILEVEL_READS, 0, 2);
+
+    // The cap brings the coverage of the selected reads down far enough for the exact solver -- it caps the
+    // values in a column, the reads which span a column can have gaps there
+    BOOST_CHECK( uncapped.choose(sub_block_one) != haplo::engines::exact );
+    const size_t mec_score = capped.solve(sub_block_two);
+    BOOST_CHECK( sub_block_two.discarded_reads() > 0                                        );
+    BOOST_CHECK( dispatcher_type::max_coverage(sub_block_two) <= EXACT_COVERAGE             );
+    BOOST_CHECK( dispatcher_type::max_coverage(sub_block_two) <  sub_block_two.reads()      );
+    BOOST_CHECK( capped.records()[0].engine == haplo::engines::exact                        );
+
+    // The discarded reads are placed against the haplotypes, and the score is for all the reads
+    size_t all_reads_score = 0;
+    for (size_t read_idx = 0; read_idx < sub_block_two.reads(); ++read_idx) {
+        const auto& read_info = sub_block_two.read_info()[read_idx];
+        size_t conflicts_one = 0, conflicts_two = 0;
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+            const auto value = sub_block_two(read_idx, snp_idx);
+            if (value > 1) continue;
+            conflicts_one += value != sub_block_two.haplo_one().get(snp_idx);
+            conflicts_two += value != sub_block_two.haplo_two().get(snp_idx);
+        }
+        all_reads_score += std::min(conflicts_one, conflicts_two);
+    }
+    BOOST_CHECK( mec_score == all_reads_score       );
+    BOOST_CHECK( mec_score <  sub_block_two.size()  );
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithFilteredColumns )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    dispatcher_type dispatcher(BRUTE_FORCE_BITS, EXACT_COVERAGE, MULTILEVEL_READS, 2);
+    
+    const size_t cols = sub_block.snp_info().size();
+    
+    // The columns are restored once the sub-block is solved, so the score is for all of them
+    const size_t mec_score = dispatcher.solve(sub_block);
+    BOOST_CHECK( sub_block.filtered()        == false    );
+    BOOST_CHECK( sub_block.snp_info().size() == cols     );
+    BOOST_CHECK( mec_score                   <  sub_block.size() );
+    
+    size_t conflicts = 0;
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto& read_info = sub_block.read_info()[read_idx];
+        size_t      errors[2] = {0, 0};
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+            const auto value = sub_block(read_idx, col_idx);
+            if (value > 1) continue;
+            errors[0] += value != sub_block.haplo_one().get(col_idx);
+            errors[1] += value != sub_block.haplo_two().get(col_idx);
+        }
+        conflicts += std::min(errors[0], errors[1]);
+    }
+    BOOST_CHECK( mec_score == conflicts );
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithClusteredReads )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type      block(input_six);
+    subblock_type   unclustered(block, 1), clustered(block, 1);
+
+    // No brute force or exact solves, so both use the multilevel search, and only one clusters the reads
+    dispatcher_type plain(0, 0, 0), clustering(0, 0, 0, 0, 0, true, 1);
+    plain.solve(unclustered);
+    const size_t    mec_score = clustering.solve(clustered);
+
+    BOOST_CHECK( clustering.records()[0].engine == haplo::engines::multilevel );
+    BOOST_CHECK( clustered.num_clusters()       <  clustered.reads()          );
+    BOOST_CHECK( unclustered.num_clusters()     == unclustered.reads()        );
+    
+    // The clusters are solved together, but the score is for each read
+    size_t conflicts = 0;
+    for (size_t read_idx = 0; read_idx < clustered.reads(); ++read_idx) {
+        const auto& read_info = clustered.read_info()[read_idx];
+        size_t      errors[2] = {0, 0};
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+            const auto value = clustered(read_idx, col_idx);
+            if (value > 1) continue;
+            errors[0] += value != clustered.haplo_one().get(col_idx);
+            errors[1] += value != clustered.haplo_two().get(col_idx);
+        }
+        conflicts += std::min(errors[0], errors[1]);
+    }
+    BOOST_CHECK( mec_score == conflicts          );
+    BOOST_CHECK( mec_score <  clustered.size()   );
+}
+
+BOOST_AUTO_TEST_CASE( exactSolversScoreClustersTogether )
+{
+    using block_type      = haplo::Block<80, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using dispatcher_type = haplo::Dispatcher<subblock_type>;
+
+    block_type    block(input_thirteen);
+    subblock_type unclustered(block, 1);
+    haplo::ColumnDp<subblock_type> unclustered_exact(unclustered);
+    unclustered_exact.search();
+
+    // Each cluster is a single state of the exact solver, and both exact solvers keep its reads together --
+    // duplicate reads always fit the same haplotype, so clustering them doesn't change the best score
+    for (size_t distance = 0; distance < 2; ++distance) {
+        subblock_type sub_block_one(block, 1), sub_block_two(block, 1);
+        sub_block_one.cluster_reads(distance); sub_block_two.cluster_reads(distance);
+        haplo::BruteForce<subblock_type> brute_force(sub_block_one);
+        haplo::ColumnDp<subblock_type>   exact(sub_block_two);
+
+        BOOST_CHECK( exact.max_coverage() <  unclustered_exact.max_coverage()         );
+        BOOST_CHECK( exact.max_coverage() == dispatcher_type::max_coverage(sub_block_two) );
+
+        brute_force.search();
+        exact.search();
+        BOOST_CHECK( brute_force.mec_score() == exact.mec_score() );
+        if (distance == 0) BOOST_CHECK( exact.mec_score() == unclustered_exact.mec_score() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveBlockAcrossWeakLinks )
+{
+    using block_type    = haplo::Block<148, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    block_type block(input_eight);
+    BOOST_CHECK( block.split_weak_links(2) == 1 );
+
+    haplo::Dispatcher<subblock_type> dispatcher;
+    dispatcher.solve_block(block);
+    BOOST_CHECK( dispatcher.records().size() == 3 );
+
+    // The reads have no errors, so the sub-blocks are only stitched correctly if every read matches
+    size_t mec_score = 0;
+    for (size_t read_idx = 0; read_idx < block.reads(); ++read_idx) {
+        const auto& read_info = block.read_info(read_idx);
+        size_t      errors[2] = {0, 0};
+        for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx) {
+            const auto value = block(read_idx, col_idx);
+            if (value > 1) continue;
+            errors[0] += value != block.haplo_one().get(col_idx);
+            errors[1] += value != block.haplo_two().get(col_idx);
+        }
+        mec_score += std::min(errors[0], errors[1]);
+    }
+    BOOST_CHECK( mec_score == 0 );
+}
+
+BOOST_AUTO_TEST_CASE( canMergeSubBlocksInParallel )
+{
+    using block_type    = haplo::Block<148, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    // With and without weak links, merging all the sub-blocks at once is the same as merging them in order
+    for (const size_t max_bridging : { size_t(0), size_t(2) }) {
+        block_type block_one(input_eight), block_two(input_eight);
+        block_one.split_weak_links(max_bridging); block_two.split_weak_links(max_bridging);
+
+        haplo::Dispatcher<subblock_type>            dispatcher;
+        std::vector<std::unique_ptr<subblock_type>> sub_blocks(block_one.num_subblocks() - 1);
+        for (size_t i = 0; i < sub_blocks.size(); ++i) {
+            sub_blocks[i].reset(new subblock_type(block_one, i));
+            dispatcher.solve(*sub_blocks[i]);
+            block_one.merge_haplotype(*sub_blocks[i]);
+        }
+        block_two.merge_haplotypes(sub_blocks);
+
+        for (size_t col_idx = 0; col_idx < block_one.haplo_one().size(); ++col_idx) {
+            BOOST_CHECK( block_one.haplo_one().get(col_idx) == block_two.haplo_one().get(col_idx) );
+            BOOST_CHECK( block_one.haplo_two().get(col_idx) == block_two.haplo_two().get(col_idx) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( mergeFlipsOrSwapsSubBlocks )
+{
+    using block_type    = haplo::Block<49, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    // Columns 3 and 10 are NIH, and a single read bridges the weak link at column 9
+    block_type block_one(input_twelve), block_two(input_twelve);
+    BOOST_CHECK( block_one.split_weak_links(2) == 1 ); block_two.split_weak_links(2);
+    BOOST_CHECK( block_one.is_weak_link(9) );
+
+    haplo::Dispatcher<subblock_type>            dispatcher;
+    std::vector<std::unique_ptr<subblock_type>> sub_blocks(block_one.num_subblocks() - 1);
+    for (size_t i = 0; i < sub_blocks.size(); ++i) {
+        sub_blocks[i].reset(new subblock_type(block_one, i));
+        dispatcher.solve(*sub_blocks[i]);
+        block_one.merge_haplotype(*sub_blocks[i]);
+    }
+    block_two.merge_haplotypes(sub_blocks);
+
+    // The sub-block from column 3 disagrees with the one before it at the first column, so all its bits are
+    // flipped, including those of the NIH column
+    BOOST_CHECK( sub_blocks[2]->haplo_one().get(0) == 1 && sub_blocks[2]->haplo_two().get(0) == 1 );
+    BOOST_CHECK( block_one.haplo_one().get(3)      == 0 && block_one.haplo_two().get(3)      == 0 );
+
+    // The read across the weak link fits the other haplotype, so the haplotypes of the last sub-block are
+    // swapped, which keeps the values of the NIH column
+    const auto& last = *sub_blocks.back();
+    BOOST_CHECK( last.haplo_one().get(1)      == 1 && last.haplo_two().get(1)      == 1 );
+    BOOST_CHECK( block_one.haplo_one().get(10) == 1 && block_one.haplo_two().get(10) == 1 );
+    for (const size_t col_idx : { size_t(9), size_t(11), size_t(12) }) {
+        BOOST_CHECK( block_one.haplo_one().get(col_idx) == last.haplo_two().get(col_idx - 9) );
+        BOOST_CHECK( block_one.haplo_two().get(col_idx) == last.haplo_one().get(col_idx - 9) );
+    }
+
+    // Merging all the sub-blocks at once orients them the same way
+    for (size_t col_idx = 0; col_idx < block_one.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( block_one.haplo_one().get(col_idx) == block_two.haplo_one().get(col_idx) );
+        BOOST_CHECK( block_one.haplo_two().get(col_idx) == block_two.haplo_two().get(col_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveBlocksWithTheirOwnConcurrency )
+{
+    using block_type    = haplo::Block<148, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    // A block with two threads and a grain of 3, and one which can use all the threads
+    block_type block_one(input_eight, haplo::Concurrency(2, 3)), block_two(input_eight);
+    BOOST_CHECK( block_one.concurrency().threads() == 2 );
+    BOOST_CHECK( block_one.concurrency().grain()   == 3 );
+    BOOST_CHECK( block_two.concurrency().threads() == 0 );
+
+    // The sub-blocks share the concurrency of the block
+    subblock_type sub_block(block_one, 0);
+    BOOST_CHECK( sub_block.concurrency().threads() == 2 );
+
+    // The concurrency doesn't change the result
+    BOOST_CHECK( block_one.num_subblocks() == block_two.num_subblocks() );
+    block_one.split_weak_links(2); block_two.split_weak_links(2);
+
+    haplo::Dispatcher<subblock_type> dispatcher_one, dispatcher_two;
+    dispatcher_one.solve_block(block_one); dispatcher_two.solve_block(block_two);
+    BOOST_CHECK( dispatcher_one.records().size() == dispatcher_two.records().size() );
+    for (size_t col_idx = 0; col_idx < block_one.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( block_one.haplo_one().get(col_idx) == block_two.haplo_one().get(col_idx) );
+        BOOST_CHECK( block_one.haplo_two().get(col_idx) == block_two.haplo_two().get(col_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveBlocksPlacedOnNumaNodes )
+{
+    using block_type    = haplo::Block<148, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    block_type block_one(input_eight), block_two(input_eight);
+    BOOST_CHECK( block_one.nodes().size() == 1 );
+
+    // The rows are split between the nodes in order, and each node has some of them
+    block_one.place(haplo::NumaNodes(2));
+    BOOST_CHECK( block_one.nodes().size() == 2 );
+    BOOST_CHECK( block_one.row_node(0)                    == 0 );
+    BOOST_CHECK( block_one.row_node(block_one.reads() - 1) == 1 );
+    for (size_t row_idx = 1; row_idx < block_one.reads(); ++row_idx)
+        BOOST_CHECK( block_one.row_node(row_idx - 1) <= block_one.row_node(row_idx) );
+    for (size_t i = 0; i < block_one.num_subblocks() - 1; ++i) BOOST_CHECK( block_one.subblock_node(i) < 2 );
+
+    // Where the sub-blocks are solved doesn't change the result
+    haplo::Dispatcher<subblock_type> dispatcher_one, dispatcher_two;
+    dispatcher_one.solve_block(block_one); dispatcher_two.solve_block(block_two);
+    BOOST_CHECK( dispatcher_one.records().size() == dispatcher_two.records().size() );
+    for (const auto& record : dispatcher_one.records()) 
+        BOOST_CHECK( record.node < haplo::NumaNodes::system_nodes() );
+    for (size_t col_idx = 0; col_idx < block_one.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( block_one.haplo_one().get(col_idx) == block_two.haplo_one().get(col_idx) );
+        BOOST_CHECK( block_one.haplo_two().get(col_idx) == block_two.haplo_two().get(col_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( numaArenasRestoreAffinity )
+{
+    const haplo::NumaNodes numa_nodes(haplo::NumaNodes::system_nodes());
+#if NUMA_ENABLED
+    cpu_set_t before, after;
+    BOOST_REQUIRE( sched_getaffinity(0, sizeof(before), &before) == 0 );
+#endif
+    // The thread is bound to each node only while it's in the node's arena
+    for (size_t node = 0; node < numa_nodes.size(); ++node) {
+        numa_nodes.execute(node, [&]
+        {
+            if (numa_nodes.is_numa()) BOOST_CHECK( haplo::NumaNodes::current_node() == node );
+        });
+    }
+#if NUMA_ENABLED
+    BOOST_REQUIRE( sched_getaffinity(0, sizeof(after), &after) == 0 );
+    BOOST_CHECK( CPU_EQUAL(&before, &after) );
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( numaArenasShareTheBlockThreads )
+{
+    using block_type    = haplo::Block<148, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+
+    // The nodes of a block with a thread limit split the threads, the others have their own
+    block_type block_one(input_eight, haplo::Concurrency(2)), block_two(input_eight);
+    block_one.place(haplo::NumaNodes(2)); block_two.place(haplo::NumaNodes(2));
+    BOOST_CHECK( block_one.nodes().size() == 2 );
+    BOOST_CHECK( block_one.nodes().slots(0) + block_one.nodes().slots(1) == 2 );
+
+    haplo::Dispatcher<subblock_type> dispatcher_one, dispatcher_two;
+    dispatcher_one.solve_block(block_one); dispatcher_two.solve_block(block_two);
+    BOOST_CHECK( dispatcher_one.records().size() == dispatcher_two.records().size() );
+    for (size_t col_idx = 0; col_idx < block_one.haplo_one().size(); ++col_idx) {
+        BOOST_CHECK( block_one.haplo_one().get(col_idx) == block_two.haplo_one().get(col_idx) );
+        BOOST_CHECK( block_one.haplo_two().get(col_idx) == block_two.haplo_two().get(col_idx) );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,253 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   graph_cpu_tests.cpp
+/// @brief  Test suite for parahaplo CPU graph search tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE GraphCpuTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/graph_cpu.hpp"
+
+static constexpr const char* input_six   = "input_files/input_six.txt";
+static constexpr const char* input_seven = "input_files/input_seven.txt";
+
+BOOST_AUTO_TEST_SUITE( GraphCpuSuite )
+
+BOOST_AUTO_TEST_CASE( canSolveSubBlock )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    graph_type      graph(sub_block);
+
+    graph.search();
+
+    BOOST_CHECK( graph.mec_score() < sub_block.size() );
+    BOOST_CHECK( graph.seed()      == 0               );
+
+    // The haplotypes must be different at all the IH snps
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( multipleStartsAreNoWorseAndReproducible )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    graph_type single_start(sub_block), multi_start(sub_block), multi_start_again(sub_block);
+    graph_type multi_start_threaded(sub_block);
+    
+    single_start.search();
+    multi_start.search(8, 7);
+    multi_start_again.search(8, 7);
+    
+    // The starts can't depend on each other's progress, so the number of threads doesn't matter
+    tbb::task_arena arena(4);
+    arena.execute([&]{ multi_start_threaded.search(8, 7); });
+    
+    BOOST_CHECK( multi_start.mec_score() <= single_start.mec_score()    );
+    BOOST_CHECK( multi_start.mec_score() == multi_start_again.mec_score() );
+    BOOST_CHECK( multi_start.seed()      == multi_start_again.seed()      );
+    BOOST_CHECK( multi_start.mec_score() == multi_start_threaded.mec_score() );
+    BOOST_CHECK( multi_start.seed()      == multi_start_threaded.seed()      );
+}
+
+BOOST_AUTO_TEST_CASE( searchHasSolutionWhenOutOfTime )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    graph_type      graph(sub_block);
+    
+    // No time for the job, so the search must stop after the first refinement 
+    haplo::Budget   budget(0.0, 0.0);
+    auto            deadline = budget.deadline(sub_block.index());
+    
+    graph.search(8, 7, deadline);
+    budget.finish(deadline);
+    
+    BOOST_CHECK( graph.mec_score() < sub_block.size()          );
+    BOOST_CHECK( budget.hit_sub_blocks().size() == 1           );
+    BOOST_CHECK( budget.hit_sub_blocks()[0] == sub_block.index() );
+}
+
+BOOST_AUTO_TEST_CASE( canSolveSubBlockWithSpectralInit )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    graph_type      greedy(sub_block), spectral(sub_block);
+
+    greedy.search();
+    spectral.set_init(haplo::inits::spectral);
+    spectral.search();
+
+    BOOST_CHECK( spectral.mec_score() <= greedy.mec_score() );
+
+    // The haplotypes must be different at all the IH snps
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveComponentsIndependently )
+{
+    using block_type    = haplo::Block<27, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_seven);
+    subblock_type   sub_block(block, 1);
+    graph_type      graph(sub_block);
+
+    graph.search(4, 3);
+
+    // The single value read only has a snp in the first component, so there is nothing extra to solve
+    BOOST_CHECK( graph.num_components() == 2 );
+    BOOST_CHECK( graph.mec_score()      == 0 );
+    for (size_t i = 0; i < sub_block.snp_info().size(); ++i) 
+        BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+}
+
+BOOST_AUTO_TEST_CASE( canSparsifyEdges )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    graph_type      dense(sub_block), sparse(sub_block, 4);
+
+    dense.search();
+    sparse.search();
+
+    BOOST_CHECK( sparse.num_edges() <  dense.num_edges()          );
+    BOOST_CHECK( sparse.num_edges() <= 2 * 4 * sub_block.reads()  );
+    BOOST_CHECK( sparse.mec_score() <  sub_block.size()           );
+
+    // The haplotypes must be different at all the IH snps
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithCappedCoverage )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+
+    graph_type dense(sub_block);
+    BOOST_CHECK( sub_block.select_reads(5) > 0 );
+    graph_type capped(sub_block);
+
+    dense.search();
+    capped.search();
+
+    // The discarded reads have no edges, but they are still scored against the haplotypes
+    BOOST_CHECK( capped.num_edges() <  dense.num_edges() );
+    BOOST_CHECK( capped.mec_score() <  sub_block.size()  );
+
+    // The haplotypes must be different at all the IH snps
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithClusteredReads )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+
+    graph_type unclustered(sub_block);
+    BOOST_CHECK( sub_block.cluster_reads(1) < sub_block.reads() );
+    graph_type clustered(sub_block);
+
+    unclustered.search();
+    clustered.search();
+
+    // The edges of a cluster's reads go to its first read, and the reads of a cluster have no edges between
+    // them, they go into the partition of the first read
+    BOOST_CHECK( clustered.num_edges() <  unclustered.num_edges() );
+    BOOST_CHECK( clustered.mec_score() <  sub_block.size()        );
+
+    // The haplotypes must be different at all the IH snps
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canSolveWithFilteredColumns )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using graph_type    = haplo::Graph<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    const size_t cols  = sub_block.snp_info().size();
+    const size_t reads = sub_block.reads();
+
+    // Removing the NIH columns removes the reads which are only in them
+    BOOST_CHECK( sub_block.filter_columns(2, true) == 60 );
+    BOOST_CHECK( sub_block.filtered() == true         );
+    BOOST_CHECK( sub_block.filter_columns(2)   == 0   );
+    BOOST_CHECK( sub_block.snp_info().size()   == 39  );
+    BOOST_CHECK( sub_block.nih_columns()       == 0   );
+    BOOST_CHECK( sub_block.reads()             <  reads );
+
+    graph_type graph(sub_block);
+    graph.search();
+    sub_block.restore_columns();
+
+    BOOST_CHECK( sub_block.filtered()        == false );
+    BOOST_CHECK( sub_block.snp_info().size() == cols  );
+    BOOST_CHECK( sub_block.reads()           == reads );
+
+    // The haplotypes must be different at all the IH snps, including the filled ones
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+// ----------------------------------------------------------------------------------------------------------
+/// @file   multilevel_tests.cpp
+/// @brief  Test suite for parahaplo multilevel search tests
+// ----------------------------------------------------------------------------------------------------------
+
+#define BOOST_TEST_DYN_LINK
+#ifdef STAND_ALONE
+    #define BOOST_TEST_MODULE MultilevelTests
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include "../haplo/subblock_cpu.hpp"
+#include "../haplo/multilevel_cpu.hpp"
+
+static constexpr const char* input_six   = "input_files/input_six.txt";
+static constexpr const char* input_seven = "input_files/input_seven.txt";
+
+BOOST_AUTO_TEST_SUITE( MultilevelSuite )
+
+BOOST_AUTO_TEST_CASE( canSolveSubBlockWithoutCoarsening )
+{
+    using block_type      = haplo::Block<27, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using multilevel_type = haplo::Multilevel<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_seven);
+    subblock_type   sub_block(block, 1);
+    multilevel_type multilevel(sub_block);
+
+    multilevel.search();
+
+    BOOST_CHECK( multilevel.levels()      == 1                 );
+    BOOST_CHECK( multilevel.fragments(0)  == sub_block.reads() );
+    BOOST_CHECK( multilevel.mec_score()   == 0                 );
+    for (size_t i = 0; i < sub_block.snp_info().size(); ++i) 
+        BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+}
+
+BOOST_AUTO_TEST_CASE( canCoarsenAndRefine )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using multilevel_type = haplo::Multilevel<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    multilevel_type multilevel(sub_block, 32);
+
+    multilevel.search();
+
+    BOOST_CHECK( multilevel.levels()    > 1                );
+    BOOST_CHECK( multilevel.mec_score() < sub_block.size() );
+    for (size_t level = 1; level < multilevel.levels(); ++level) 
+        BOOST_CHECK( multilevel.fragments(level) < multilevel.fragments(level - 1) );
+
+    // The haplotypes must be different at all the IH snps
+    const auto snp_info = sub_block.snp_info();
+    for (size_t i = 0; i < snp_info.size(); ++i) {
+        if (snp_info[i].type() == IH) 
+            BOOST_CHECK( sub_block.haplo_one().get(i) != sub_block.haplo_two().get(i) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canPlaceDiscardedReads )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using multilevel_type = haplo::Multilevel<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+
+    BOOST_CHECK( sub_block.select_reads(5) > 0 );
+    multilevel_type multilevel(sub_block, 32);
+    multilevel.search();
+
+    BOOST_CHECK( multilevel.fragments(0) == sub_block.reads() - sub_block.discarded_reads() );
+
+    // The MEC score is for all the reads, including the discarded ones
+    size_t mec_score = 0;
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto& read_info = sub_block.read_info()[read_idx];
+        size_t conflicts_one = 0, conflicts_two = 0;
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+            const auto value = sub_block(read_idx, snp_idx);
+            if (value > 1) continue;
+            conflicts_one += value != sub_block.haplo_one().get(snp_idx);
+            conflicts_two += value != sub_block.haplo_two().get(snp_idx);
+        }
+        mec_score += std::min(conflicts_one, conflicts_two);
+    }
+    BOOST_CHECK( multilevel.mec_score() == mec_score        );
+    BOOST_CHECK( multilevel.mec_score() <  sub_block.size() );
+}
+
+BOOST_AUTO_TEST_CASE( canSolveClusteredReads )
+{
+    using block_type      = haplo::Block<5609, 4, 4>;
+    using subblock_type   = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    using multilevel_type = haplo::Multilevel<subblock_type, haplo::devices::cpu>;
+
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+
+    BOOST_CHECK( sub_block.cluster_reads(2) < sub_block.reads() );
+    multilevel_type multilevel(sub_block, 32);
+    multilevel.search();
+
+    // The reads are the finest level, and each cluster is a fragment of the first coarse level
+    BOOST_CHECK( multilevel.fragments(0) == sub_block.reads()        );
+    BOOST_CHECK( multilevel.fragments(1) == sub_block.num_clusters() );
+
+    size_t mec_score = 0;
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        const auto& read_info = sub_block.read_info()[read_idx];
+        size_t conflicts_one = 0, conflicts_two = 0;
+        for (size_t snp_idx = read_info.start_index(); snp_idx <= read_info.end_index(); ++snp_idx) {
+            const auto value = sub_block(read_idx, snp_idx);
+            if (value > 1) continue;
+            conflicts_one += value != sub_block.haplo_one().get(snp_idx);
+            conflicts_two += value != sub_block.haplo_two().get(snp_idx);
+        }
+        mec_score += std::min(conflicts_one, conflicts_two);
+    }
+    BOOST_CHECK( multilevel.mec_score() == mec_score        );
+    BOOST_CHECK( multilevel.mec_score() <  sub_block.size() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -409,4 +409,155 @@ BOOST_AUTO_TEST_CASE( canPushBackToVector )
     BOOST_CHECK( elements.get(18)   == 0  );
 }
 
+// ------------------------------------------ WORD TESTS ----------------------------------------------------
+
+BOOST_AUTO_TEST_CASE( canGetAndSetRangesAcrossWords )
+{
+    haplo::WordVector<2> elements(80);
+    
+    // Set 20 elements which start in the first word and end in the second
+    for (size_t i = 0; i < 20; ++i) elements.set(25 + i, i % 4);
+    
+    // The last element is in the lowest bits: 0 1 2 3 -> 00 01 10 11
+    BOOST_CHECK( elements.get_range(25, 4)  == 0x1B );
+    BOOST_CHECK( elements.get_range(30, 4)  == 0x6C );
+    BOOST_CHECK( elements.get_range(24, 1)  == 0    );
+    
+    elements.set_range(60, 8, 0xFFFF);
+    for (size_t i = 60; i < 68; ++i) BOOST_CHECK( elements.get(i) == 3 );
+    BOOST_CHECK( elements.get(59) == 0 );
+    BOOST_CHECK( elements.get(68) == 0 );
+    BOOST_CHECK( elements.num_words() == 3 );
+}
+
+BOOST_AUTO_TEST_CASE( canCopyAndCompareSpans )
+{
+    haplo::WordArray<100, 2> source;
+    haplo::WordVector<2>     elements(100);
+    
+    for (size_t i = 0; i < 100; ++i) source.set(i, (i * 7) % 3);
+    
+    // Copy an unaligned span which covers more than a word
+    elements.copy_span(source, 5, 41, 50);
+    
+    for (size_t i = 0; i < 50; ++i) BOOST_CHECK( elements.get(41 + i) == source.get(5 + i) );
+    BOOST_CHECK( elements.get(40) == 0 );
+    BOOST_CHECK( elements.get(91) == 0 );
+    BOOST_CHECK( elements.compare_span(source, 41, 5, 50) == 0 );
+    
+    // Change 3 of the elements, and the span must differ in 3 elements
+    elements.set(41, 3); elements.set(70, 3); elements.set(90, 3);
+    BOOST_CHECK( elements.compare_span(source, 41, 5, 50) == 3 );
+}
+
+BOOST_AUTO_TEST_CASE( canRemoveElementsOfWordVector )
+{
+    haplo::WordVector<1> elements(70);
+    
+    elements.set(0 , 1);
+    elements.set(63, 1);
+    elements.set(64, 1);
+    elements.set(69, 1);
+    
+    elements.remove_element(1);             // Elements after 1 move left across the word boundary
+    
+    BOOST_CHECK( elements.size()  == 69 );
+    BOOST_CHECK( elements.get(0)  == 1  );
+    BOOST_CHECK( elements.get(62) == 1  );
+    BOOST_CHECK( elements.get(63) == 1  );
+    BOOST_CHECK( elements.get(64) == 0  );
+    BOOST_CHECK( elements.get(68) == 1  );
+    
+    auto values = elements.to_binary_vector();
+    BOOST_CHECK( values.size() == 69 );
+    BOOST_CHECK( values[62]    == 1  );
+    BOOST_CHECK( values[67]    == 0  );
+}
+
+BOOST_AUTO_TEST_CASE( canRemoveElementsInBulk )
+{
+    haplo::BinaryVector<2>  elements(20);
+    haplo::WordVector<2>    word_elements(100);
+    haplo::WordVector<1>    drop(100);
+    std::vector<size_t>     indices;
+    
+    for (size_t i = 0; i < 20 ; ++i) elements.set(i, i % 4);
+    for (size_t i = 0; i < 100; ++i) word_elements.set(i, i % 3);
+    
+    // Remove every third element, which leaves only the 1s and 2s
+    for (size_t i = 0; i < 100; i += 3) { drop.set(i, 1); indices.push_back(i); }
+    
+    elements.remove_elements(indices);
+    word_elements.remove_elements(drop);
+    
+    BOOST_CHECK( elements.size()      == 13 );
+    BOOST_CHECK( word_elements.size() == 66 );
+    for (size_t i = 0; i < 66; ++i) BOOST_CHECK( word_elements.get(i) == 1 + i % 2 );
+    
+    // 1 2 0 1 3 0 2 3 1 2 0 1 3
+    BOOST_CHECK( elements.get(0)  == 1 );
+    BOOST_CHECK( elements.get(2)  == 0 );
+    BOOST_CHECK( elements.get(4)  == 3 );
+    BOOST_CHECK( elements.get(12) == 3 );
+    
+    // The elements after the end are cleared
+    BOOST_CHECK( elements.get(13)      == 0 );
+    BOOST_CHECK( word_elements.get(66) == 0 );
+}
+
+BOOST_AUTO_TEST_CASE( canAllocateWordVectorsFromAnArena )
+{
+    haplo::Arena arena(1 << 12);
+    haplo::WordVector<2> heap_elements(100);
+    
+    {
+        haplo::ArenaScope scope(arena);
+        haplo::WordVector<2> elements(1000);
+        for (size_t i = 0; i < 1000; ++i) elements.set(i, i % 3);
+        
+        BOOST_CHECK( arena.bytes_used() >= elements.num_words() * sizeof(uint64_t) );
+        BOOST_CHECK( elements.get(998) == 2 );
+        
+        // Bigger than a chunk, so it gets its own chunk
+        haplo::WordVector<2> big_elements(100000);
+        BOOST_CHECK( arena.bytes_reserved() > (1 << 13) );
+    }
+    BOOST_CHECK( haplo::Arena::current() == nullptr );
+    
+    // Resetting keeps the chunks, so the next allocations reuse them
+    const size_t reserved = arena.bytes_reserved();
+    arena.reset();
+    BOOST_CHECK( arena.bytes_used() == 0 );
+    {
+        haplo::ArenaScope scope(arena);
+        haplo::WordVector<2> elements(1000);
+        BOOST_CHECK( arena.bytes_reserved() == reserved );
+    }
+    
+    // Containers created outside of a scope use the heap
+    const size_t used = arena.bytes_used();
+    heap_elements.resize(10000);
+    BOOST_CHECK( arena.bytes_used() == used );
+}
+
+BOOST_AUTO_TEST_CASE( canGrowArenaChunksAndCapThePool )
+{
+    // Each chunk is twice the size of the last, up to the largest chunk size
+    haplo::Arena arena(1 << 14, false, 1 << 12);
+    arena.allocate(3000);
+    BOOST_CHECK( arena.bytes_reserved() == (1 << 12) );
+    arena.allocate(3000); arena.allocate(3000);
+    BOOST_CHECK( arena.bytes_reserved() == (1 << 12) + (1 << 13) );
+    arena.allocate(3000);
+    BOOST_CHECK( arena.bytes_reserved() == (1 << 12) + (1 << 13) + (1 << 14) );
+    for (size_t i = 0; i < 5; ++i) arena.allocate(3000);
+    BOOST_CHECK( arena.bytes_reserved() == (1 << 12) + (1 << 13) + 2 * (1 << 14) );
+    
+    // Only two of the three arenas are kept when they are released
+    haplo::ArenaPool pool(false, 2);
+    auto first = pool.acquire(), second = pool.acquire(), third = pool.acquire();
+    pool.release(std::move(first)); pool.release(std::move(second)); pool.release(std::move(third));
+    BOOST_CHECK( pool.size() == 2 );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
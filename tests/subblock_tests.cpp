@@ -19,6 +19,9 @@ static constexpr const char* input_one    = "input_files/input_one.txt";
 static constexpr const char* input_two    = "input_files/input_two.txt";
 static constexpr const char* input_three  = "input_files/input_three.txt";
 static constexpr const char* input_four  = "input_files/input_four.txt";
+static constexpr const char* input_six    = "input_files/input_six.txt";
+static constexpr const char* input_seven  = "input_files/input_seven.txt";
+static constexpr const char* input_ten    = "input_files/input_ten.txt";
 
 BOOST_AUTO_TEST_SUITE( SubBlockSuite )
 
@@ -82,6 +85,307 @@ BOOST_AUTO_TEST_CASE( canRemoveMonotoneColumns )
     BOOST_CHECK( sub_block(3, 1)  == 0 );
     BOOST_CHECK( sub_block(3, 2)  == 1 );
     BOOST_CHECK( sub_block(3, 3)  == 1 );
+    
+    // Base columns 5, 6, 8 and 9 are monotone
+    BOOST_CHECK( sub_block.base_column(0) == 4  );
+    BOOST_CHECK( sub_block.base_column(1) == 7  );
+    BOOST_CHECK( sub_block.base_column(3) == 11 );
+    BOOST_CHECK( sub_block.column(10)     == 2  );
+}
+
+BOOST_AUTO_TEST_CASE( canMapColumnsAroundMonotoneColumns )
+{
+    using block_type    = haplo::Block<19, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_ten);
+    subblock_type   sub_block(block, 1);
+    
+    // Columns 2, 4 and 5 are monotone, so the read starting at column 2 must
+    // start at the sub-block column of base column 3, and the last read, which
+    // only covers monotone columns, must be dropped
+    BOOST_CHECK( sub_block.reads() == 4 );
+    BOOST_CHECK( sub_block(0, 0)  == 0 );
+    BOOST_CHECK( sub_block(0, 1)  == 1 );
+    BOOST_CHECK( sub_block(0, 2)  == 0 );
+    BOOST_CHECK( sub_block(0, 3)  == 3 );
+    BOOST_CHECK( sub_block(1, 0)  == 1 );
+    BOOST_CHECK( sub_block(1, 1)  == 0 );
+    BOOST_CHECK( sub_block(1, 2)  == 1 );
+    BOOST_CHECK( sub_block(1, 3)  == 3 );
+    BOOST_CHECK( sub_block(2, 0)  == 3 );
+    BOOST_CHECK( sub_block(2, 1)  == 3 );
+    BOOST_CHECK( sub_block(2, 2)  == 0 );
+    BOOST_CHECK( sub_block(2, 3)  == 0 );
+    BOOST_CHECK( sub_block(3, 0)  == 3 );
+    BOOST_CHECK( sub_block(3, 1)  == 3 );
+    BOOST_CHECK( sub_block(3, 2)  == 1 );
+    BOOST_CHECK( sub_block(3, 3)  == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( canFindIndependentComponents )
+{
+    using block_type    = haplo::Block<27, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_seven);
+    subblock_type   sub_block(block, 1);
+    
+    // The reads alternate between the even and odd snps, and the last read has a single value
+    BOOST_CHECK( sub_block.num_components() == 2 );
+    BOOST_CHECK( sub_block.read_component(0) == 0 );
+    BOOST_CHECK( sub_block.read_component(1) == 1 );
+    BOOST_CHECK( sub_block.read_component(2) == 0 );
+    BOOST_CHECK( sub_block.read_component(3) == 1 );
+    BOOST_CHECK( sub_block.read_component(4) == subblock_type::NO_COMPONENT );
+}
+
+BOOST_AUTO_TEST_CASE( canCapReadCoverage )
+{
+    using block_type    = haplo::Block<27, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_seven);
+    subblock_type   sub_block(block, 1);
+    
+    // With one read per column only the first read of each component is kept
+    BOOST_CHECK( sub_block.select_reads(1) == 3 );
+    BOOST_CHECK( sub_block.num_components() == 2 );
+    BOOST_CHECK( sub_block.read_selected(0) == true  );
+    BOOST_CHECK( sub_block.read_selected(1) == true  );
+    BOOST_CHECK( sub_block.read_selected(2) == false );
+    BOOST_CHECK( sub_block.read_selected(3) == false );
+    BOOST_CHECK( sub_block.read_component(0) == 0 );
+    BOOST_CHECK( sub_block.read_component(1) == 1 );
+    BOOST_CHECK( sub_block.read_component(2) == subblock_type::NO_COMPONENT );
+    BOOST_CHECK( sub_block.read_component(3) == subblock_type::NO_COMPONENT );
+    
+    // No cap selects all the reads again
+    BOOST_CHECK( sub_block.select_reads(0) == 0 );
+    BOOST_CHECK( sub_block.discarded_reads() == 0 );
+    BOOST_CHECK( sub_block.read_component(2) == 0 );
+    BOOST_CHECK( sub_block.read_component(3) == 1 );
+}
+
+BOOST_AUTO_TEST_CASE( canClusterReads )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    // Each read is its own cluster by default
+    BOOST_CHECK( sub_block.num_clusters() == sub_block.reads() );
+    
+    for (size_t max_distance = 0; max_distance <= 2; ++max_distance) {
+        BOOST_CHECK( sub_block.cluster_reads(max_distance) == sub_block.num_clusters() );
+        
+        // Each read has the span of the first read of its cluster, and is close enough to it
+        std::vector<size_t> leaders(sub_block.num_clusters(), subblock_type::NO_COMPONENT);
+        size_t              exact_clusters = 0;
+        for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+            auto& leader = leaders[sub_block.read_cluster(read_idx)];
+            if (leader == subblock_type::NO_COMPONENT) { leader = read_idx; continue; }
+            
+            const auto& read_info   = sub_block.read_info()[read_idx];
+            const auto& leader_info = sub_block.read_info()[leader];
+            BOOST_CHECK( read_info.start_index() == leader_info.start_index() );
+            BOOST_CHECK( read_info.end_index()   == leader_info.end_index()   );
+            
+            size_t distance = 0;
+            for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx)
+                distance += sub_block(read_idx, col_idx) != sub_block(leader, col_idx);
+            BOOST_CHECK( distance <= max_distance );
+        }
+        
+        // With no differences the clusters are the exact duplicates
+        if (max_distance == 0) {
+            for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+                bool duplicate = false;
+                for (size_t other_idx = 0; other_idx < read_idx && !duplicate; ++other_idx) {
+                    const auto& read_info  = sub_block.read_info()[read_idx];
+                    const auto& other_info = sub_block.read_info()[other_idx];
+                    if (read_info.start_index() != other_info.start_index() ||
+                        read_info.end_index()   != other_info.end_index()    ) continue;
+                    duplicate = true;
+                    for (size_t col_idx = read_info.start_index(); col_idx <= read_info.end_index(); ++col_idx)
+                        if (sub_block(read_idx, col_idx) != sub_block(other_idx, col_idx)) duplicate = false;
+                }
+                if (!duplicate) ++exact_clusters;
+            }
+            BOOST_CHECK( sub_block.num_clusters() == exact_clusters );
+        }
+    }
+    BOOST_CHECK( sub_block.num_clusters() < sub_block.reads() );
+}
+
+BOOST_AUTO_TEST_CASE( filteringKeepsSelectionAndClusters )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    const size_t discarded = sub_block.select_reads(5);
+    const size_t clusters  = sub_block.cluster_reads(0);
+    BOOST_CHECK( discarded > 0 );
+    BOOST_CHECK( sub_block.filter_columns(2, true) > 0 );
+    
+    // Each filtered read has the selection of its unfiltered read, and the reads of a cluster still have
+    // the same span
+    size_t              unselected = 0;
+    std::vector<size_t> leaders(sub_block.num_clusters(), subblock_type::NO_COMPONENT);
+    BOOST_CHECK( sub_block.num_clusters() <= clusters );
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        if (!sub_block.read_selected(read_idx)) {
+            ++unselected;
+            BOOST_CHECK( sub_block.read_component(read_idx) == subblock_type::NO_COMPONENT );
+        }
+        auto& leader = leaders[sub_block.read_cluster(read_idx)];
+        if (leader == subblock_type::NO_COMPONENT) { leader = read_idx; continue; }
+        
+        const auto& read_info   = sub_block.read_info()[read_idx];
+        const auto& leader_info = sub_block.read_info()[leader];
+        BOOST_CHECK( read_info.start_index() == leader_info.start_index() );
+        BOOST_CHECK( read_info.end_index()   == leader_info.end_index()   );
+    }
+    BOOST_CHECK( unselected > 0 );
+    BOOST_CHECK( sub_block.discarded_reads() == unselected );
+    
+    // Restoring the columns gives back the unfiltered selection and clusters
+    sub_block.restore_columns();
+    BOOST_CHECK( sub_block.discarded_reads() == discarded );
+    BOOST_CHECK( sub_block.num_clusters()    == clusters  );
+}
+
+BOOST_AUTO_TEST_CASE( canCompareReadsWithAllelePlanes )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    const auto   planes = sub_block.allele_planes();
+    const size_t snps   = sub_block.snp_info().size(); 
+    BOOST_CHECK( planes.reads() == sub_block.reads() );
+    BOOST_CHECK( snps > haplo::AllelePlanes::bits_per_word );
+    
+    // The counts from the planes are the same as comparing the elements
+    const size_t reads = std::min(sub_block.reads(), size_t(100));
+    for (size_t read_one = 0; read_one < reads; ++read_one) {
+        for (size_t read_two = read_one + 1; read_two < reads; ++read_two) {
+            size_t shared = 0, mismatches = 0, exclusive = 0;
+            for (size_t col_idx = 0; col_idx < snps; ++col_idx) {
+                const auto value_one = sub_block(read_one, col_idx), value_two = sub_block(read_two, col_idx);
+                if (value_one <= 1 && value_two <= 1) { ++shared; mismatches += value_one != value_two; }
+                else if (value_one <= 1 || value_two <= 1) ++exclusive;
+            }
+            const auto overlap = planes.compare(read_one, read_two);
+            BOOST_CHECK( overlap.shared     == shared     );
+            BOOST_CHECK( overlap.mismatches == mismatches );
+            BOOST_CHECK( overlap.exclusive  == exclusive  );
+        }
+    }
+    
+    // And the mismatches with a haplotype
+    std::vector<uint8_t> haplotype(snps);
+    for (size_t col_idx = 0; col_idx < snps; ++col_idx) haplotype[col_idx] = col_idx % 3 == 0;
+    const auto plane = haplo::AllelePlanes::haplotype_plane(haplotype);
+    
+    for (size_t read_idx = 0; read_idx < sub_block.reads(); ++read_idx) {
+        size_t calls = 0, mismatches = 0;
+        for (size_t col_idx = 0; col_idx < snps; ++col_idx) {
+            const auto value = sub_block(read_idx, col_idx);
+            if (value > 1) continue;
+            ++calls; mismatches += value != haplotype[col_idx];
+        }
+        BOOST_CHECK( planes.calls(read_idx)             == calls      );
+        BOOST_CHECK( planes.mismatches(read_idx, plane) == mismatches );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canCompareShortReadsWithFixedWordKernels )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    const auto   planes = sub_block.allele_planes();
+    const size_t snps   = sub_block.snp_info().size(); 
+    BOOST_CHECK( planes.max_words() <= 2 );
+    
+    std::vector<uint8_t> haplotype(snps);
+    for (size_t col_idx = 0; col_idx < snps; ++col_idx) haplotype[col_idx] = col_idx % 3 == 0;
+    const auto plane = haplo::AllelePlanes::haplotype_plane(haplotype);
+    
+    // Each kernel gives the same results for reads with fewer words than it
+    const size_t reads = std::min(sub_block.reads(), size_t(100));
+    for (size_t read_one = 0; read_one < reads; ++read_one) {
+        BOOST_CHECK( planes.mismatches_fixed<2>(read_one, plane) == planes.mismatches(read_one, plane) );
+        BOOST_CHECK( planes.mismatches_fixed<4>(read_one, plane) == planes.mismatches(read_one, plane) );
+        BOOST_CHECK( planes.hash_fixed<2>(read_one) == planes.hash_fixed<4>(read_one) );
+        
+        for (size_t read_two = read_one + 1; read_two < reads; ++read_two) {
+            const auto overlap = planes.compare(read_one, read_two);
+            const auto fixed   = planes.compare_fixed<4>(read_one, read_two);
+            BOOST_CHECK( fixed.shared     == overlap.shared     );
+            BOOST_CHECK( fixed.mismatches == overlap.mismatches );
+            BOOST_CHECK( fixed.exclusive  == overlap.exclusive  );
+            
+            // Reads with the same calls have the same hash
+            if (overlap.exclusive == 0 && overlap.mismatches == 0) 
+                BOOST_CHECK( planes.hash(read_one) == planes.hash(read_two) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( canReadColumnsFromTheColumnView )
+{
+    using block_type    = haplo::Block<5609, 4, 4>;
+    using subblock_type = haplo::SubBlock<block_type, 4, 4, haplo::devices::cpu>;
+    
+    block_type      block(input_six);
+    subblock_type   sub_block(block, 1);
+    
+    const auto&  columns = sub_block.columns();
+    const size_t snps    = sub_block.snp_info().size(); 
+    BOOST_CHECK( columns.rows() == sub_block.reads() );
+    BOOST_CHECK( columns.rows() > haplo::ColumnView::elements_per_word );
+    
+    // The transposed elements are the same as the row major ones
+    for (size_t row_idx = 0; row_idx < sub_block.reads(); ++row_idx) 
+        for (size_t col_idx = 0; col_idx < snps; ++col_idx) 
+            BOOST_CHECK( columns(row_idx, col_idx) == sub_block(row_idx, col_idx) );
+    
+    // The counts only include the rows in the mask
+    const auto even_rows = haplo::ColumnView::lane_mask(sub_block.reads(), [](const size_t row_idx) 
+                           { 
+                               return row_idx % 2 == 0; 
+                           });
+    for (size_t col_idx = 0; col_idx < snps; ++col_idx) {
+        size_t counts[2], expected[2] = {0, 0};
+        for (size_t row_idx = 0; row_idx < sub_block.reads(); row_idx += 2) {
+            const auto value = sub_block(row_idx, col_idx);
+            if (value <= 1) ++expected[value];
+        }
+        columns.count(col_idx, even_rows, counts);
+        BOOST_CHECK( counts[0] == expected[0] );
+        BOOST_CHECK( counts[1] == expected[1] );
+    }
+    
+    // A column is only equal to another in the masked rows if all the elements are
+    for (size_t col_idx = 1; col_idx < snps; ++col_idx) {
+        bool equal = true;
+        for (size_t row_idx = 0; row_idx < sub_block.reads(); row_idx += 2) 
+            equal = equal && sub_block(row_idx, col_idx) == sub_block(row_idx, col_idx - 1);
+        BOOST_CHECK( columns.equal(col_idx, col_idx - 1, even_rows) == equal );
+        BOOST_CHECK( columns.equal(col_idx, col_idx, even_rows) );
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()